@@ -11,6 +11,7 @@
 
 // point_cloud_transport
 #include "draco_point_cloud_transport/CompressedPointCloud2.h"
+#include "draco_point_cloud_transport/DracoQuantization.h"
 #include "draco_point_cloud_transport/conversion_utilities.h"
 
 class DracotoPC2 {
@@ -24,8 +25,48 @@ public:
     //! Method for converting into sensor_msgs::PointCloud2
     sensor_msgs::PointCloud2 convert();
 
-    //!
-    std::vector<uint8_t> get_data();
+    //! Method for converting into existing sensor_msgs::PointCloud2, its data keeps allocated storage
+    void convert(sensor_msgs::PointCloud2& PC2);
+
+    //! Number of points in Draco pointcloud, original number of points if duplicates are restored
+    uint32_t num_points() const;
+
+    //! Checks if points were deduplicated before encoding and are delivered without duplicates
+    bool deduplicated() const;
+
+    //! Restore original number and order of deduplicated points, if publisher sent point map
+    void set_restore_duplicates(bool restore);
+
+    //! Writes all points into out_data, which must hold num_points() points with point_step()
+    void write_points(uint8_t* out_data) const;
+
+    //! Deliver only fields with given names, packed into a compact point_step; empty list delivers all fields in original layout
+    void set_field_projection(const std::vector<std::string>& field_names);
+
+    //! Deliver quantized attributes of given types (indexed by draco::GeometryAttribute::Type) as unsigned integer fields of the
+    //! smallest type holding their bits instead of float32, fields are then packed without gaps. Other quantized attributes are dequantized.
+    void set_quantized_output(const std::vector<bool>& attribute_types);
+
+    //! Appends scale and offsets of delivered quantized integer fields to quantization
+    void get_quantization(draco_point_cloud_transport::DracoQuantization& quantization) const;
+
+    //! Assigns header, fields, point_step, width, ... of output sensor_msgs::PointCloud2
+    void assign_output_description(sensor_msgs::PointCloud2& PC2) const;
+
+    //! fields of output sensor_msgs::PointCloud2
+    const std::vector<sensor_msgs::PointField>& output_fields() const;
+
+    //! point_step of output sensor_msgs::PointCloud2
+    uint32_t point_step() const;
+
+    //! write_points writes every byte of output points, output data does not have to be zero-filled
+    bool covers_point_step() const;
+
+    //! field of compressed PointCloud2 is delivered in output
+    bool delivers_field(size_t field_index) const;
+
+    //! field of compressed PointCloud2 is delivered and write_points writes it (it is held by an attribute of this point cloud)
+    bool writes_field(size_t field_index) const;
 
         private:
     //! Message to be converted
@@ -34,6 +75,35 @@ public:
     //! Structure to hold information about sensor_msgs::PointCloud2
     draco_point_cloud_transport::CompressedPointCloud2ConstPtr compressed_PC2_;
 
+    //! fields and point_step of output PointCloud2
+    std::vector<sensor_msgs::PointField> fields_;
+    uint32_t point_step_;
+
+    //! for each field of compressed PointCloud2 index of output field, -1 if field is not delivered
+    std::vector<int> output_field_index_;
+
+    //! for each field of compressed PointCloud2 draco attribute holding its values, -1 if field was not encoded
+    std::vector<int32_t> field_attributes_;
+
+    //! for each field of compressed PointCloud2 first component and number of components of its attribute holding values of field
+    std::vector<int32_t> field_components_;
+
+    //! for each attribute quantization parameters if it holds quantized values (quantized by PC2toDraco or dequantization skipped
+    //! by decoder), bits 0 otherwise
+    std::vector<QuantizationParameters> quantization_;
+
+    //! for each attribute, quantized values are delivered as integers
+    std::vector<uint8_t> quantized_output_;
+
+    //! names of delivered fields, empty for all fields
+    std::vector<std::string> field_names_;
+
+    //! for each original point index of unique point representing it, empty if duplicates are not restored
+    std::vector<int32_t> point_map_;
+
+    //! output fields without padding between them, all of them restored from attributes
+    bool covers_point_step_;
+
 };
 
 
@@ -4,73 +4,67 @@
 #include <ros/ros.h>
 #include <sensor_msgs/PointField.h>
 #include <sensor_msgs/PointCloud2.h>
-// for enumeration in switch(std::string) ...
-#include <map>
-#include <string>
 // for dynamic vector arrays
 #include <vector>
 // draco
 #include <draco/point_cloud/point_cloud_builder.h>
+// point_cloud_transport
+#include "draco_point_cloud_transport/encoding_plan.h"
 
 class PC2toDraco {
 public:
-    //! Constructor.
-    explicit PC2toDraco(sensor_msgs::PointCloud2 PC2, std::string topic);
+    //! Constructor. Only references to PC2 and plan are kept, both must outlive the converter.
+    explicit PC2toDraco(const sensor_msgs::PointCloud2& PC2, const draco_point_cloud_transport::EncodingPlan& plan);
 
     //! Destructor
     //~PC2toDraco();
 
     //! Method for converting into Draco pointcloud
-    std::unique_ptr<draco::PointCloud> convert(bool deduplicate_flag, bool expert_encoding_flag);
+    std::unique_ptr<draco::PointCloud> convert(bool deduplicate_flag);
+
+    //! Converts into pc, attributes of pc with the same layout (e.g. left by conversion of previous frame) keep their allocated
+    //! storage, pc is replaced otherwise; returns false if conversion failed
+    bool convert(bool deduplicate_flag, std::unique_ptr<draco::PointCloud>& pc);
+
+    //! Convert only number_of_points points starting at first_point (e.g. one tile of the point cloud)
+    void set_point_range(uint32_t first_point, uint32_t number_of_points);
+
+    //! Convert only number_of_attributes attributes of plan starting at first_attribute (e.g. one attribute stream)
+    void set_attribute_range(int first_attribute, int number_of_attributes);
+
+    //! Settings of deduplication: points are duplicates if x, y, z are within cell of grid with size tolerance (0 = equal values) and,
+    //! with compare_attributes, all other fields are equal; with point_map index of unique point of each point is stored in metadata
+    void set_deduplication(double tolerance, bool compare_attributes, bool point_map);
+
+    //! Use buffer for quantized values, a buffer recycled between frames keeps its allocated storage
+    void set_quantization_buffer(std::vector<uint8_t>& buffer);
 
 private:
-    //! Message to be converted
-    sensor_msgs::PointCloud2 PC2_;
-
-    //! sensor_msgs::PointField::datatype names
-    char *PointFieldDataTypes;
-
-    //! enumeration for switch(std::string)
-    enum StringValueFieldName { enumvalGeneric,
-        enumval1,
-        enumval2,
-        enumval3,
-        enumval4,
-        enumval5,
-        enumval6,
-        enumval7,
-        enumval8,
-        enumval9,
-        enumval10,
-        enumval11,
-        enumval12,
-        enumval13,
-        enumval14,
-        enumvalEnd };
-
-    std::map<std::string, StringValueFieldName> s_mapStringValues;
-
-    //! initialize enumeration values for detection of GeometryAttribute::Type
-    void Initialize()
-    {
-
-        s_mapStringValues["x"] =        enumval1;
-        s_mapStringValues["y"] =        enumval2;
-        s_mapStringValues["z"] =        enumval3;
-        s_mapStringValues["pos"] =      enumval4;
-        s_mapStringValues["position"] = enumval5;
-        s_mapStringValues["r"] =        enumval6;
-        s_mapStringValues["g"] =        enumval7;
-        s_mapStringValues["b"] =        enumval8;
-        s_mapStringValues["a"] =        enumval9;
-        s_mapStringValues["rgb"] =      enumval10;
-        s_mapStringValues["rgba"] =     enumval11;
-        s_mapStringValues["nx"] =       enumval12;
-        s_mapStringValues["ny"] =       enumval13;
-        s_mapStringValues["nz"] =       enumval14;
-    }
-
-    std::string base_topic_;
+    //! Message to be converted (borrowed, point data is read in place)
+    const sensor_msgs::PointCloud2& PC2_;
+
+    //! Resolved encoding of fields of PC2_
+    const draco_point_cloud_transport::EncodingPlan& plan_;
+
+    //! first point and number of points to be converted
+    uint32_t first_point_;
+    uint32_t number_of_points_;
+
+    //! first attribute and number of attributes of plan to be converted
+    int first_attribute_;
+    int number_of_attributes_;
+
+    //! deduplication settings
+    double deduplication_tolerance_;
+    bool deduplication_compare_attributes_;
+    bool deduplication_point_map_;
+
+    //! unique points gathered before conversion
+    std::vector<uint8_t> unique_data_;
+
+    //! buffer for quantized values of one field, points to own_quantized_data_ unless set by user
+    std::vector<uint8_t>* quantized_data_;
+    std::vector<uint8_t> own_quantized_data_;
 
 };
 
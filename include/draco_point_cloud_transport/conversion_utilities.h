@@ -5,6 +5,13 @@
 // ros
 #include <sensor_msgs/PointCloud2.h>
 
+// draco
+#include <draco/attributes/point_attribute.h>
+#include <draco/metadata/geometry_metadata.h>
+
+#include <string>
+#include <vector>
+
 // point_cloud_transport
 #include "draco_point_cloud_transport/CompressedPointCloud2.h"
 
@@ -18,4 +25,57 @@ void assign_description_of_PointCloud2(draco_point_cloud_transport::CompressedPo
 //! assigns header, width, ... from compressedConstPtr to regular
 void assign_description_of_PointCloud2(sensor_msgs::PointCloud2& target, const draco_point_cloud_transport::CompressedPointCloud2ConstPtr source);
 
+//! size of PointField entry in Bytes (size of datatype * count)
+uint32_t point_field_size(const sensor_msgs::PointField& field);
+
+//! offset of float32 field name with one component within point_step, -1 if there is none
+int64_t float32_field_offset(const sensor_msgs::PointCloud2& PC2, const std::string& name);
+
+//! layout of delivered fields, requested fields keep their order but are packed without gaps, empty field_names delivers all fields in original layout,
+//! out_field_index holds for each field index of output field, -1 if field is not delivered
+void project_fields(const std::vector<sensor_msgs::PointField>& fields, uint32_t point_step, const std::vector<std::string>& field_names,
+                    std::vector<sensor_msgs::PointField>& out_fields, uint32_t& out_point_step, std::vector<int>& out_field_index);
+
+//! copies number_of_components components starting at first_component of all points of attribute into interleaved buffer out_data
+//! with stride point_step, returns false if components are not in attribute or a value does not fit into available_bytes of a point
+bool scatter_attribute(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                       uint8_t* out_data, uint32_t available_bytes, uint32_t point_step);
+
+//! uniform quantization of one attribute, same scheme as draco::AttributeQuantizationTransform
+//! (per component origin, one range shared by all components)
+struct QuantizationParameters
+{
+    int bits;
+    std::vector<double> origin;
+    double range;
+};
+
+//! smallest unsigned draco data type able to hold values quantized to bits
+draco::DataType quantized_data_type(int bits);
+
+//! finds origin and range of finite float32 values with count components, stored at in_data with stride point_step
+void compute_quantization_parameters(const uint8_t* in_data, uint32_t number_of_points, uint32_t count, uint32_t point_step, int bits, QuantizationParameters& params);
+
+//! de-interleaves float32 values with count components and quantizes them into out_data of type quantized_data_type(params.bits),
+//! non-finite values are stored as 0
+void quantize_float32(const uint8_t* in_data, uint32_t number_of_points, uint32_t count, uint32_t point_step, const QuantizationParameters& params, std::vector<uint8_t>& out_data);
+
+//! dequantizes number_of_components components starting at first_component of integer attribute (uint8, uint16, uint32 or int32) into interleaved float32 buffer
+//! out_data with stride point_step, returns false if components are not in attribute or values do not fit into available_bytes of a point
+bool dequantize_attribute(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                          uint8_t* out_data, uint32_t available_bytes, uint32_t point_step, const QuantizationParameters& params);
+
+//! copies number_of_components components starting at first_component of quantized integer attribute (uint8, uint16 or uint32) into
+//! interleaved buffer out_data as out_data_type (uint8, uint16 or uint32) with stride point_step, returns false if components are not
+//! in attribute, types are not supported or values do not fit into available_bytes of a point
+bool scatter_quantized_attribute(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components,
+                                 uint32_t number_of_points, uint8_t* out_data, uint32_t available_bytes, uint32_t point_step,
+                                 draco::DataType out_data_type);
+
+//! stores quantization parameters of attribute att_id in metadata
+void add_quantization_metadata(draco::GeometryMetadata& metadata, int att_id, const QuantizationParameters& params);
+
+//! reads quantization parameters of attribute att_id from metadata, returns false if attribute was not quantized before encoding
+bool get_quantization_metadata(const draco::GeometryMetadata& metadata, int att_id, QuantizationParameters& params);
+
 #endif // DRACO_POINT_CLOUD_TRANSPORT_CONVERSION_UTILITIES_H
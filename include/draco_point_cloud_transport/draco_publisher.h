@@ -6,19 +6,58 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <dynamic_reconfigure/server.h>
 #include <draco_point_cloud_transport/DracoPublisherConfig.h>
+#include "draco_point_cloud_transport/encoding_plan.h"
+#include "draco_point_cloud_transport/object_pool.h"
+#include "draco_point_cloud_transport/rate_control.h"
+#include "draco_point_cloud_transport/statistics.h"
+#include "draco_point_cloud_transport/temporal_coding.h"
+#include "draco_point_cloud_transport/thread_pool.h"
+
+// draco
+#include <draco/core/encoder_buffer.h>
+#include <draco/point_cloud/point_cloud.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace draco_point_cloud_transport {
 
 class DracoPublisher : public point_cloud_transport::SimplePublisherPlugin<draco_point_cloud_transport::CompressedPointCloud2>
 {
 public:
-  virtual ~DracoPublisher() {}
+  DracoPublisher() : config_revision_(0), tiers_queue_size_(0), tiers_latch_(false), tiers_advertisable_(false),
+    message_pool_(std::make_shared<ObjectPool<draco_point_cloud_transport::CompressedPointCloud2> >(4)),
+    encode_buffer_pool_(std::make_shared<ObjectPool<draco::EncoderBuffer> >(128)),
+    quantization_buffer_pool_(std::make_shared<ObjectPool<std::vector<uint8_t> > >(128)),
+    point_cloud_pool_(std::make_shared<ObjectPool<std::unique_ptr<draco::PointCloud> > >(128)),
+    region_message_pool_(std::make_shared<ObjectPool<sensor_msgs::PointCloud2> >(4)),
+    encode_pool_threads_(0), chunk_frame_(0), stop_encoder_thread_(false), encoder_generation_(0),
+    dropped_frames_(0) {}
+
+  virtual ~DracoPublisher()
+  {
+    stopEncoderThread();
+  }
 
   virtual std::string getTransportName() const
   {
     return "draco";
   }
 
+  virtual void shutdown();
+
+  //! subscribers of main topic and all quality tiers
+  virtual uint32_t getNumSubscribers() const;
+
+  //! number of frames dropped from full queue of asynchronous encoder
+  uint64_t getDroppedFrames() const;
+
 protected:
   // Overridden to set up reconfigure server
   virtual void advertiseImpl(ros::NodeHandle &nh, const std::string &base_topic, uint32_t queue_size,
@@ -32,11 +71,190 @@ protected:
   typedef draco_point_cloud_transport::DracoPublisherConfig Config;
   typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
   boost::shared_ptr<ReconfigureServer> reconfigure_server_;
-  Config config_;
+  //! configuration set by reconfigure server
+  Config base_config_;
+  //! configuration used for encoding, base_config_ with settings chosen by rate control
+  mutable Config config_;
+  //! incremented on every reconfiguration and change of rate control settings
+  mutable std::atomic<uint32_t> config_revision_;
+  mutable std::mutex config_mutex_;
+
+  //! adjusts encode speed and quantization towards bandwidth and latency targets
+  mutable RateController rate_controller_;
 
   void configCb(Config& config, uint32_t level);
 
+  //! metrics published on statistics topic
+  enum PublisherMetric
+  {
+    CONVERT_TIME, ENCODE_TIME, SERIALIZE_TIME, PUBLISH_TIME, INPUT_BYTES, OUTPUT_BYTES, COMPRESSION_RATIO,
+    INPUT_POINTS, ENCODED_POINTS, ALLOCATIONS, DROPPED_FRAMES
+  };
+
+  //! measurements of stages of one message for statistics topic
+  struct MessageStatistics
+  {
+    explicit MessageStatistics(bool enabled) : timer(enabled), convert_seconds(0.0), encode_seconds(0.0), serialize_seconds(0.0),
+      publish_seconds(0.0), encoded_points(0) {}
+
+    StageTimer timer;
+    double convert_seconds;
+    double encode_seconds;
+    double serialize_seconds;
+    double publish_seconds;
+    uint64_t encoded_points;
+  };
+
+  //! quality tier advertised on <base_topic>/draco/<name>, encoded from a conversion shared with other tiers
+  struct QualityTier
+  {
+    std::string name;
+    ros::Publisher publisher;
+    //! encoding plan of tier, cached like plan_
+    mutable std::shared_ptr<const EncodingPlan> plan;
+  };
+
+  //! filters message by region of interest, converts and encodes it and passes it to publish_fn, in progressive mode as a sequence of chunks
+  void encodeAndPublish(const sensor_msgs::PointCloud2& message, const Config& config, uint32_t config_revision,
+                        const PublishFn& publish_fn) const;
+
+  //! converts and encodes message into compressed_data of compressed, returns false if encoding failed
+  bool encodeMessage(const sensor_msgs::PointCloud2& message, const Config& config, uint32_t config_revision,
+                     draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const;
+
+  //! number of objects allocated by pools of recycled messages and buffers
+  size_t poolAllocations() const;
+
+  //! passes measurement of encoded message to rate control and applies its new settings
+  void updateRateControl(const Config& config, size_t compressed_bytes, double encode_seconds) const;
+
+  //! returns cached encoding plan, resolved again if field layout of message or configuration changed
+  std::shared_ptr<const EncodingPlan> encodingPlan(const sensor_msgs::PointCloud2& message, const Config& config,
+                                                   uint32_t config_revision) const;
+
+  //! returns encoding plan cached in cached_plan, resolved again if field layout of message or configuration changed
+  std::shared_ptr<const EncodingPlan> encodingPlan(const sensor_msgs::PointCloud2& message, const Config& config,
+                                                   uint32_t config_revision, std::shared_ptr<const EncodingPlan>& cached_plan) const;
+
+  //! configuration of quality tier, encoder quantization without prequantization so all tiers share one conversion
+  static Config tierConfig(const Config& config, int quantization_POSITION, int encode_speed, int decode_speed);
+
+  //! main topic can be encoded from conversion shared with quality tiers
+  static bool sharesConversion(const Config& config);
+
+  //! converts message once and encodes it in parallel for each of tiers, main topic included if main_publish_fn is set;
+  //! publishes encoded messages and returns sizes of main and tier messages
+  void encodeTiers(const sensor_msgs::PointCloud2& message, const Config& config, uint32_t config_revision,
+                   const std::vector<std::pair<const QualityTier*, Config> >& tiers, const PublishFn* main_publish_fn,
+                   size_t& main_bytes, size_t& tier_bytes, MessageStatistics& statistics) const;
+
+  //! assigns description of message to compressed message of one frame and resets its chunk and frame fields
+  static void initializeCompressed(draco_point_cloud_transport::CompressedPointCloud2& compressed, const sensor_msgs::PointCloud2& message);
+
+  //! stores settings used for encoding in compressed
+  static void assignEncoderSettings(draco_point_cloud_transport::CompressedPointCloud2& compressed, const Config& config);
+
+  //! converts number_of_points points of message starting at first_point into draco point cloud, point cloud (and storage of its
+  //! attributes) returns to pool when released
+  boost::shared_ptr<draco::PointCloud> convert(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const Config& config,
+                                             uint32_t first_point, uint32_t number_of_points) const;
+
+  //! encodes draco point cloud into encode_buffer, returns false if encoding failed
+  bool encode(const draco::PointCloud& pc, const EncodingPlan& plan, const Config& config,
+              draco::EncoderBuffer& encode_buffer) const;
+
+  //! configuration for point clouds with integer attributes only, which are encoded sequentially to keep order of points
+  static Config integerConfig(const Config& config);
+
+  //! encodes draco point cloud into compressed_data of compressed, returns false if encoding failed
+  bool encodeInto(const draco::PointCloud& pc, const EncodingPlan& plan, const Config& config,
+                  draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const;
+
+  //! splits message into tiles, encodes them in parallel and packs them into compressed
+  bool encodeTiles(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const Config& config,
+                   draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const;
+
+  //! encodes each attribute of message as independent stream in parallel and packs them into compressed
+  bool encodeStreams(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const Config& config,
+                     draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const;
+
+  //! copies encoded chunks (tiles, attribute streams) into compressed_data and sets chunk_offsets
+  static void packChunks(const std::vector<boost::shared_ptr<draco::EncoderBuffer> >& chunk_buffers,
+                         draco_point_cloud_transport::CompressedPointCloud2& compressed);
+
+  //! returns pool of encoding threads, (re)created if number of threads changed; callers hold the returned pointer until
+  //! their tasks finished, so a pool replaced by reconfiguration outlives frames still encoded on it
+  std::shared_ptr<ThreadPool> encodePool(int number_of_threads) const;
+
   std::string base_topic_;
+
+  mutable std::shared_ptr<const EncodingPlan> plan_;
+  mutable std::mutex plan_mutex_;
+
+  //! quality tiers, advertised only with quality_tiers
+  QualityTier low_tier_;
+  QualityTier high_tier_;
+  //! advertise settings of main topic used for tiers, guarded by tiers_mutex_ together with tier publishers
+  ros::NodeHandle tiers_nh_;
+  uint32_t tiers_queue_size_;
+  bool tiers_latch_;
+  bool tiers_advertisable_;
+  mutable std::mutex tiers_mutex_;
+
+  //! advertises quality tiers if enabled and the main topic is advertised, shuts them down otherwise
+  void updateQualityTiers(bool enabled);
+
+  //! copy of publisher of tier, empty if tier is not advertised
+  ros::Publisher tierPublisher(const QualityTier& tier) const;
+
+  //! state recycled between frames
+  std::shared_ptr<ObjectPool<draco_point_cloud_transport::CompressedPointCloud2> > message_pool_;
+  std::shared_ptr<ObjectPool<draco::EncoderBuffer> > encode_buffer_pool_;
+  std::shared_ptr<ObjectPool<std::vector<uint8_t> > > quantization_buffer_pool_;
+  std::shared_ptr<ObjectPool<std::unique_ptr<draco::PointCloud> > > point_cloud_pool_;
+  //! points of messages within region of interest
+  std::shared_ptr<ObjectPool<sensor_msgs::PointCloud2> > region_message_pool_;
+
+  //! statistics published on <base_topic>/draco/stats/publisher, created by advertiseImpl
+  std::unique_ptr<Statistics> statistics_;
+
+  //! reference frame of temporal compression
+  mutable TemporalEncoder temporal_encoder_;
+  mutable std::mutex temporal_mutex_;
+
+  mutable std::shared_ptr<ThreadPool> encode_pool_;
+  mutable int encode_pool_threads_;
+  mutable std::mutex encode_pool_mutex_;
+
+  //! identifies chunks of one cloud in progressive mode
+  mutable std::atomic<uint32_t> chunk_frame_;
+
+  //! message waiting for asynchronous encoder
+  struct QueuedMessage
+  {
+    sensor_msgs::PointCloud2ConstPtr message;
+    Config config;
+    uint32_t config_revision;
+    PublishFn publish_fn;
+  };
+
+  //! starts asynchronous encoder thread if it is not running, called with queue_mutex_ held
+  void startEncoderThread() const;
+
+  //! stops asynchronous encoder thread and drops queued messages
+  void stopEncoderThread();
+
+  //! loop of asynchronous encoder thread
+  void encoderThread() const;
+
+  mutable std::deque<QueuedMessage> queue_;
+  mutable std::mutex queue_mutex_;
+  mutable std::condition_variable queue_condition_;
+  mutable std::thread encoder_thread_;
+  mutable bool stop_encoder_thread_;
+  //! incremented by every stop, publish() waiting for free space across a stop drops its message
+  mutable uint64_t encoder_generation_;
+  mutable std::atomic<uint64_t> dropped_frames_;
 };
 
 } //namespace draco_point_cloud_transport
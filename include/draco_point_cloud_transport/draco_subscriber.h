@@ -5,13 +5,37 @@
 #include <draco_point_cloud_transport/CompressedPointCloud2.h>
 #include <dynamic_reconfigure/server.h>
 #include <draco_point_cloud_transport/DracoSubscriberConfig.h>
+#include "draco_point_cloud_transport/object_pool.h"
+#include "draco_point_cloud_transport/statistics.h"
+#include "draco_point_cloud_transport/temporal_coding.h"
+#include "draco_point_cloud_transport/thread_pool.h"
+
+// draco
+#include <draco/point_cloud/point_cloud.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+class DracotoPC2;
 
 namespace draco_point_cloud_transport {
 
 class DracoSubscriber : public point_cloud_transport::SimpleSubscriberPlugin<draco_point_cloud_transport::CompressedPointCloud2>
 {
 public:
-  virtual ~DracoSubscriber() {}
+  DracoSubscriber() : message_pool_(std::make_shared<ObjectPool<sensor_msgs::PointCloud2> >(4)), quantization_advertisable_(false), decode_pool_threads_(0), assembled_frame_(0),
+    assembled_chunks_(0), next_sequence_(0), next_delivery_(0), delivering_(false), skipped_frames_(0), frame_pool_threads_(0) {}
+
+  virtual ~DracoSubscriber()
+  {
+    stopFramePool();
+  }
 
   virtual std::string getTransportName() const
   {
@@ -20,6 +44,18 @@ public:
 
   virtual void shutdown();
 
+  //! allocates PointCloud2 messages into which frames are decoded before they are handed to user callback, e.g. from a pool owned by
+  //! an intra-process consumer; data of returned message keeps its allocated storage. Empty allocator restores the internal pool.
+  typedef std::function<sensor_msgs::PointCloud2Ptr()> OutputAllocator;
+  void setOutputAllocator(const OutputAllocator& allocator);
+
+  //! decodes message into caller provided PointCloud2 with current configuration, data of PC2 keeps its allocated storage;
+  //! returns false if message could not be decoded. Must not be called concurrently with subscription callbacks.
+  bool decodeInto(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message, sensor_msgs::PointCloud2& PC2);
+
+  //! number of received frames dropped from queue of frame decoding threads before they were decoded
+  uint64_t getSkippedFrames() const;
+
 protected:
   // Overridden to set up reconfigure server
   virtual void subscribeImpl(ros::NodeHandle& nh, const std::string& base_topic, uint32_t queue_size,
@@ -29,12 +65,164 @@ protected:
   virtual void internalCallback(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
                                 const Callback& user_cb);
 
+  //! <base_topic>/draco, or topic of quality tier requested through transport hints
+  virtual std::string getTopicToSubscribe(const std::string& base_topic) const;
+
   typedef draco_point_cloud_transport::DracoSubscriberConfig Config;
   typedef dynamic_reconfigure::Server<Config> ReconfigureServer;
   boost::shared_ptr<ReconfigureServer> reconfigure_server_;
+  //! set by reconfigure server while messages are decoded, guarded by config_mutex_
   Config config_;
+  mutable std::mutex config_mutex_;
 
   void configCb(Config& config, uint32_t level);
+
+  //! decodes buffer with compressed data into draco point cloud, returns nullptr if decoding failed
+  std::unique_ptr<draco::PointCloud> decode(const unsigned char* data, size_t size, const Config& config) const;
+
+  //! metrics published on statistics topic
+  enum SubscriberMetric
+  {
+    DECODE_TIME, SCATTER_TIME, INPUT_BYTES, OUTPUT_BYTES, COMPRESSION_RATIO, DECODED_POINTS, ALLOCATIONS, QUEUE_AGE, SKIPPED_FRAMES
+  };
+
+  //! measurements of stages of one message for statistics topic
+  struct DecodeStatistics
+  {
+    explicit DecodeStatistics(bool enabled) : timer(enabled), decode_seconds(0.0), scatter_seconds(0.0) {}
+
+    StageTimer timer;
+    double decode_seconds;
+    double scatter_seconds;
+  };
+
+  //! decodes message into message from allocator of user or internal pool and records statistics, returns nullptr if it could not be decoded
+  sensor_msgs::PointCloud2Ptr decodeFrame(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message, const Config& config);
+
+  //! assembles chunks if requested and passes decoded frame to user callback
+  void deliverFrame(const draco_point_cloud_transport::CompressedPointCloud2& message, const Config& config,
+                    sensor_msgs::PointCloud2Ptr PC2, const Callback& user_cb);
+
+  //! decodes message in place into PC2, returns false if it could not be decoded
+  bool decodeMessage(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
+                     const Config& config, const std::vector<std::string>& field_names,
+                     DecodeStatistics& statistics, sensor_msgs::PointCloud2& PC2);
+
+  //! decodes tiles of message in parallel and stitches them into PC2
+  bool decodeTiles(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
+                   const Config& config, const std::vector<std::string>& field_names,
+                   DecodeStatistics& statistics, sensor_msgs::PointCloud2& PC2);
+
+  //! publishes scale and offsets of integer fields delivered by converter for number_of_points points starting at first_point
+  //! (0 = all points), if anybody subscribed them
+  void publishQuantization(const DracotoPC2& converter, const std_msgs::Header& header, uint32_t first_point,
+                           uint32_t number_of_points) const;
+
+  //! writes fields of attribute streams decoded by converters into PC2 in parallel
+  bool scatterStreams(const draco_point_cloud_transport::CompressedPointCloud2& message,
+                      const std::vector<std::unique_ptr<DracotoPC2> >& converters, ThreadPool& decode_pool,
+                      DecodeStatistics& statistics, sensor_msgs::PointCloud2& PC2);
+
+  //! returns pool of tile and stream decoding threads, (re)created if number of threads changed; callers hold the returned
+  //! pointer until their tasks finished, so a pool replaced by reconfiguration outlives frames still decoded on it
+  std::shared_ptr<ThreadPool> decodePool(int number_of_threads);
+
+  //! received frame waiting for frame decoding threads
+  struct PendingFrame
+  {
+    draco_point_cloud_transport::CompressedPointCloud2ConstPtr message;
+    Config config;
+    Callback user_cb;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  //! decoded frame waiting for delivery of preceding frames
+  struct DecodedFrame
+  {
+    PendingFrame frame;
+    sensor_msgs::PointCloud2Ptr PC2;
+  };
+
+  //! queues frame for frame decoding threads, skipping stale frames
+  void queueFrame(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message, const Config& config, const Callback& user_cb);
+
+  //! task of frame decoding threads: decodes oldest queued frame and delivers decoded frames in order of reception
+  void decodeQueuedFrame();
+
+  //! stops frame decoding threads and drops queued frames
+  void stopFramePool();
+
+  //! attribute types (indexed by draco::GeometryAttribute::Type) with skipped dequantization
+  static std::vector<bool> skippedDequantization(const Config& config);
+
+  //! fields delivered to user, empty list delivers all fields in original layout
+  std::vector<std::string> requestedFields(const draco_point_cloud_transport::CompressedPointCloud2& message, const Config& config) const;
+
+  //! message decoded frame is written into, from allocator of user or internal pool
+  sensor_msgs::PointCloud2Ptr acquireOutput();
+
+  //! appends decoded chunk of progressively sent cloud, returns the whole cloud after its last chunk, nullptr otherwise
+  sensor_msgs::PointCloud2Ptr assembleChunk(const draco_point_cloud_transport::CompressedPointCloud2& message,
+                                            const sensor_msgs::PointCloud2Ptr& chunk);
+
+  //! comma separated list of fields requested through transport hints
+  std::string hint_fields_;
+  //! quality tier (low, high) requested through transport hints, empty for main topic
+  std::string hint_tier_;
+
+  //! decoded messages recycled after user callbacks release them
+  std::shared_ptr<ObjectPool<sensor_msgs::PointCloud2> > message_pool_;
+
+  //! allocator of user replacing message_pool_, empty if not set
+  OutputAllocator output_allocator_;
+  std::mutex output_allocator_mutex_;
+
+  //! statistics published on <base_topic>/draco/stats/subscriber, created by subscribeImpl
+  std::unique_ptr<Statistics> statistics_;
+
+  //! scale and offsets of fields delivered as quantized integers, published on ~<base_topic>/draco/quantization in private
+  //! namespace of subscribing node while dequantization of any attribute type is skipped; guarded by quantization_mutex_
+  ros::Publisher quantization_publisher_;
+  bool quantization_advertisable_;
+  mutable std::mutex quantization_mutex_;
+
+  //! advertises quantization topic if dequantization is skipped and topic is subscribed, shuts it down otherwise
+  void updateQuantizationPublisher(const Config& config);
+
+  //! copy of quantization publisher, empty if it is not advertised
+  ros::Publisher quantizationPublisher() const;
+
+  //! reference frame of temporal compression
+  TemporalDecoder temporal_decoder_;
+
+  std::shared_ptr<ThreadPool> decode_pool_;
+  int decode_pool_threads_;
+  std::mutex decode_pool_mutex_;
+
+  //! cloud assembled from chunks received so far
+  sensor_msgs::PointCloud2Ptr assembled_;
+  uint32_t assembled_frame_;
+  uint32_t assembled_chunks_;
+
+  //! frames received but not yet decoded by frame decoding threads
+  std::deque<PendingFrame> pending_frames_;
+  //! frames decoded ahead of preceding ones, by sequence
+  std::map<uint64_t, DecodedFrame> decoded_frames_;
+  //! sequence of next frame taken from pending_frames_
+  uint64_t next_sequence_;
+  //! sequence of next frame delivered to user callback
+  uint64_t next_delivery_;
+  //! one thread delivers decoded frames at a time
+  bool delivering_;
+  std::mutex frames_mutex_;
+  std::condition_variable frames_condition_;
+  std::atomic<uint64_t> skipped_frames_;
+
+  //! threads decoding whole frames, declared last so they are joined before other members are destroyed; a pool replaced by
+  //! reconfiguration is destroyed by a task of its successor
+  std::shared_ptr<ThreadPool> frame_pool_;
+  int frame_pool_threads_;
+  std::mutex frame_pool_mutex_;
 };
 
 } //namespace draco_point_cloud_transport
@@ -0,0 +1,95 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_ENCODING_PLAN_H
+#define DRACO_POINT_CLOUD_TRANSPORT_ENCODING_PLAN_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+
+// draco
+#include <draco/attributes/geometry_attribute.h>
+
+// point_cloud_transport
+#include <draco_point_cloud_transport/DracoPublisherConfig.h>
+#include "draco_point_cloud_transport/field_layout.h"
+
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Resolved encoding of one sensor_msgs::PointField entry
+struct FieldEncoding
+{
+    //! draco attribute type of field
+    draco::GeometryAttribute::Type attribute_type;
+    //! draco data type of values in PointCloud2, DT_INVALID if field can not be encoded
+    draco::DataType data_type;
+    //! draco data type and number of components of attribute (differs from field for rgba tweak)
+    draco::DataType attribute_data_type;
+    int num_components;
+    //! rgb/rgba color packed into one variable is encoded as separate color components
+    bool rgba_tweak;
+    //! user specified quantization bits for expert encoder, -1 if not specified
+    int expert_quantization_bits;
+    //! number of bits if field is quantized during conversion, 0 otherwise
+    int prequantization_bits;
+    //! draco attribute holding values of field, -1 if field is not encoded (invalid datatype, outside of point_step);
+    //! duplicates share attribute of the field they duplicate, merged fields share attribute of the first field of their group
+    int attribute_id;
+    //! field duplicates an earlier field and adds no attribute of its own
+    bool duplicate;
+    //! component of attribute holding first value of field, > 0 for all but the first field of a merged group
+    int first_component;
+    //! first field of a merged group (e.g. x of x, y, z) adds an attribute with this many components, 0 if field is not merged
+    int merged_components;
+};
+
+//! Encoding of all PointField entries of one field layout, resolved once from configuration and parameter server
+class EncodingPlan
+{
+public:
+    //! Constructor, resolves encoding of all fields of PC2
+    EncodingPlan(const sensor_msgs::PointCloud2& PC2, const DracoPublisherConfig& config, uint32_t config_revision, const std::string& base_topic);
+
+    //! hash of field names, datatypes, offsets, counts and point_step of PC2
+    static size_t layout_hash(const sensor_msgs::PointCloud2& PC2);
+
+    //! checks if plan can be used for point cloud with layout_hash encoded with given config revision
+    bool matches(size_t layout_hash, uint32_t config_revision) const;
+
+    //! encoding of PointField entries, in order of fields of PointCloud2
+    const std::vector<FieldEncoding>& fields() const;
+
+    //! all quantization bits for expert encoder were specified
+    bool expert_quantization_ok() const;
+
+    //! padding, duplicate and overlapping fields of the field layout
+    const FieldLayout& layout() const;
+
+    //! number of attributes of converted draco point cloud
+    int number_of_attributes() const;
+
+    //! field adds an attribute of its own (attribute_id) to converted draco point cloud
+    static bool adds_attribute(const FieldEncoding& encoding);
+
+private:
+    //! merges adjacent fields of one datatype and attribute type (x, y, z / nx, ny, nz / r, g, b, a) into multi-component attributes
+    void merge_contiguous_fields();
+
+    //! assigns draco attributes to fields
+    void assign_attributes();
+
+    //! detects attribute type from recognized field names
+    static draco::GeometryAttribute::Type recognized_attribute_type(const std::string& name, bool& rgba_tweak);
+
+    std::vector<FieldEncoding> fields_;
+    FieldLayout layout_;
+    int number_of_attributes_;
+    bool expert_quantization_ok_;
+    size_t layout_hash_;
+    uint32_t config_revision_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_ENCODING_PLAN_H
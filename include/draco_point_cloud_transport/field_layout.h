@@ -0,0 +1,55 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_FIELD_LAYOUT_H
+#define DRACO_POINT_CLOUD_TRANSPORT_FIELD_LAYOUT_H
+
+// ros
+#include <sensor_msgs/PointField.h>
+
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Analysis of PointField entries within point_step: padding, invalid, duplicate and overlapping fields and groups of
+//! contiguous fields, done once per field layout
+class FieldLayout
+{
+public:
+    //! Constructor, analyzes fields of points with point_step
+    FieldLayout(const std::vector<sensor_msgs::PointField>& fields, uint32_t point_step);
+
+    //! field has known datatype and lies within point_step
+    bool valid(size_t field_index) const;
+
+    //! index of earlier valid field with same offset, datatype and count, -1 if field is not a duplicate
+    int duplicate_of(size_t field_index) const;
+
+    //! field shares bytes with another valid field without being its duplicate
+    bool overlapping(size_t field_index) const;
+
+    //! bytes of point_step covered by valid fields
+    uint32_t payload_bytes() const;
+
+    //! bytes of point_step not covered by any valid field
+    uint32_t padding_bytes() const;
+
+    //! groups of at least two valid, non-duplicate fields with count 1 and same datatype, each following the previous one without gap;
+    //! fields of each group are ordered by offset
+    const std::vector<std::vector<size_t> >& contiguous_groups() const;
+
+    //! human readable summary, e.g. for log
+    std::string describe() const;
+
+private:
+    std::vector<sensor_msgs::PointField> fields_;
+    uint32_t point_step_;
+    std::vector<uint8_t> valid_;
+    std::vector<int> duplicate_of_;
+    std::vector<uint8_t> overlapping_;
+    uint32_t payload_bytes_;
+    std::vector<std::vector<size_t> > contiguous_groups_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_FIELD_LAYOUT_H
@@ -0,0 +1,57 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_LOSSLESS_H
+#define DRACO_POINT_CLOUD_TRANSPORT_LOSSLESS_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+
+// draco
+#include <draco/point_cloud/point_cloud.h>
+
+// point_cloud_transport
+#include "draco_point_cloud_transport/CompressedPointCloud2.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Converts sensor_msgs::PointCloud2 into draco point cloud from which every byte of data is restored: points keep their order,
+//! fields are integer attributes holding their bits (floats including NaN are not interpreted), bytes of point_step not covered
+//! by fields (padding, overlapping fields, unknown datatypes) are uint8 attributes and padding of rows is stored in metadata
+class PC2toLossless
+{
+public:
+    //! Constructor, PC2 must outlive the converter
+    explicit PC2toLossless(const sensor_msgs::PointCloud2& PC2);
+
+    //! converts into draco point cloud with integer attributes only, returns nullptr if conversion failed
+    std::unique_ptr<draco::PointCloud> convert() const;
+
+private:
+    const sensor_msgs::PointCloud2& PC2_;
+};
+
+//! Restores sensor_msgs::PointCloud2 converted by PC2toLossless byte for byte
+class LosslesstoPC2
+{
+public:
+    //! Constructor, pc and compressed must outlive the converter
+    LosslesstoPC2(const draco::PointCloud& pc, const draco_point_cloud_transport::CompressedPointCloud2& compressed);
+
+    //! checks if pc was converted by PC2toLossless
+    static bool is_lossless(const draco::PointCloud& pc);
+
+    //! converts into PC2, identical to the original if field_names is empty, otherwise projected to field_names;
+    //! returns false if point cloud is corrupted
+    bool convert(const std::vector<std::string>& field_names, sensor_msgs::PointCloud2& PC2) const;
+
+private:
+    const draco::PointCloud& pc_;
+    const draco_point_cloud_transport::CompressedPointCloud2& compressed_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_LOSSLESS_H
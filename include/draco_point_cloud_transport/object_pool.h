@@ -0,0 +1,101 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_OBJECT_POOL_H
+#define DRACO_POINT_CLOUD_TRANSPORT_OBJECT_POOL_H
+
+#include <boost/shared_ptr.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Pool of recycled objects (messages, buffers), objects keep their allocated storage between uses.
+//! Must be owned by std::shared_ptr, objects outliving the pool are deleted normally.
+template <typename T>
+class ObjectPool : public std::enable_shared_from_this<ObjectPool<T> >
+{
+public:
+    //! Constructor, at most max_size released objects are kept for reuse
+    explicit ObjectPool(size_t max_size) : max_size_(max_size), allocations_(0) {}
+
+    //! returns object from pool, or a new one if pool is empty; object returns to pool when its last reference is released
+    boost::shared_ptr<T> acquire()
+    {
+        std::unique_ptr<T> object;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!objects_.empty())
+            {
+                object = std::move(objects_.back());
+                objects_.pop_back();
+            }
+        }
+        if (object == nullptr)
+        {
+            object.reset(new T());
+            allocations_++;
+        }
+
+        Recycler recycler;
+        recycler.pool = this->shared_from_this();
+        return boost::shared_ptr<T>(object.release(), recycler);
+    }
+
+    //! keeps at most max_size released objects for reuse
+    void set_max_size(size_t max_size)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_size_ = max_size;
+        if (objects_.size() > max_size_)
+        {
+            objects_.resize(max_size_);
+        }
+    }
+
+    //! number of objects allocated because pool was empty
+    size_t allocations() const
+    {
+        return allocations_;
+    }
+
+private:
+    //! deleter returning object to pool
+    struct Recycler
+    {
+        std::weak_ptr<ObjectPool<T> > pool;
+
+        void operator()(T* object) const
+        {
+            std::shared_ptr<ObjectPool<T> > locked_pool = pool.lock();
+            if (locked_pool != nullptr)
+            {
+                locked_pool->release(object);
+            }
+            else
+            {
+                delete object;
+            }
+        }
+    };
+
+    void release(T* object)
+    {
+        std::unique_ptr<T> released(object);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (objects_.size() < max_size_)
+        {
+            objects_.push_back(std::move(released));
+        }
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<T> > objects_;
+    size_t max_size_;
+    std::atomic<size_t> allocations_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_OBJECT_POOL_H
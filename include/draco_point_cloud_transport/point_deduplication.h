@@ -0,0 +1,62 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_POINT_DEDUPLICATION_H
+#define DRACO_POINT_CLOUD_TRANSPORT_POINT_DEDUPLICATION_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+
+#include <utility>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Finds duplicate points of sensor_msgs::PointCloud2 before they are converted, using an open addressing hash table over a key
+//! of each point: x, y, z snapped to a grid (or their exact values) and optionally the bytes of all other fields.
+//! The first point of each key is kept, points keep their order.
+class PointDeduplicator
+{
+public:
+    //! Constructor, PC2 must outlive the deduplicator. Points are duplicates if float32 x, y, z fall into the same cell of a grid
+    //! with cell size tolerance (equal values if tolerance is 0) and, with compare_attributes, all other fields are equal as well.
+    //! Without x, y, z fields all fields are compared. Tolerance > 0 without compare_attributes keeps one point per voxel.
+    PointDeduplicator(const sensor_msgs::PointCloud2& PC2, double tolerance, bool compare_attributes);
+
+    //! finds unique points among number_of_points points starting at first_point, returns number of unique points
+    uint32_t deduplicate(uint32_t first_point, uint32_t number_of_points);
+
+    //! indices of unique points relative to first_point, in increasing order
+    const std::vector<uint32_t>& unique_points() const;
+
+    //! for each point (relative to first_point) index of unique point representing it, never greater than index of point
+    const std::vector<int32_t>& point_map() const;
+
+    //! copies unique points into out_data, packed with point_step of PC2
+    void gather(uint32_t first_point, std::vector<uint8_t>& out_data) const;
+
+private:
+    //! hash of key of point
+    uint64_t hash(const uint8_t* point) const;
+
+    //! points have equal keys
+    bool equal_keys(const uint8_t* a, const uint8_t* b) const;
+
+    //! grid cell of float32 coordinate at offset, non-finite values are their own cells
+    int64_t cell(const uint8_t* point, uint32_t offset) const;
+
+    const sensor_msgs::PointCloud2& PC2_;
+    double inverse_tolerance_;
+
+    //! byte ranges (offset, size) of point compared exactly
+    std::vector<std::pair<uint32_t, uint32_t> > exact_segments_;
+    //! offsets of x, y, z snapped to grid, empty if positions are compared exactly
+    std::vector<uint32_t> position_offsets_;
+
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> table_;
+    std::vector<uint32_t> unique_points_;
+    std::vector<int32_t> point_map_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_POINT_DEDUPLICATION_H
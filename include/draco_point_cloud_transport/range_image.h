@@ -0,0 +1,60 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_RANGE_IMAGE_H
+#define DRACO_POINT_CLOUD_TRANSPORT_RANGE_IMAGE_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+
+// draco
+#include <draco/point_cloud/point_cloud.h>
+
+// point_cloud_transport
+#include "draco_point_cloud_transport/CompressedPointCloud2.h"
+#include "draco_point_cloud_transport/encoding_plan.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Converts organized sensor_msgs::PointCloud2 into range image: quantized range of valid points and residuals of their
+//! azimuth and elevation to per column azimuth and per row elevation tables, other fields of valid points are kept as they are
+class PC2toRangeImage
+{
+public:
+    //! Constructor, PC2 and plan must outlive the converter
+    PC2toRangeImage(const sensor_msgs::PointCloud2& PC2, const EncodingPlan& plan);
+
+    //! checks if PC2 is organized and has float32 x, y and z fields
+    static bool compatible(const sensor_msgs::PointCloud2& PC2);
+
+    //! converts into draco point cloud with range quantized to bits (at most 24), returns nullptr if conversion failed
+    std::unique_ptr<draco::PointCloud> convert(int bits) const;
+
+private:
+    const sensor_msgs::PointCloud2& PC2_;
+    const EncodingPlan& plan_;
+};
+
+//! Restores organized sensor_msgs::PointCloud2 from range image, invalid points get NaN coordinates and zero other fields
+class RangeImagetoPC2
+{
+public:
+    //! Constructor, pc and compressed must outlive the converter
+    RangeImagetoPC2(const draco::PointCloud& pc, const draco_point_cloud_transport::CompressedPointCloud2& compressed);
+
+    //! checks if pc was converted by PC2toRangeImage
+    static bool is_range_image(const draco::PointCloud& pc);
+
+    //! converts into PC2 with fields projected to field_names, returns false if range image is corrupted
+    bool convert(const std::vector<std::string>& field_names, sensor_msgs::PointCloud2& PC2) const;
+
+private:
+    const draco::PointCloud& pc_;
+    const draco_point_cloud_transport::CompressedPointCloud2& compressed_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_RANGE_IMAGE_H
@@ -0,0 +1,49 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_RATE_CONTROL_H
+#define DRACO_POINT_CLOUD_TRANSPORT_RATE_CONTROL_H
+
+// point_cloud_transport
+#include <draco_point_cloud_transport/DracoPublisherConfig.h>
+
+#include <chrono>
+#include <cstddef>
+
+namespace draco_point_cloud_transport
+{
+
+//! Closed loop control of encode speed and quantization bits towards target bandwidth and maximal encode latency
+class RateController
+{
+public:
+    RateController();
+
+    //! starts again from configured settings
+    void reset(const DracoPublisherConfig& config);
+
+    //! adds measurement of one encoded message, returns true if chosen settings changed
+    bool update(const DracoPublisherConfig& config, size_t compressed_bytes, double encode_seconds, std::chrono::steady_clock::time_point now);
+
+    //! replaces encode speed and quantization bits of config with chosen settings
+    void apply(DracoPublisherConfig& config) const;
+
+private:
+    //! largest reduction of quantization bits allowed by min_quantization_bits
+    static int max_quantization_reduction(const DracoPublisherConfig& config);
+
+    //! chosen settings
+    int encode_speed_;
+    int quantization_reduction_;
+
+    //! smoothed measurements
+    double average_bytes_;
+    double average_encode_seconds_;
+    double average_interval_;
+    std::chrono::steady_clock::time_point last_update_;
+    bool has_measurement_;
+
+    //! settings are changed only after measurements reflect the previous change
+    unsigned frames_since_change_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_RATE_CONTROL_H
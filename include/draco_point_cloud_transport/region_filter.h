@@ -0,0 +1,51 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_REGION_FILTER_H
+#define DRACO_POINT_CLOUD_TRANSPORT_REGION_FILTER_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+#include <draco_point_cloud_transport/DracoPublisherConfig.h>
+
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Region of interest applied to sensor_msgs::PointCloud2 before conversion: axis-aligned box, range gate, azimuth sector
+//! and voxel downsampling, all in frame of the cloud. Points outside the region never reach PC2toDraco and the encoder.
+class RegionFilter
+{
+public:
+    //! Constructor, takes region from roi_* settings of config
+    explicit RegionFilter(const DracoPublisherConfig& config);
+
+    //! any part of region limits points
+    bool active() const;
+
+    //! copies points of PC2 within region into out_PC2 as unorganized cloud, keeping their order; returns false if PC2 has no
+    //! float32 x, y, z fields and can not be filtered. Points with non-finite coordinates are outside of any limited region.
+    bool apply(const sensor_msgs::PointCloud2& PC2, sensor_msgs::PointCloud2& out_PC2) const;
+
+private:
+    //! marks number_of_points points with coordinates x, y, z within region (box, range, azimuth) in keep
+    void classify(const float* x, const float* y, const float* z, uint32_t number_of_points, uint8_t* keep) const;
+
+    bool box_;
+    float min_[3];
+    float max_[3];
+
+    bool range_;
+    float min_range_squared_;
+    float max_range_squared_;
+
+    //! sector is bounded by directions (cos, sin) of its start and end azimuth
+    bool sector_;
+    bool sector_wider_than_half_turn_;
+    float start_direction_[2];
+    float end_direction_[2];
+
+    double voxel_size_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_REGION_FILTER_H
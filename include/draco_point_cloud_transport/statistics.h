@@ -0,0 +1,107 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_STATISTICS_H
+#define DRACO_POINT_CLOUD_TRANSPORT_STATISTICS_H
+
+// ros
+#include <ros/ros.h>
+
+// point_cloud_transport
+#include "draco_point_cloud_transport/DracoMetric.h"
+#include "draco_point_cloud_transport/DracoStatistics.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Histogram of non-negative values with logarithmic buckets (8 per power of two)
+class Histogram
+{
+public:
+    Histogram();
+
+    void add(double value);
+
+    void reset();
+
+    //! fills count, mean, min, max and percentiles of metric
+    void fill(DracoMetric& metric) const;
+
+private:
+    static size_t bucket(double value);
+
+    //! representative value of bucket
+    static double bucket_value(size_t bucket);
+
+    //! value below which fraction of added values lies
+    double percentile(double fraction) const;
+
+    std::vector<uint32_t> buckets_;
+    uint32_t count_;
+    double sum_;
+    double min_;
+    double max_;
+};
+
+//! Metrics of messages of one topic aggregated into histograms, published periodically on <base_topic>/draco/stats/<role>
+class Statistics
+{
+public:
+    //! Constructor, metrics are indexed by order of names and units
+    Statistics(const std::string& role, const std::vector<std::string>& metric_names, const std::vector<std::string>& metric_units);
+
+    //! advertises stats/<role> topic in namespace of nh
+    void advertise(const ros::NodeHandle& nh);
+
+    //! publishes metrics every period seconds by timer on node handle of advertise, also while no message arrives;
+    //! period 0 stops publishing
+    void set_period(double period);
+
+    //! stops timer and publisher
+    void shutdown();
+
+    void add(size_t metric, double value);
+
+    void add_failure();
+
+private:
+    //! publishes and resets metrics aggregated since the last publication
+    void publish(const ros::WallTimerEvent& event);
+
+    std::string role_;
+    std::vector<std::string> metric_names_;
+    std::vector<std::string> metric_units_;
+    std::vector<Histogram> histograms_;
+    uint32_t failures_;
+    std::chrono::steady_clock::time_point period_start_;
+    ros::Publisher publisher_;
+    std::mutex mutex_;
+
+    //! node handle, timer and period of publication, guarded by timer_mutex_
+    ros::NodeHandle nh_;
+    ros::WallTimer timer_;
+    double period_;
+    std::mutex timer_mutex_;
+};
+
+//! Measures durations of stages of one message, the clock is not read when disabled
+class StageTimer
+{
+public:
+    explicit StageTimer(bool enabled);
+
+    //! seconds since construction or previous lap, 0 if disabled
+    double lap();
+
+    bool enabled() const;
+
+private:
+    bool enabled_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_STATISTICS_H
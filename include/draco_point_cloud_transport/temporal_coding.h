@@ -0,0 +1,86 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_TEMPORAL_CODING_H
+#define DRACO_POINT_CLOUD_TRANSPORT_TEMPORAL_CODING_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+
+// draco
+#include <draco/point_cloud/point_cloud.h>
+
+// point_cloud_transport
+#include "draco_point_cloud_transport/CompressedPointCloud2.h"
+#include "draco_point_cloud_transport/DracoPublisherConfig.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
+#include "draco_point_cloud_transport/encoding_plan.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! State of one PointField entry shared by key frame and following delta frames
+struct TemporalField
+{
+    //! quantization of float32 field fixed by key frame, bits = 0 for integer fields coded as raw values
+    QuantizationParameters quantization;
+    //! size of one component in Bytes, 4 for quantized fields
+    uint32_t component_size;
+    uint32_t count;
+    //! values of previous frame, one per component of each point
+    std::vector<uint32_t> reference;
+};
+
+//! Publisher side of temporal compression: key frames hold quantized values, delta frames residuals to previous frame
+class TemporalEncoder
+{
+public:
+    TemporalEncoder();
+
+    //! converts message into key or delta frame and sets frame_type and frame_sequence of compressed,
+    //! returns nullptr if fields of message can not be coded temporally (float64)
+    std::unique_ptr<draco::PointCloud> convert(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const DracoPublisherConfig& config,
+                                               uint32_t config_revision, draco_point_cloud_transport::CompressedPointCloud2& compressed);
+
+    //! next frame is a key frame
+    void reset();
+
+private:
+    //! sets up fields_ for key frame of message, returns false if a field can not be coded temporally
+    bool start_key_frame(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const DracoPublisherConfig& config);
+
+    //! reads values of field into values, returns false if a quantized value is outside of range fixed by key frame
+    static bool read_field(const sensor_msgs::PointCloud2& message, const sensor_msgs::PointField& field, const TemporalField& temporal_field,
+                           std::vector<uint32_t>& values);
+
+    std::vector<TemporalField> fields_;
+    size_t layout_hash_;
+    uint32_t config_revision_;
+    uint32_t number_of_points_;
+    uint32_t frames_since_key_frame_;
+    uint32_t sequence_;
+    bool has_reference_;
+};
+
+//! Subscriber side of temporal compression, keeps values of last frame as reference for delta frames
+class TemporalDecoder
+{
+public:
+    TemporalDecoder();
+
+    //! reconstructs key or delta frame pc into PC2 with fields projected to field_names,
+    //! returns false if reference frame of delta frame was not received
+    bool convert(const draco::PointCloud& pc, const draco_point_cloud_transport::CompressedPointCloud2& compressed,
+                 const std::vector<std::string>& field_names, sensor_msgs::PointCloud2& PC2);
+
+private:
+    std::vector<TemporalField> fields_;
+    uint32_t number_of_points_;
+    uint32_t sequence_;
+    bool has_reference_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_TEMPORAL_CODING_H
@@ -0,0 +1,59 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_THREAD_POOL_H
+#define DRACO_POINT_CLOUD_TRANSPORT_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+
+//! Fixed size pool of worker threads executing submitted tasks in FIFO order
+class ThreadPool
+{
+public:
+    //! Constructor, number_of_threads = 0 starts one thread per hardware thread
+    explicit ThreadPool(unsigned int number_of_threads);
+
+    //! Destructor, finishes queued tasks and joins all threads
+    ~ThreadPool();
+
+    //! number of worker threads
+    unsigned int size() const;
+
+    //! queues task for execution, returned future holds its result
+    template <typename TaskT>
+    std::future<decltype(std::declval<TaskT&>()())> submit(TaskT&& task)
+    {
+        typedef decltype(std::declval<TaskT&>()()) ResultT;
+
+        std::shared_ptr<std::packaged_task<ResultT()> > packaged_task =
+                std::make_shared<std::packaged_task<ResultT()> >(std::forward<TaskT>(task));
+        std::future<ResultT> result = packaged_task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push([packaged_task]() { (*packaged_task)(); });
+        }
+        condition_.notify_one();
+        return result;
+    }
+
+private:
+    //! loop of worker threads
+    void work();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()> > tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_;
+};
+
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_THREAD_POOL_H
@@ -1,11 +1,87 @@
 #include "draco_point_cloud_transport/DracotoPC2.h"
 #include "draco_point_cloud_transport/debug_msg.h"
+#include "draco_point_cloud_transport/field_layout.h"
+
+// draco
+#include <draco/attributes/attribute_quantization_transform.h>
+
+#include <cstring>
+
+namespace
+{
+
+//! PointField datatype of unsigned integer draco data type
+uint8_t point_field_datatype(draco::DataType data_type)
+{
+    switch (data_type)
+    {
+        case draco::DT_UINT8 :
+            return sensor_msgs::PointField::UINT8;
+        case draco::DT_UINT16 :
+            return sensor_msgs::PointField::UINT16;
+        default :
+            return sensor_msgs::PointField::UINT32;
+    }
+}
+
+} // namespace
 
 //! Constructor
 DracotoPC2::DracotoPC2(std::unique_ptr<draco::PointCloud> && pc, const draco_point_cloud_transport::CompressedPointCloud2ConstPtr & compressed_PC2)
 {
     pc_=std::move(pc);
     compressed_PC2_ =  compressed_PC2;
+
+    // invalid and duplicate fields do not have attributes of their own, otherwise each field is held by attribute of same index
+    if ((pc_->metadata() == nullptr) || !pc_->metadata()->GetEntryIntArray("field_attributes", &field_attributes_) ||
+        (field_attributes_.size() != compressed_PC2_->fields.size()))
+    {
+        field_attributes_.resize(compressed_PC2_->fields.size());
+        for (size_t field_index = 0; field_index < field_attributes_.size(); field_index++)
+        {
+            field_attributes_[field_index] = (int32_t(field_index) < pc_->num_attributes()) ? int32_t(field_index) : -1;
+        }
+    }
+
+    // fields merged into one attribute (e.g. x, y, z) are held by components of it, otherwise each field by all components of its attribute
+    if ((pc_->metadata() == nullptr) || !pc_->metadata()->GetEntryIntArray("field_components", &field_components_) ||
+        (field_components_.size() != 2 * compressed_PC2_->fields.size()))
+    {
+        field_components_.assign(2 * compressed_PC2_->fields.size(), 0);
+        for (size_t field_index = 0; field_index < field_attributes_.size(); field_index++)
+        {
+            if ((field_attributes_[field_index] >= 0) && (field_attributes_[field_index] < pc_->num_attributes()))
+            {
+                field_components_[2 * field_index + 1] = pc_->attribute(field_attributes_[field_index])->num_components();
+            }
+        }
+    }
+
+    // attributes quantized by PC2toDraco carry their parameters in metadata, attributes with skipped dequantization keep their transform
+    quantization_.resize(pc_->num_attributes());
+    quantized_output_.assign(pc_->num_attributes(), 0);
+    for (int32_t att_id = 0; att_id < pc_->num_attributes(); att_id++)
+    {
+        QuantizationParameters& params = quantization_[att_id];
+        if ((pc_->metadata() != nullptr) && get_quantization_metadata(*pc_->metadata(), att_id, params))
+        {
+            continue;
+        }
+        draco::AttributeQuantizationTransform transform;
+        if (transform.InitFromAttribute(*pc_->attribute(att_id)))
+        {
+            params.bits = transform.quantization_bits();
+            params.origin.assign(transform.min_values().begin(), transform.min_values().end());
+            params.range = transform.range();
+        }
+        else
+        {
+            params.bits = 0;
+        }
+    }
+
+    // all fields in original layout
+    set_field_projection(std::vector<std::string>());
 }
 
 //! Destructor
@@ -14,63 +90,292 @@ DracotoPC2::DracotoPC2(std::unique_ptr<draco::PointCloud> && pc, const draco_poi
 //! Method for converting into sensor_msgs::PointCloud2
 sensor_msgs::PointCloud2 DracotoPC2::DracotoPC2::convert(){
 
-    // number of all attributes of point cloud
-    int32_t number_of_attributes = pc_->num_attributes();
+    // Create PointCloud2 structure to be filled up
+    sensor_msgs::PointCloud2 PC2;
+
+    convert(PC2);
+
+    return PC2;
+}
+
+//! Method for converting into existing sensor_msgs::PointCloud2, its data keeps allocated storage
+void DracotoPC2::convert(sensor_msgs::PointCloud2& PC2){
 
     // number of points in pointcloud
-    draco::PointIndex::ValueType number_of_points = pc_->num_points();
+    draco::PointIndex::ValueType number_of_points = num_points();
 
-    std::vector<uint8_t> vec_data;
-    vec_data.resize(number_of_points*compressed_PC2_->point_step);
+    // copy PointCloud2 description (header, width, ...)
+    assign_output_description(PC2);
 
+    // output is built in place, clearing before resize keeps padding bytes between fields defined when data is reused;
+    // without padding every byte is written by write_points and zero-filling is skipped
+    if (!covers_point_step_)
+    {
+        PC2.data.clear();
+    }
+    PC2.data.resize(number_of_points*PC2.point_step);
 
+    if (number_of_points > 0)
+    {
+        write_points(&PC2.data[0]);
+    }
+}
 
+//! Number of points in Draco pointcloud, original number of points if duplicates are restored
+uint32_t DracotoPC2::num_points() const
+{
+    return point_map_.empty() ? pc_->num_points() : point_map_.size();
+}
 
-    // for each attribute
-    for (uint32_t att_id = 0 ; att_id < number_of_attributes ; att_id++)
+//! Checks if points were deduplicated before encoding and are delivered without duplicates
+bool DracotoPC2::deduplicated() const
+{
+    int deduplicate = 0;
+    if (pc_->metadata() != nullptr)
     {
-        // get attribute
-        const draco::PointAttribute* attribute = pc_->attribute(att_id);
+        pc_->metadata()->GetEntryInt("deduplicate", &deduplicate);
+    }
+    return (deduplicate == 1) && point_map_.empty();
+}
 
-        // check if attribute is valid
-        if (!attribute->IsValid()){
-            // RAISE ERROR - buffer of attribute is empty
-            ROS_FATAL_STREAM("In point_cloud_transport::DracotoPC2, attribute of Draco pointcloud is not valid!") ;
+//! Restore original number and order of deduplicated points
+void DracotoPC2::set_restore_duplicates(bool restore)
+{
+    point_map_.clear();
+    if ((!restore) || (pc_->metadata() == nullptr) || !pc_->metadata()->GetEntryIntArray("point_map", &point_map_))
+    {
+        return;
+    }
+
+    // points are restored in place, each point must be represented by a unique point which does not follow it
+    for (size_t point_index = 0; point_index < point_map_.size(); point_index++)
+    {
+        if ((point_map_[point_index] < 0) || (size_t(point_map_[point_index]) > point_index) ||
+            (uint32_t(point_map_[point_index]) >= pc_->num_points()))
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::DracotoPC2, point map of deduplicated points is invalid, delivering unique points only!");
+            point_map_.clear();
+            return;
         }
+    }
+}
 
-        // get offset of attribute in data structure
-        uint32_t attribute_offset = compressed_PC2_->fields[att_id].offset;
+//! Deliver only fields with given names, packed into a compact point_step
+void DracotoPC2::set_field_projection(const std::vector<std::string>& field_names)
+{
+    field_names_ = field_names;
+    project_fields(compressed_PC2_->fields, compressed_PC2_->point_step, field_names, fields_, point_step_, output_field_index_);
 
-        // for each point in point cloud
-        for (draco::PointIndex::ValueType point_index = 0; point_index < number_of_points; point_index++)
+    // quantized attributes delivered as integers change type and size of their fields, all fields are packed without gaps
+    bool retyped = false;
+    for (size_t field_index = 0; field_index < output_field_index_.size(); field_index++)
+    {
+        if (writes_field(field_index) && quantized_output_[field_attributes_[field_index]])
+        {
+            fields_[output_field_index_[field_index]].datatype =
+                    point_field_datatype(quantized_data_type(quantization_[field_attributes_[field_index]].bits));
+            retyped = true;
+        }
+    }
+    if (retyped)
+    {
+        point_step_ = 0;
+        for (sensor_msgs::PointField& field : fields_)
         {
-            // get pointer to corresponding memory in PointCloud2 data
-            uint8_t *out_data = &vec_data[int(compressed_PC2_->point_step*point_index + attribute_offset)];
+            field.offset = point_step_;
+            point_step_ += point_field_size(field);
+        }
+    }
 
-            // read value from Draco pointcloud to out_data
-            attribute->GetValue(draco::AttributeValueIndex(point_index), out_data);
+    covers_point_step_ = (draco_point_cloud_transport::FieldLayout(fields_, point_step_).padding_bytes() == 0);
+    for (size_t field_index = 0; field_index < output_field_index_.size(); field_index++)
+    {
+        if ((output_field_index_[field_index] >= 0) && !writes_field(field_index))
+        {
+            covers_point_step_ = false;
         }
     }
+}
 
+//! Deliver quantized attributes of given types as unsigned integer fields
+void DracotoPC2::set_quantized_output(const std::vector<bool>& attribute_types)
+{
+    for (int32_t att_id = 0; att_id < pc_->num_attributes(); att_id++)
+    {
+        const int attribute_type = pc_->attribute(att_id)->attribute_type();
+        quantized_output_[att_id] = (quantization_[att_id].bits > 0) && (attribute_type >= 0) &&
+                                    (size_t(attribute_type) < attribute_types.size()) && attribute_types[attribute_type];
+    }
+    set_field_projection(field_names_);
+}
 
-    // Create PointCloud2 structure to be filled up
-    sensor_msgs::PointCloud2 PC2;
+//! Appends scale and offsets of delivered quantized integer fields
+void DracotoPC2::get_quantization(draco_point_cloud_transport::DracoQuantization& quantization) const
+{
+    for (size_t field_index = 0; field_index < field_attributes_.size(); field_index++)
+    {
+        if (!writes_field(field_index) || !quantized_output_[field_attributes_[field_index]])
+        {
+            continue;
+        }
+        const QuantizationParameters& params = quantization_[field_attributes_[field_index]];
+        quantization.field_names.push_back(fields_[output_field_index_[field_index]].name);
+        quantization.scales.push_back(params.range / double((uint64_t(1) << params.bits) - 1));
+        // offsets of components of attribute held by field
+        const uint32_t first_component = field_components_[2 * field_index];
+        const uint32_t number_of_components = field_components_[2 * field_index + 1];
+        for (uint32_t component = first_component; (component < first_component + number_of_components) && (component < params.origin.size()); component++)
+        {
+            quantization.offsets.push_back(params.origin[component]);
+        }
+    }
+}
 
-    // copy PointCloud2 description (header, width, ...)
+//! Assigns header, fields, point_step, width, ... of output sensor_msgs::PointCloud2
+void DracotoPC2::assign_output_description(sensor_msgs::PointCloud2& PC2) const
+{
     assign_description_of_PointCloud2(PC2, compressed_PC2_);
+    PC2.fields = fields_;
+    PC2.point_step = point_step_;
+    PC2.row_step = PC2.width * point_step_;
 
     // if points were deduplicated, overwrite height and width
-    int deduplicate;
-    pc_->metadata()->GetEntryInt("deduplicate", &deduplicate);
-
-    if (deduplicate == 1)
+    if (deduplicated())
     {
-        PC2.width=number_of_points;
+        PC2.width=num_points();
         PC2.height=1;
+        PC2.row_step=num_points()*point_step_;
     }
+}
 
-    PC2.data = vec_data;
+//! point_step of output sensor_msgs::PointCloud2
+const std::vector<sensor_msgs::PointField>& DracotoPC2::output_fields() const
+{
+    return fields_;
+}
+
+uint32_t DracotoPC2::point_step() const
+{
+    return point_step_;
+}
 
-   return std::move(PC2);
-   //return PC2;
+//! write_points writes every byte of output points
+bool DracotoPC2::covers_point_step() const
+{
+    return covers_point_step_;
+}
+
+//! field is delivered in output
+bool DracotoPC2::delivers_field(size_t field_index) const
+{
+    return output_field_index_[field_index] >= 0;
+}
+
+//! field is delivered and held by an attribute of this point cloud
+bool DracotoPC2::writes_field(size_t field_index) const
+{
+    return (output_field_index_[field_index] >= 0) && (field_attributes_[field_index] >= 0) &&
+           (field_attributes_[field_index] < pc_->num_attributes());
+}
+
+//! Writes all points into out_data, which must hold num_points() points with point_step()
+void DracotoPC2::write_points(uint8_t* out_data) const
+{
+    // number of all attributes of point cloud
+    int32_t number_of_attributes = pc_->num_attributes();
+
+    // number of points in pointcloud
+    draco::PointIndex::ValueType number_of_points = pc_->num_points();
+
+    // point_step of output data
+    uint32_t point_step = point_step_;
+
+    // for each field, duplicate fields are restored from the attribute of the field they duplicate
+    size_t field_index = 0;
+    while (field_index < field_attributes_.size())
+    {
+        // field is not delivered or was not encoded
+        const int32_t att_id = field_attributes_[field_index];
+        if ((output_field_index_[field_index] < 0) || (att_id < 0) || (att_id >= number_of_attributes))
+        {
+            field_index++;
+            continue;
+        }
+
+        // get attribute
+        const draco::PointAttribute* attribute = pc_->attribute(att_id);
+
+        // check if attribute is valid
+        if (!attribute->IsValid()){
+            // RAISE ERROR - buffer of attribute is empty
+            ROS_FATAL_STREAM("In point_cloud_transport::DracotoPC2, attribute of Draco pointcloud is not valid!") ;
+            field_index++;
+            continue;
+        }
+
+        // quantized attribute is converted back to float32, or delivered as integers of the smallest type holding its bits
+        const QuantizationParameters& quantization_parameters = quantization_[att_id];
+        const bool quantized = quantization_parameters.bits > 0;
+        const bool quantized_output = quantized_output_[att_id];
+        const draco::DataType quantized_output_type = quantized_data_type(quantization_parameters.bits);
+        const uint32_t output_component_size = quantized_output ? draco::DataTypeLength(quantized_output_type) :
+                                               (quantized ? sizeof(float) : draco::DataTypeLength(attribute->data_type()));
+
+        // get offset of attribute in data structure
+        uint32_t attribute_offset = fields_[output_field_index_[field_index]].offset;
+        uint32_t first_component = field_components_[2 * field_index];
+        uint32_t number_of_components = field_components_[2 * field_index + 1];
+
+        // following fields of merged attribute which are delivered in the same layout (e.g. y, z after x) are written together
+        for (field_index++; field_index < field_attributes_.size(); field_index++)
+        {
+            if ((output_field_index_[field_index] < 0) || (field_attributes_[field_index] != att_id) ||
+                (uint32_t(field_components_[2 * field_index]) != first_component + number_of_components) ||
+                (fields_[output_field_index_[field_index]].offset != attribute_offset + number_of_components * output_component_size))
+            {
+                break;
+            }
+            number_of_components += field_components_[2 * field_index + 1];
+        }
+
+        if (attribute_offset >= point_step)
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::DracotoPC2, offset of attribute " << att_id << " is outside of point_step of PointCloud2!");
+            continue;
+        }
+        uint8_t* attribute_data = out_data + attribute_offset;
+        uint32_t available_bytes = point_step - attribute_offset;
+
+        if (quantized_output)
+        {
+            if (!scatter_quantized_attribute(*attribute, first_component, number_of_components, number_of_points, attribute_data, available_bytes,
+                                             point_step, quantized_output_type))
+            {
+                ROS_ERROR_STREAM("In point_cloud_transport::DracotoPC2, quantized attribute " << att_id << " could not be written as integers!");
+            }
+        }
+        else if (quantized)
+        {
+            if (!dequantize_attribute(*attribute, first_component, number_of_components, number_of_points, attribute_data, available_bytes,
+                                      point_step, quantization_parameters))
+            {
+                ROS_ERROR_STREAM("In point_cloud_transport::DracotoPC2, quantized attribute " << att_id << " could not be dequantized!");
+            }
+        }
+        // write all values of attribute into interleaved PointCloud2 data
+        else if (!scatter_attribute(*attribute, first_component, number_of_components, number_of_points, attribute_data, available_bytes,
+                                    point_step))
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::DracotoPC2, attribute " << att_id << " does not fit into point_step of PointCloud2!");
+        }
+    }
+
+    // unique points precede each of the points they represent, so duplicates are restored in place from the last point backwards
+    for (size_t point_index = point_map_.size(); point_index-- > 0;)
+    {
+        if (size_t(point_map_[point_index]) != point_index)
+        {
+            std::memcpy(out_data + point_index * point_step, out_data + size_t(point_map_[point_index]) * point_step, point_step);
+        }
+    }
 }
@@ -1,222 +1,205 @@
 #include "draco_point_cloud_transport/PC2toDraco.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
 #include "draco_point_cloud_transport/debug_msg.h"
+#include "draco_point_cloud_transport/point_deduplication.h"
 
 //! Constructor
-PC2toDraco::PC2toDraco(sensor_msgs::PointCloud2 PC2, std::string topic)
+PC2toDraco::PC2toDraco(const sensor_msgs::PointCloud2& PC2, const draco_point_cloud_transport::EncodingPlan& plan) : PC2_(PC2), plan_(plan),
+    first_point_(0), number_of_points_(PC2.height * PC2.width), first_attribute_(0), number_of_attributes_(plan.number_of_attributes()),
+    deduplication_tolerance_(0.0), deduplication_compare_attributes_(true), deduplication_point_map_(false),
+    quantized_data_(&own_quantized_data_)
 {
-    PC2_ = PC2;
-    base_topic_ = topic;
-
-    /*
-
-     // data type enumeration used in PointField
-    const char *PointFieldDataTypes[] =
-            {
-                    "Undefined",
-                    "INT8",
-                    "UINT8",
-                    "INT16",
-                    "UINT16",
-                    "INT32",
-                    "UINT32",
-                    "FLOAT32",
-                    "FLOAT64"
-            };
-*/
-
-    Initialize();
 }
 
 //! Destructor
 //PC2toDraco::~PC2toDraco(){}
 
-//! Method for converting into Draco pointcloud using draco::PointCloudBuilder
-std::unique_ptr<draco::PointCloud> PC2toDraco::convert(bool deduplicate_flag, bool expert_encoding_flag)
+void PC2toDraco::set_point_range(uint32_t first_point, uint32_t number_of_points)
 {
+    first_point_ = first_point;
+    number_of_points_ = number_of_points;
+}
 
+void PC2toDraco::set_attribute_range(int first_attribute, int number_of_attributes)
+{
+    first_attribute_ = first_attribute;
+    number_of_attributes_ = number_of_attributes;
+}
 
-    // object for conversion into Draco Point Cloud format
-    draco::PointCloudBuilder builder;
-    // number of points in point cloud
-    uint64_t number_of_points = PC2_.height * PC2_.width;
-    // initialize builder object, requires prior knowledge of point cloud size for buffer allocation
-    builder.Start(number_of_points);
-    // vector to hold IDs of attributes for builder object
-    std::vector<int> att_ids;
+void PC2toDraco::set_deduplication(double tolerance, bool compare_attributes, bool point_map)
+{
+    deduplication_tolerance_ = tolerance;
+    deduplication_compare_attributes_ = compare_attributes;
+    deduplication_point_map_ = point_map;
+}
+
+void PC2toDraco::set_quantization_buffer(std::vector<uint8_t>& buffer)
+{
+    quantized_data_ = &buffer;
+}
+
+//! Method for converting into new Draco pointcloud
+std::unique_ptr<draco::PointCloud> PC2toDraco::convert(bool deduplicate_flag)
+{
+    std::unique_ptr<draco::PointCloud> pc;
+    if (!convert(deduplicate_flag, pc))
+    {
+        return nullptr;
+    }
+    return pc;
+}
 
-    // initialize to invalid
-    draco::GeometryAttribute::Type attribute_type = draco::GeometryAttribute::INVALID;
-    draco::DataType attribute_data_type = draco::DT_INVALID;
+//! Method for converting into Draco pointcloud, attributes are initialized like draco::PointCloudBuilder does, but storage of
+//! attributes of recycled point cloud is kept
+bool PC2toDraco::convert(bool deduplicate_flag, std::unique_ptr<draco::PointCloud>& pc)
+{
+    // number of points in point cloud
+    uint64_t number_of_points = number_of_points_;
+    // first converted point in PointCloud2 data
+    const uint8_t* point_data = PC2_.data.data() + size_t(first_point_) * PC2_.point_step;
 
-    // tracks if rgb/rgba was encountered (4 colors saved as one variable,
-    bool rgba_tweak = false;
-    bool rgba_tweak_64bit = false;
+    // duplicates are removed before fields are read, only unique points are copied into draco point cloud
+    std::unique_ptr<draco_point_cloud_transport::PointDeduplicator> deduplicator;
+    if (deduplicate_flag && (number_of_points > 0))
+    {
+        deduplicator.reset(new draco_point_cloud_transport::PointDeduplicator(PC2_, deduplication_tolerance_, deduplication_compare_attributes_));
+        if (deduplicator->deduplicate(first_point_, number_of_points_) < number_of_points)
+        {
+            deduplicator->gather(first_point_, unique_data_);
+            point_data = unique_data_.data();
+            number_of_points = deduplicator->unique_points().size();
+        }
+    }
 
-    // tracks if all necessary parameters were set for expert encoder
-    bool expert_settings_ok = true;
+    // metadata of point cloud, filled during conversion
+    std::unique_ptr<draco::GeometryMetadata> metadata =
+            std::unique_ptr<draco::GeometryMetadata>(new draco::GeometryMetadata());
 
-    std::string expert_attribute_data_type;
+    const std::vector<draco_point_cloud_transport::FieldEncoding>& encodings = plan_.fields();
+    if (encodings.size() != PC2_.fields.size())
+    {
+        ROS_FATAL_STREAM("Encoding plan does not match fields of sensor_msgs::PointCloud2!");
+        return false;
+    }
 
-    // fill in att_ids with attributes from PointField[] fields
-    for (sensor_msgs::PointField field : PC2_.fields) {
+    // draco attribute of each field and components of attribute holding field, let decoder skip invalid fields, restore duplicates
+    // and split merged fields
+    std::vector<int32_t> field_attributes;
+    std::vector<int32_t> field_components;
+    bool merged_fields = false;
 
-        if (expert_encoding_flag) // find attribute type in user specified parameters
+    // attribute added for field (in order of attribute ids)
+    struct AddedAttribute
+    {
+        size_t field_index;
+        int num_components;
+        draco::DataType data_type;
+        bool prequantized;
+    };
+    std::vector<AddedAttribute> added_attributes;
+
+    // collect attributes from PointField[] fields
+    for (size_t field_index = 0; field_index < PC2_.fields.size(); field_index++) {
+        const draco_point_cloud_transport::FieldEncoding& encoding = encodings[field_index];
+
+        // attributes outside of converted range are held by other point clouds (attribute streams)
+        const bool in_range = (encoding.attribute_id >= first_attribute_) && (encoding.attribute_id < first_attribute_ + number_of_attributes_);
+        field_attributes.push_back(in_range ? encoding.attribute_id - first_attribute_ : -1);
+        field_components.push_back(encoding.first_component);
+        field_components.push_back(encoding.num_components);
+        merged_fields = merged_fields || (encoding.merged_components > 0);
+        // field is not encoded or its values are already held by the field it duplicates or by the first field of its group
+        if ((!in_range) || !draco_point_cloud_transport::EncodingPlan::adds_attribute(encoding))
         {
-            rgba_tweak = false;
-            if (ros::param::getCached(base_topic_ + "/draco/attribute_mapping/attribute_type/" + field.name, expert_attribute_data_type))
-            {
-                if (expert_attribute_data_type.compare("POSITION")==0) // if data type is POSITION
-                {
-                    attribute_type = draco::GeometryAttribute::POSITION;
-                }
-                else if (expert_attribute_data_type.compare("NORMAL")==0) // if data type is NORMAL
-                {
-                    attribute_type = draco::GeometryAttribute::NORMAL;
-                }
-                else if (expert_attribute_data_type.compare("COLOR")==0) // if data type is COLOR
-                {
-                    attribute_type = draco::GeometryAttribute::COLOR;
-                    ros::param::getCached(base_topic_ + "/draco/attribute_mapping/rgba_tweak/" + field.name, rgba_tweak);
-
-                }
-                else if (expert_attribute_data_type.compare("TEX_COORD")==0) // if data type is TEX_COORD
-                {
-                    attribute_type = draco::GeometryAttribute::TEX_COORD;
-                }
-                else if (expert_attribute_data_type.compare("GENERIC")==0) // if data type is GENERIC
-                {
-                    attribute_type = draco::GeometryAttribute::GENERIC;
-                }
-                else
-                {
-                    ROS_ERROR_STREAM ("Attribute data type not recognized for " + field.name + " field entry. Using regular type recognition instead.");
-                    expert_settings_ok = false;
-                }
-            }
-            else
-            {
-                ROS_ERROR_STREAM ("Attribute data type not specified for " + field.name + " field entry. Using regular type recognition instead.");
-                ROS_INFO_STREAM ("To set attribute type for " + field.name + " field entry, set " + base_topic_ + "/draco/attribute_mapping/attribute_type/" + field.name);
-                expert_settings_ok = false;
-            }
+            continue;
         }
+        // components of all fields of merged group are read at once
+        const int num_components = (encoding.merged_components > 0) ? encoding.merged_components : encoding.num_components;
+        // float attribute is quantized in the same pass as it is read
+        const bool prequantized = (encoding.prequantization_bits > 0) && (number_of_points > 0);
+        const draco::DataType data_type = prequantized ? quantized_data_type(encoding.prequantization_bits) : encoding.attribute_data_type;
+        added_attributes.push_back({field_index, num_components, data_type, prequantized});
+    }
 
-        if ((!expert_encoding_flag) || (!expert_settings_ok))// find attribute type in recognized names
+    // recycled point cloud is reused only if it holds the same attributes
+    bool reuse = (pc != nullptr) && (size_t(pc->num_attributes()) == added_attributes.size());
+    for (size_t i = 0; reuse && (i < added_attributes.size()); i++)
+    {
+        const draco::PointAttribute* att = pc->attribute(int32_t(i));
+        reuse = (att->attribute_type() == encodings[added_attributes[i].field_index].attribute_type) &&
+                (att->num_components() == added_attributes[i].num_components) &&
+                (att->data_type() == added_attributes[i].data_type);
+    }
+    if (!reuse)
+    {
+        pc.reset(new draco::PointCloud());
+    }
+    pc->set_num_points(number_of_points);
+
+    for (size_t i = 0; i < added_attributes.size(); i++)
+    {
+        const AddedAttribute& added = added_attributes[i];
+        const sensor_msgs::PointField& field = PC2_.fields[added.field_index];
+        const draco_point_cloud_transport::FieldEncoding& encoding = encodings[added.field_index];
+        const int64_t entry_size = int64_t(draco::DataTypeLength(added.data_type)) * added.num_components;
+
+        // attribute with identity mapping holding value of each point, vector of reset attribute keeps its capacity
+        int32_t att_id = int32_t(i);
+        if (reuse)
         {
-            rgba_tweak = false;
-            // attribute type switch
-            // TODO: add texture coordinate (TEX_COORD) recognized names
-            switch (s_mapStringValues[field.name]) {
-                case enumval1 : // "x"
-                case enumval2 : // "y"
-                case enumval3 : // "z"
-                case enumval4 : // "pos"
-                case enumval5 : // "position"
-                    attribute_type = draco::GeometryAttribute::POSITION;
-                    break;
-                case enumval10 : // "rgb"
-                case enumval11 : // "rgba"
-                    //
-                    rgba_tweak = true;
-                case enumval6 : // "r"
-                case enumval7 : // "g"
-                case enumval8 : // "b"
-                case enumval9 : // "a"
-                    attribute_type = draco::GeometryAttribute::COLOR;
-                    break;
-                case enumval12 : // "nx"
-                case enumval13 : // "ny"
-                case enumval14 : // "nz"
-                    attribute_type = draco::GeometryAttribute::NORMAL;
-                    break;
-                case enumvalGeneric : // all unrecognized attributes
-                    attribute_type = draco::GeometryAttribute::GENERIC;
-            } // attribute type switch end
-        } // find attribute type in recognized names end
-
-        // attribute data type switch
-        switch (field.datatype) {
-            case 1 :
-                attribute_data_type = draco::DT_INT8;
-                break;
-            case 2 :
-                attribute_data_type = draco::DT_UINT8;
-                break;
-            case 3 :
-                attribute_data_type = draco::DT_INT16;
-                break;
-            case 4 :
-                attribute_data_type = draco::DT_UINT16;
-                break;
-            case 5 :
-                attribute_data_type = draco::DT_INT32;
-                rgba_tweak_64bit = false; //
-                break;
-            case 6 :
-                attribute_data_type = draco::DT_UINT32;
-                rgba_tweak_64bit = false; //
-                break;
-            case 7 :
-                attribute_data_type = draco::DT_FLOAT32;
-                rgba_tweak_64bit = false; //
-                break;
-            case 8 :
-                attribute_data_type = draco::DT_FLOAT64;
-                rgba_tweak_64bit = true; //
-                break;
-            default:
-                attribute_data_type = draco::DT_INVALID;
-                // RAISE ERROR - INVALID DATA TYPE
-                ROS_FATAL_STREAM(" Invalid data type in PointCloud2 to Draco conversion");
-                break;
-        }  // attribute data type switch end
-
-        // add attribute to point cloud builder
-        if(rgba_tweak) // attribute is rgb/rgba color
+            pc->attribute(att_id)->Reset(number_of_points);
+            pc->attribute(att_id)->SetIdentityMapping();
+        }
+        else
         {
-         if(rgba_tweak_64bit) // attribute data type is 64bits long, each color is encoded in 16bits
-         {
-             att_ids.push_back(builder.AddAttribute(attribute_type, 4 * field.count, draco::DT_UINT16));
-         }
-         else // attribute data type is 32bits long, each color is encoded in 8bits
-         {
-             att_ids.push_back(builder.AddAttribute(attribute_type, 4 * field.count, draco::DT_UINT8));
-         }
+            draco::GeometryAttribute geometry_attribute;
+            geometry_attribute.Init(encoding.attribute_type, nullptr, int8_t(added.num_components), added.data_type, false, entry_size, 0);
+            att_id = pc->AddAttribute(geometry_attribute, true, number_of_points);
         }
-        else // attribute is not rgb/rgba color, this is the default behavior
+        draco::PointAttribute* att = pc->attribute(att_id);
+
+        if (added.prequantized)
         {
-            att_ids.push_back(builder.AddAttribute(attribute_type, field.count, attribute_data_type));
+            const uint8_t* field_data = point_data + field.offset;
+            QuantizationParameters quantization_parameters;
+            compute_quantization_parameters(field_data, number_of_points, added.num_components, PC2_.point_step, encoding.prequantization_bits, quantization_parameters);
+            quantize_float32(field_data, number_of_points, added.num_components, PC2_.point_step, quantization_parameters, *quantized_data_);
+
+            att->buffer()->Write(0, quantized_data_->data(), number_of_points * entry_size);
+            add_quantization_metadata(*metadata, att_id, quantization_parameters);
         }
-        // Set attribute values for the last added attribute
-        if ((!att_ids.empty()) && (attribute_data_type != draco::DT_INVALID)) {
-             builder.SetAttributeValuesForAllPoints(int(att_ids.back()), &PC2_.data[0] + field.offset, PC2_.point_step);
+        else
+        {
+            // values are interleaved in point data
+            for (uint64_t point = 0; point < number_of_points; point++)
+            {
+                att->buffer()->Write(point * entry_size, point_data + point * PC2_.point_step + field.offset, entry_size);
             }
-    }
-    // finalize point cloud *** builder.Finalize(bool deduplicate) ***
-    std::unique_ptr<draco::PointCloud> pc = builder.Finalize(deduplicate_flag);
-
-    if (pc == nullptr)
-    {
-        ROS_FATAL_STREAM("Conversion from sensor_msgs::PointCloud2 to Draco::PointCloud failed");
+        }
     }
 
-    // add metadata to point cloud
-    std::unique_ptr<draco::GeometryMetadata> metadata =
-            std::unique_ptr<draco::GeometryMetadata>(new draco::GeometryMetadata());
-
     if (deduplicate_flag)
     {
         metadata->AddEntryInt("deduplicate", 1); // deduplication=true flag
+        // lets subscriber restore original number and order of points
+        if (deduplication_point_map_ && (deduplicator != nullptr))
+        {
+            metadata->AddEntryIntArray("point_map", deduplicator->point_map());
+        }
     }
     else
     {
         metadata->AddEntryInt("deduplicate", 0); // deduplication=false flag
     }
-    pc->AddMetadata(std::move(metadata));
-
-    if ((pc->num_points()!=number_of_points) and !deduplicate_flag)
+    if ((size_t(plan_.number_of_attributes()) != PC2_.fields.size()) || merged_fields ||
+        (first_attribute_ != 0) || (number_of_attributes_ != plan_.number_of_attributes()))
     {
-        ROS_FATAL_STREAM("Number of points in Draco::PointCloud differs from sensor_msgs::PointCloud2!");
+        metadata->AddEntryIntArray("field_attributes", field_attributes);
     }
-    return pc;
+    if (merged_fields)
+    {
+        metadata->AddEntryIntArray("field_components", field_components);
+    }
+    pc->AddMetadata(std::move(metadata));
+    return true;
 }
@@ -0,0 +1,720 @@
+#include "cloud_sources.h"
+
+#include "draco_point_cloud_transport/conversion_utilities.h"
+
+// ros
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+
+namespace draco_point_cloud_transport
+{
+namespace benchmark
+{
+
+namespace
+{
+
+void add_field(sensor_msgs::PointCloud2& cloud, const std::string& name, uint8_t datatype, uint32_t count, uint32_t offset)
+{
+    sensor_msgs::PointField field;
+    field.name = name;
+    field.offset = offset;
+    field.datatype = datatype;
+    field.count = count;
+    cloud.fields.push_back(field);
+    cloud.point_step = std::max(cloud.point_step, offset + point_field_size(field));
+}
+
+void allocate_points(sensor_msgs::PointCloud2& cloud, uint32_t height, uint32_t width)
+{
+    cloud.height = height;
+    cloud.width = width;
+    cloud.is_bigendian = false;
+    cloud.row_step = width * cloud.point_step;
+    cloud.data.assign(size_t(height) * cloud.row_step, 0);
+}
+
+template <typename T>
+void set_value(sensor_msgs::PointCloud2& cloud, size_t point_index, uint32_t offset, T value)
+{
+    std::memcpy(cloud.data.data() + point_index * cloud.point_step + offset, &value, sizeof(T));
+}
+
+//! packs 8-bit color channels into float32 as ROS drivers do
+float pack_rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+    const uint32_t rgb = (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+    float packed;
+    std::memcpy(&packed, &rgb, sizeof(float));
+    return packed;
+}
+
+//! stores value converted to PointField datatype
+void store_value(uint8_t* data, uint8_t datatype, double value)
+{
+    switch (datatype)
+    {
+        case sensor_msgs::PointField::INT8 : { int8_t v = int8_t(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::UINT8 : { uint8_t v = uint8_t(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::INT16 : { int16_t v = int16_t(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::UINT16 : { uint16_t v = uint16_t(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::INT32 : { int32_t v = int32_t(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::UINT32 : { uint32_t v = uint32_t(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::FLOAT32 : { float v = float(value); std::memcpy(data, &v, sizeof(v)); break; }
+        case sensor_msgs::PointField::FLOAT64 : { std::memcpy(data, &value, sizeof(value)); break; }
+        default : break;
+    }
+}
+
+//! reads rows of whitespace separated values of all fields into cloud
+bool read_ascii_points(std::istream& stream, sensor_msgs::PointCloud2& cloud)
+{
+    const size_t number_of_points = size_t(cloud.height) * cloud.width;
+    for (size_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        std::string line;
+        if (!std::getline(stream, line))
+        {
+            return false;
+        }
+        std::istringstream values(line);
+        uint8_t* point_data = cloud.data.data() + point_index * cloud.point_step;
+        for (const sensor_msgs::PointField& field : cloud.fields)
+        {
+            const uint32_t value_size = point_field_size(field) / field.count;
+            for (uint32_t c = 0; c < field.count; c++)
+            {
+                std::string token;
+                if (!(values >> token))
+                {
+                    return false;
+                }
+                // strtod handles nan and inf written by PCL
+                store_value(point_data + field.offset + c * value_size, field.datatype, std::strtod(token.c_str(), nullptr));
+            }
+        }
+    }
+    return true;
+}
+
+//! PointField datatype of PCD TYPE and SIZE, 0 if not supported
+uint8_t pcd_datatype(char type, int size)
+{
+    switch (type)
+    {
+        case 'F' :
+            return (size == 4) ? sensor_msgs::PointField::FLOAT32 : ((size == 8) ? sensor_msgs::PointField::FLOAT64 : 0);
+        case 'I' :
+            return (size == 1) ? sensor_msgs::PointField::INT8 : ((size == 2) ? sensor_msgs::PointField::INT16 :
+                   ((size == 4) ? sensor_msgs::PointField::INT32 : 0));
+        case 'U' :
+            return (size == 1) ? sensor_msgs::PointField::UINT8 : ((size == 2) ? sensor_msgs::PointField::UINT16 :
+                   ((size == 4) ? sensor_msgs::PointField::UINT32 : 0));
+        default :
+            return 0;
+    }
+}
+
+//! PointField datatype of PLY property type, 0 if not supported
+uint8_t ply_datatype(const std::string& type)
+{
+    static const std::map<std::string, uint8_t> types = {
+            {"char", sensor_msgs::PointField::INT8}, {"int8", sensor_msgs::PointField::INT8},
+            {"uchar", sensor_msgs::PointField::UINT8}, {"uint8", sensor_msgs::PointField::UINT8},
+            {"short", sensor_msgs::PointField::INT16}, {"int16", sensor_msgs::PointField::INT16},
+            {"ushort", sensor_msgs::PointField::UINT16}, {"uint16", sensor_msgs::PointField::UINT16},
+            {"int", sensor_msgs::PointField::INT32}, {"int32", sensor_msgs::PointField::INT32},
+            {"uint", sensor_msgs::PointField::UINT32}, {"uint32", sensor_msgs::PointField::UINT32},
+            {"float", sensor_msgs::PointField::FLOAT32}, {"float32", sensor_msgs::PointField::FLOAT32},
+            {"double", sensor_msgs::PointField::FLOAT64}, {"float64", sensor_msgs::PointField::FLOAT64}};
+    std::map<std::string, uint8_t>::const_iterator it = types.find(type);
+    return (it == types.end()) ? 0 : it->second;
+}
+
+//! 3D vector of generators
+struct Vector3
+{
+    double x, y, z;
+};
+
+//! distance along ray from origin o in direction d to vertical cylinder at (cx, cy), infinity if missed
+double ray_cylinder(const Vector3& o, const Vector3& d, double cx, double cy, double radius, double z_min, double z_max)
+{
+    const double ox = o.x - cx;
+    const double oy = o.y - cy;
+    const double a = d.x * d.x + d.y * d.y;
+    const double b = 2.0 * (ox * d.x + oy * d.y);
+    const double c = ox * ox + oy * oy - radius * radius;
+    const double discriminant = b * b - 4.0 * a * c;
+    if ((a == 0.0) || (discriminant < 0.0))
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    const double t = (-b - std::sqrt(discriminant)) / (2.0 * a);
+    const double z = o.z + t * d.z;
+    return ((t > 0.0) && (z >= z_min) && (z <= z_max)) ? t : std::numeric_limits<double>::infinity();
+}
+
+//! distance along ray to sphere, infinity if missed
+double ray_sphere(const Vector3& o, const Vector3& d, const Vector3& center, double radius)
+{
+    const Vector3 oc = {o.x - center.x, o.y - center.y, o.z - center.z};
+    const double b = oc.x * d.x + oc.y * d.y + oc.z * d.z;
+    const double c = oc.x * oc.x + oc.y * oc.y + oc.z * oc.z - radius * radius;
+    const double discriminant = b * b - c;
+    if (discriminant < 0.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    const double t = -b - std::sqrt(discriminant);
+    return (t > 0.0) ? t : std::numeric_limits<double>::infinity();
+}
+
+} // namespace
+
+bool load_rosbag(const std::string& path, const std::string& topic, size_t max_frames, CloudSequence& sequence)
+{
+    sequence.name = path + (topic.empty() ? "" : ":" + topic);
+    try
+    {
+        rosbag::Bag bag(path, rosbag::bagmode::Read);
+        rosbag::View view(bag, rosbag::TypeQuery("sensor_msgs/PointCloud2"));
+        for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it)
+        {
+            if ((!topic.empty()) && (it->getTopic() != topic))
+            {
+                continue;
+            }
+            sensor_msgs::PointCloud2::ConstPtr cloud = it->instantiate<sensor_msgs::PointCloud2>();
+            if (cloud != nullptr)
+            {
+                sequence.frames.push_back(*cloud);
+            }
+            if ((max_frames > 0) && (sequence.frames.size() >= max_frames))
+            {
+                break;
+            }
+        }
+        bag.close();
+    }
+    catch (const rosbag::BagException& e)
+    {
+        ROS_ERROR_STREAM("Could not read rosbag " << path << ": " << e.what());
+        return false;
+    }
+    return !sequence.frames.empty();
+}
+
+bool load_pcd(const std::string& path, sensor_msgs::PointCloud2& cloud)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        ROS_ERROR_STREAM("Could not open " << path);
+        return false;
+    }
+
+    std::vector<std::string> names;
+    std::vector<int> sizes;
+    std::vector<char> types;
+    std::vector<uint32_t> counts;
+    uint32_t width = 0;
+    uint32_t height = 1;
+    std::string data_format;
+
+    std::string line;
+    while (data_format.empty() && std::getline(file, line))
+    {
+        std::istringstream tokens(line);
+        std::string key;
+        tokens >> key;
+        std::string token;
+        if (key == "FIELDS")
+        {
+            while (tokens >> token) names.push_back(token);
+        }
+        else if (key == "SIZE")
+        {
+            while (tokens >> token) sizes.push_back(std::stoi(token));
+        }
+        else if (key == "TYPE")
+        {
+            while (tokens >> token) types.push_back(token[0]);
+        }
+        else if (key == "COUNT")
+        {
+            while (tokens >> token) counts.push_back(std::stoul(token));
+        }
+        else if (key == "WIDTH")
+        {
+            tokens >> width;
+        }
+        else if (key == "HEIGHT")
+        {
+            tokens >> height;
+        }
+        else if (key == "DATA")
+        {
+            tokens >> data_format;
+        }
+    }
+    if (counts.empty())
+    {
+        counts.assign(names.size(), 1);
+    }
+    if (names.empty() || (sizes.size() != names.size()) || (types.size() != names.size()) || (counts.size() != names.size()))
+    {
+        ROS_ERROR_STREAM("Invalid PCD header in " << path);
+        return false;
+    }
+
+    cloud = sensor_msgs::PointCloud2();
+    for (size_t field_index = 0; field_index < names.size(); field_index++)
+    {
+        const uint8_t datatype = pcd_datatype(types[field_index], sizes[field_index]);
+        if (datatype == 0)
+        {
+            ROS_ERROR_STREAM("Unsupported PCD field type of " << names[field_index] << " in " << path);
+            return false;
+        }
+        add_field(cloud, names[field_index], datatype, counts[field_index], cloud.point_step);
+    }
+    allocate_points(cloud, height, width);
+
+    if (data_format == "ascii")
+    {
+        return read_ascii_points(file, cloud);
+    }
+    if (data_format == "binary")
+    {
+        // binary PCD stores packed points exactly like PointCloud2
+        file.read(reinterpret_cast<char*>(cloud.data.data()), cloud.data.size());
+        return size_t(file.gcount()) == cloud.data.size();
+    }
+    ROS_ERROR_STREAM("Unsupported PCD data format " << data_format << " in " << path);
+    return false;
+}
+
+bool load_ply(const std::string& path, sensor_msgs::PointCloud2& cloud)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    if (!file || !std::getline(file, line) || (line.compare(0, 3, "ply") != 0))
+    {
+        ROS_ERROR_STREAM("Could not open PLY file " << path);
+        return false;
+    }
+
+    cloud = sensor_msgs::PointCloud2();
+    std::string format;
+    uint32_t number_of_vertices = 0;
+    bool in_vertex = false;
+    bool vertex_seen = false;
+    while (std::getline(file, line))
+    {
+        std::istringstream tokens(line);
+        std::string key;
+        tokens >> key;
+        if (key == "end_header")
+        {
+            break;
+        }
+        if (key == "format")
+        {
+            tokens >> format;
+        }
+        else if (key == "element")
+        {
+            std::string name;
+            tokens >> name;
+            // data of preceding elements would have to be skipped
+            if ((!vertex_seen) && (name != "vertex"))
+            {
+                ROS_ERROR_STREAM("PLY file " << path << " must start with vertex element");
+                return false;
+            }
+            in_vertex = (name == "vertex");
+            if (in_vertex)
+            {
+                tokens >> number_of_vertices;
+                vertex_seen = true;
+            }
+        }
+        else if ((key == "property") && in_vertex)
+        {
+            std::string type, name;
+            tokens >> type >> name;
+            const uint8_t datatype = ply_datatype(type);
+            if (datatype == 0)
+            {
+                ROS_ERROR_STREAM("Unsupported PLY vertex property " << type << " " << name << " in " << path);
+                return false;
+            }
+            add_field(cloud, name, datatype, 1, cloud.point_step);
+        }
+    }
+    if (cloud.fields.empty())
+    {
+        ROS_ERROR_STREAM("PLY file " << path << " has no vertex properties");
+        return false;
+    }
+    allocate_points(cloud, 1, number_of_vertices);
+
+    if (format == "ascii")
+    {
+        return read_ascii_points(file, cloud);
+    }
+    if (format == "binary_little_endian")
+    {
+        file.read(reinterpret_cast<char*>(cloud.data.data()), cloud.data.size());
+        return size_t(file.gcount()) == cloud.data.size();
+    }
+    ROS_ERROR_STREAM("Unsupported PLY format " << format << " in " << path);
+    return false;
+}
+
+CloudSequence generate_lidar(uint32_t rings, uint32_t columns, size_t frames, unsigned seed)
+{
+    CloudSequence sequence;
+    sequence.name = "synthetic_lidar";
+
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> range_noise(0.0, 0.01);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    const double ground = -1.8;
+    const double max_range = 100.0;
+    const double min_elevation = -15.0 * M_PI / 180.0;
+    const double max_elevation = 15.0 * M_PI / 180.0;
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        // layout of common lidar drivers, padding after z and after ring
+        sensor_msgs::PointCloud2 cloud;
+        cloud.header.frame_id = "lidar";
+        add_field(cloud, "x", sensor_msgs::PointField::FLOAT32, 1, 0);
+        add_field(cloud, "y", sensor_msgs::PointField::FLOAT32, 1, 4);
+        add_field(cloud, "z", sensor_msgs::PointField::FLOAT32, 1, 8);
+        add_field(cloud, "intensity", sensor_msgs::PointField::FLOAT32, 1, 16);
+        add_field(cloud, "ring", sensor_msgs::PointField::UINT16, 1, 20);
+        cloud.point_step = 32;
+        allocate_points(cloud, rings, columns);
+        cloud.is_dense = false;
+
+        // sensor drives along street
+        const Vector3 origin = {0.5 * frame, 0.0, 0.0};
+
+        for (uint32_t row = 0; row < rings; row++)
+        {
+            const double elevation = max_elevation - (max_elevation - min_elevation) * row / std::max<uint32_t>(1, rings - 1);
+            for (uint32_t column = 0; column < columns; column++)
+            {
+                const double azimuth = 2.0 * M_PI * column / columns;
+                const Vector3 direction = {std::cos(elevation) * std::cos(azimuth), std::cos(elevation) * std::sin(azimuth), std::sin(elevation)};
+
+                double t = std::numeric_limits<double>::infinity();
+                double reflectivity = 0.0;
+                // ground
+                if (direction.z < 0.0)
+                {
+                    t = (ground - origin.z) / direction.z;
+                    reflectivity = 20.0;
+                }
+                // facades of street and walls closing it, 12 m high
+                const double wall_distances[4] = {(direction.y > 0.0) ? (8.0 - origin.y) / direction.y : -1.0,
+                                                  (direction.y < 0.0) ? (-8.0 - origin.y) / direction.y : -1.0,
+                                                  (direction.x > 0.0) ? (60.0 - origin.x) / direction.x : -1.0,
+                                                  (direction.x < 0.0) ? (-60.0 - origin.x) / direction.x : -1.0};
+                for (double wall_t : wall_distances)
+                {
+                    if ((wall_t > 0.0) && (wall_t < t) && (origin.z + wall_t * direction.z <= ground + 12.0))
+                    {
+                        t = wall_t;
+                        reflectivity = 60.0;
+                    }
+                }
+                // poles along street
+                for (int pole = -4; pole <= 4; pole++)
+                {
+                    for (double side : {-6.0, 6.0})
+                    {
+                        const double pole_t = ray_cylinder(origin, direction, 10.0 * pole, side, 0.15, ground, ground + 5.0);
+                        if (pole_t < t)
+                        {
+                            t = pole_t;
+                            reflectivity = 120.0;
+                        }
+                    }
+                }
+
+                const size_t point_index = size_t(row) * columns + column;
+                set_value<uint16_t>(cloud, point_index, 20, uint16_t(rings - 1 - row));
+                // no return beyond max range and random dropouts
+                if ((t > max_range) || (uniform(generator) < 0.01))
+                {
+                    const float nan = std::numeric_limits<float>::quiet_NaN();
+                    set_value(cloud, point_index, 0, nan);
+                    set_value(cloud, point_index, 4, nan);
+                    set_value(cloud, point_index, 8, nan);
+                    continue;
+                }
+                t += range_noise(generator);
+                set_value(cloud, point_index, 0, float(t * direction.x));
+                set_value(cloud, point_index, 4, float(t * direction.y));
+                set_value(cloud, point_index, 8, float(t * direction.z));
+                set_value(cloud, point_index, 16, float(reflectivity / (1.0 + t / 50.0) + 5.0 * uniform(generator)));
+            }
+        }
+        sequence.frames.push_back(cloud);
+    }
+    return sequence;
+}
+
+CloudSequence generate_rgbd(uint32_t height, uint32_t width, size_t frames, unsigned seed)
+{
+    CloudSequence sequence;
+    sequence.name = "synthetic_rgbd";
+
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    const double focal_length = 525.0 * width / 640.0;
+    const double cx = 0.5 * width;
+    const double cy = 0.5 * height;
+    const uint32_t border = 8 * width / 640;
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        // layout of pcl::PointXYZRGB
+        sensor_msgs::PointCloud2 cloud;
+        cloud.header.frame_id = "camera_optical";
+        add_field(cloud, "x", sensor_msgs::PointField::FLOAT32, 1, 0);
+        add_field(cloud, "y", sensor_msgs::PointField::FLOAT32, 1, 4);
+        add_field(cloud, "z", sensor_msgs::PointField::FLOAT32, 1, 8);
+        add_field(cloud, "rgb", sensor_msgs::PointField::FLOAT32, 1, 16);
+        cloud.point_step = 32;
+        allocate_points(cloud, height, width);
+        cloud.is_dense = false;
+
+        // camera slowly pans over the scene
+        const Vector3 origin = {0.02 * frame, 0.0, 0.0};
+        const Vector3 sphere = {0.3, 0.2, 2.5};
+
+        for (uint32_t v = 0; v < height; v++)
+        {
+            for (uint32_t u = 0; u < width; u++)
+            {
+                const size_t point_index = size_t(v) * width + u;
+                const Vector3 ray = {(u - cx) / focal_length, (v - cy) / focal_length, 1.0};
+
+                // depth along optical axis: back wall, floor below camera, sphere
+                double depth = 4.0 - origin.z;
+                uint8_t r, g, b;
+                const double wall_x = origin.x + ray.x * depth;
+                const double wall_y = origin.y + ray.y * depth;
+                const bool checker = (int(std::floor(wall_x * 2.0)) + int(std::floor(wall_y * 2.0))) % 2 == 0;
+                r = g = b = checker ? 200 : 90;
+                if (ray.y > 0.0)
+                {
+                    const double floor_depth = (1.2 - origin.y) / ray.y;
+                    if (floor_depth < depth)
+                    {
+                        depth = floor_depth;
+                        r = 120; g = 100; b = 80;
+                    }
+                }
+                const double length = std::sqrt(ray.x * ray.x + ray.y * ray.y + 1.0);
+                const Vector3 direction = {ray.x / length, ray.y / length, 1.0 / length};
+                const double sphere_t = ray_sphere(origin, direction, sphere, 0.5);
+                if (sphere_t / length < depth)
+                {
+                    depth = sphere_t / length;
+                    r = uint8_t(150 + 100 * direction.z); g = 30; b = 30;
+                }
+
+                // borders and random pixels have no depth
+                if ((u < border) || (u >= width - border) || (uniform(generator) < 0.03))
+                {
+                    const float nan = std::numeric_limits<float>::quiet_NaN();
+                    set_value(cloud, point_index, 0, nan);
+                    set_value(cloud, point_index, 4, nan);
+                    set_value(cloud, point_index, 8, nan);
+                }
+                else
+                {
+                    // structured light noise grows with square of depth
+                    depth += 0.0012 * depth * depth * noise(generator);
+                    set_value(cloud, point_index, 0, float(ray.x * depth));
+                    set_value(cloud, point_index, 4, float(ray.y * depth));
+                    set_value(cloud, point_index, 8, float(depth));
+                }
+                set_value(cloud, point_index, 16, pack_rgb(r, g, b));
+            }
+        }
+        sequence.frames.push_back(cloud);
+    }
+    return sequence;
+}
+
+CloudSequence generate_dense_map(uint32_t number_of_points, size_t frames, unsigned seed)
+{
+    CloudSequence sequence;
+    sequence.name = "synthetic_map";
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> jitter(0.0, 0.002);
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        sensor_msgs::PointCloud2 cloud;
+        cloud.header.frame_id = "map";
+        add_field(cloud, "x", sensor_msgs::PointField::FLOAT32, 1, 0);
+        add_field(cloud, "y", sensor_msgs::PointField::FLOAT32, 1, 4);
+        add_field(cloud, "z", sensor_msgs::PointField::FLOAT32, 1, 8);
+        add_field(cloud, "nx", sensor_msgs::PointField::FLOAT32, 1, 12);
+        add_field(cloud, "ny", sensor_msgs::PointField::FLOAT32, 1, 16);
+        add_field(cloud, "nz", sensor_msgs::PointField::FLOAT32, 1, 20);
+        add_field(cloud, "rgb", sensor_msgs::PointField::FLOAT32, 1, 24);
+        allocate_points(cloud, 1, number_of_points);
+        cloud.is_dense = true;
+
+        // map grows between frames, points are sampled again
+        const double extent = 20.0 + frame;
+
+        for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            Vector3 position, normal;
+            uint8_t r, g, b;
+            const double surface = uniform(generator);
+            if (surface < 0.5)
+            {
+                // floor
+                position = {extent * uniform(generator), extent * uniform(generator), 0.0};
+                normal = {0.0, 0.0, 1.0};
+                r = 110; g = 110; b = 100;
+            }
+            else if (surface < 0.8)
+            {
+                // walls
+                const bool x_wall = uniform(generator) < 0.5;
+                position = {x_wall ? 0.0 : extent * uniform(generator), x_wall ? extent * uniform(generator) : 0.0, 3.0 * uniform(generator)};
+                normal = {x_wall ? 1.0 : 0.0, x_wall ? 0.0 : 1.0, 0.0};
+                r = 220; g = 210; b = 190;
+            }
+            else
+            {
+                // spherical objects on a grid
+                const int object = int(uniform(generator) * 10.0);
+                const Vector3 center = {2.0 + 1.8 * object, 2.0 + 0.9 * (object % 3), 0.5};
+                const double z = 2.0 * uniform(generator) - 1.0;
+                const double angle = 2.0 * M_PI * uniform(generator);
+                const double planar = std::sqrt(1.0 - z * z);
+                normal = {planar * std::cos(angle), planar * std::sin(angle), z};
+                position = {center.x + 0.5 * normal.x, center.y + 0.5 * normal.y, center.z + 0.5 * normal.z};
+                r = uint8_t(25 * object); g = 180; b = uint8_t(255 - 25 * object);
+            }
+
+            set_value(cloud, point_index, 0, float(position.x + jitter(generator)));
+            set_value(cloud, point_index, 4, float(position.y + jitter(generator)));
+            set_value(cloud, point_index, 8, float(position.z + jitter(generator)));
+            set_value(cloud, point_index, 12, float(normal.x));
+            set_value(cloud, point_index, 16, float(normal.y));
+            set_value(cloud, point_index, 20, float(normal.z));
+            set_value(cloud, point_index, 24, pack_rgb(r, g, b));
+        }
+        sequence.frames.push_back(cloud);
+    }
+    return sequence;
+}
+
+CloudSequence generate_layouts(size_t frames, unsigned seed)
+{
+    CloudSequence sequence;
+    sequence.name = "synthetic_layouts";
+
+    std::mt19937 generator(seed);
+    const auto random = [&generator](uint32_t min, uint32_t max)
+    {
+        return std::uniform_int_distribution<uint32_t>(min, max)(generator);
+    };
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        sensor_msgs::PointCloud2 cloud;
+        cloud.header.frame_id = "layout";
+        cloud.is_bigendian = false;
+        cloud.is_dense = (random(0, 1) == 1);
+
+        const uint32_t number_of_fields = random(1, 8);
+        uint32_t offset = random(0, 3);
+        for (uint32_t field_index = 0; field_index < number_of_fields; field_index++)
+        {
+            const uint32_t kind = random(0, 19);
+            if ((kind == 0) && !cloud.fields.empty())
+            {
+                // duplicate definition overlapping previous field
+                sensor_msgs::PointField field = cloud.fields.back();
+                field.name += "_alias";
+                cloud.fields.push_back(field);
+                continue;
+            }
+            // unknown datatype 0 or one of the eight PointField datatypes; counts beyond draco's 127 components happen
+            const uint8_t datatype = (kind == 1) ? 0 : uint8_t(random(sensor_msgs::PointField::INT8, sensor_msgs::PointField::FLOAT64));
+            const uint32_t count = (kind == 2) ? random(128, 300) : random(1, 3);
+            add_field(cloud, "field_" + std::to_string(field_index), datatype, count, offset);
+            cloud.point_step = std::max(cloud.point_step, offset + ((datatype == 0) ? 4 : 0));
+            offset = cloud.point_step + random(0, 5);
+        }
+        cloud.point_step = offset + random(0, 7);
+
+        const uint32_t height = random(1, 4);
+        const uint32_t width = random(1, 400);
+        cloud.height = height;
+        cloud.width = width;
+        cloud.row_step = width * cloud.point_step + ((random(0, 2) == 0) ? random(1, 9) : 0);
+        size_t data_size = size_t(height) * cloud.row_step + ((random(0, 4) == 0) ? random(1, 3) : 0);
+        // layouts not describing data: data shorter than rows
+        if (random(0, 9) == 0)
+        {
+            data_size = random(0, uint32_t(data_size));
+        }
+        cloud.data.resize(data_size);
+        for (uint8_t& byte : cloud.data)
+        {
+            byte = uint8_t(random(0, 255));
+        }
+
+        // quiet, signaling and negative NaN in float fields
+        const uint32_t nan_patterns[] = {0x7fc00000u, 0x7f800001u, 0xffc12345u};
+        for (const sensor_msgs::PointField& field : cloud.fields)
+        {
+            if (field.datatype != sensor_msgs::PointField::FLOAT32)
+            {
+                continue;
+            }
+            for (size_t point_index = 0; point_index < size_t(height) * width; point_index++)
+            {
+                const size_t position = (point_index / width) * cloud.row_step + (point_index % width) * cloud.point_step + field.offset;
+                if ((random(0, 3) == 0) && (position + sizeof(uint32_t) <= cloud.data.size()))
+                {
+                    std::memcpy(cloud.data.data() + position, &nan_patterns[random(0, 2)], sizeof(uint32_t));
+                }
+            }
+        }
+        sequence.frames.push_back(cloud);
+    }
+    return sequence;
+}
+
+} //namespace benchmark
+} //namespace draco_point_cloud_transport
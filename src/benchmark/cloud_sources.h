@@ -0,0 +1,48 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_BENCHMARK_CLOUD_SOURCES_H
+#define DRACO_POINT_CLOUD_TRANSPORT_BENCHMARK_CLOUD_SOURCES_H
+
+// ros
+#include <sensor_msgs/PointCloud2.h>
+
+#include <string>
+#include <vector>
+
+namespace draco_point_cloud_transport
+{
+namespace benchmark
+{
+
+//! Consecutive point clouds (frames) of one source, encoded in order
+struct CloudSequence
+{
+    std::string name;
+    std::vector<sensor_msgs::PointCloud2> frames;
+};
+
+//! loads sensor_msgs/PointCloud2 messages of topic (all topics if empty) from rosbag, at most max_frames (0 = all)
+bool load_rosbag(const std::string& path, const std::string& topic, size_t max_frames, CloudSequence& sequence);
+
+//! loads PCD file with ascii or binary data
+bool load_pcd(const std::string& path, sensor_msgs::PointCloud2& cloud);
+
+//! loads vertices of PLY file with ascii or binary_little_endian format
+bool load_ply(const std::string& path, sensor_msgs::PointCloud2& cloud);
+
+//! organized scans of spinning lidar moving through a street-like scene: x, y, z, intensity, ring,
+//! missing returns have NaN coordinates
+CloudSequence generate_lidar(uint32_t rings, uint32_t columns, size_t frames, unsigned seed);
+
+//! organized depth images of RGB-D camera: x, y, z, rgb, invalid depth has NaN coordinates
+CloudSequence generate_rgbd(uint32_t height, uint32_t width, size_t frames, unsigned seed);
+
+//! unorganized dense mapping cloud sampled on surfaces: x, y, z, nx, ny, nz, rgb
+CloudSequence generate_dense_map(uint32_t number_of_points, size_t frames, unsigned seed);
+
+//! small clouds of random bytes, each frame with another random layout: all datatypes and counts, gaps between fields,
+//! overlapping fields, unknown datatypes, padding of rows, bytes after last row, NaN values and layouts not matching data
+CloudSequence generate_layouts(size_t frames, unsigned seed);
+
+} //namespace benchmark
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_BENCHMARK_CLOUD_SOURCES_H
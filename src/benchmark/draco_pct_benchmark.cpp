@@ -0,0 +1,962 @@
+// Benchmark of the draco point_cloud_transport pipeline (PC2toDraco, encoder, decoder, DracotoPC2) without ROS master.
+// Encodes point clouds from rosbags, PCD/PLY files or synthetic generators with a sweep of configurations and
+// reports throughput, latency percentiles, compression ratio and reconstruction error as CSV or JSON.
+
+#include "cloud_sources.h"
+#include "instrumentation.h"
+
+#include "draco_point_cloud_transport/draco_publisher.h"
+#include "draco_point_cloud_transport/draco_subscriber.h"
+#include "draco_point_cloud_transport/encoding_plan.h"
+#include "draco_point_cloud_transport/range_image.h"
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace draco_point_cloud_transport;
+using namespace draco_point_cloud_transport::benchmark;
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+//! publisher plugin driven directly, without advertising
+class BenchmarkPublisher : public DracoPublisher
+{
+public:
+    void configure(DracoPublisherConfig config)
+    {
+        configCb(config, 0);
+    }
+
+    //! converts and encodes message as publish() of the plugin does, publish_fn receives the compressed message
+    void encodeFrame(const sensor_msgs::PointCloud2& message, const PublishFn& publish_fn) const
+    {
+        publish(message, publish_fn);
+    }
+};
+
+//! subscriber plugin driven directly, without subscribing
+class BenchmarkSubscriber : public DracoSubscriber
+{
+public:
+    void configure(DracoSubscriberConfig config)
+    {
+        configCb(config, 0);
+    }
+
+    //! decodes and converts message as the plugin does for received messages, user_cb receives the point cloud
+    void decodeFrame(const CompressedPointCloud2ConstPtr& message, const Callback& user_cb)
+    {
+        internalCallback(message, user_cb);
+    }
+};
+
+//! one benchmarked configuration
+struct Combination
+{
+    std::string mode;
+    std::string method;
+    DracoPublisherConfig config;
+};
+
+//! measurements of one source encoded with one combination
+struct Result
+{
+    std::string source;
+    Combination combination;
+    size_t frames = 0;
+    size_t failures = 0;
+    //! frames decoded byte for byte identical to the original
+    size_t exact_frames = 0;
+    double points = 0.0;
+    double input_bytes = 0.0;
+    double compressed_bytes = 0.0;
+    std::vector<double> encode_seconds;
+    std::vector<double> decode_seconds;
+    //! heap allocations of each frame
+    std::vector<double> encode_allocations;
+    std::vector<double> decode_allocations;
+    //! bytes copied by memcpy and memmove in each frame
+    std::vector<double> encode_copied_bytes;
+    std::vector<double> decode_copied_bytes;
+    //! seconds to build EncodingPlan of each frame and to find it cached (layout hash and revision check)
+    std::vector<double> plan_build_seconds;
+    std::vector<double> plan_hit_seconds;
+    //! copies of compressed_data per segment made by encoding and decoding, in frames which could be checked
+    std::vector<double> encode_compressed_copies;
+    std::vector<double> decode_compressed_copies;
+    //! frames in which compressed_data was not copied exactly once by encoding or was copied by decoding
+    size_t unexpected_copy_frames = 0;
+    double squared_error_sum = 0.0;
+    double error_count = 0.0;
+    double max_error = 0.0;
+};
+
+struct Point
+{
+    double x, y, z;
+};
+
+//! finite x, y, z coordinates of float32 or float64 x, y, z fields, false if cloud has no such fields
+bool read_positions(const sensor_msgs::PointCloud2& cloud, std::vector<Point>& points)
+{
+    const sensor_msgs::PointField* position_fields[3] = {nullptr, nullptr, nullptr};
+    const char* names[3] = {"x", "y", "z"};
+    for (const sensor_msgs::PointField& field : cloud.fields)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if ((field.name == names[axis]) &&
+                ((field.datatype == sensor_msgs::PointField::FLOAT32) || (field.datatype == sensor_msgs::PointField::FLOAT64)))
+            {
+                position_fields[axis] = &field;
+            }
+        }
+    }
+    if ((position_fields[0] == nullptr) || (position_fields[1] == nullptr) || (position_fields[2] == nullptr))
+    {
+        return false;
+    }
+
+    const size_t number_of_points = size_t(cloud.height) * cloud.width;
+    points.clear();
+    points.reserve(number_of_points);
+    for (size_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        const uint8_t* point_data = cloud.data.data() + (point_index / cloud.width) * cloud.row_step + (point_index % cloud.width) * cloud.point_step;
+        double coordinates[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (position_fields[axis]->datatype == sensor_msgs::PointField::FLOAT32)
+            {
+                float value;
+                std::memcpy(&value, point_data + position_fields[axis]->offset, sizeof(value));
+                coordinates[axis] = value;
+            }
+            else
+            {
+                std::memcpy(&coordinates[axis], point_data + position_fields[axis]->offset, sizeof(double));
+            }
+        }
+        if (std::isfinite(coordinates[0]) && std::isfinite(coordinates[1]) && std::isfinite(coordinates[2]))
+        {
+            points.push_back({coordinates[0], coordinates[1], coordinates[2]});
+        }
+    }
+    return true;
+}
+
+//! uniform grid hashing points for nearest neighbour queries
+class PointGrid
+{
+public:
+    explicit PointGrid(const std::vector<Point>& points) : points_(points)
+    {
+        Point min = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+        Point max = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+        for (const Point& point : points_)
+        {
+            min = {std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z)};
+            max = {std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z)};
+        }
+        // sensor data lies on surfaces, about one point per cell of surface sampled at this density
+        const double diagonal = std::sqrt((max.x - min.x) * (max.x - min.x) + (max.y - min.y) * (max.y - min.y) + (max.z - min.z) * (max.z - min.z));
+        cell_size_ = std::max(1e-6, diagonal / std::sqrt(double(std::max<size_t>(1, points_.size()))));
+
+        for (uint32_t point_index = 0; point_index < points_.size(); point_index++)
+        {
+            cells_[key(cell(points_[point_index].x), cell(points_[point_index].y), cell(points_[point_index].z))].push_back(point_index);
+        }
+    }
+
+    //! squared distance to nearest point, infinity if grid is empty
+    double nearest_squared_distance(const Point& query) const
+    {
+        double best = std::numeric_limits<double>::infinity();
+        if (points_.empty())
+        {
+            return best;
+        }
+        const int64_t cx = cell(query.x);
+        const int64_t cy = cell(query.y);
+        const int64_t cz = cell(query.z);
+        // cells are searched in growing shells until no closer point can exist
+        for (int64_t radius = 0; ; radius++)
+        {
+            for (int64_t dx = -radius; dx <= radius; dx++)
+            {
+                for (int64_t dy = -radius; dy <= radius; dy++)
+                {
+                    for (int64_t dz = -radius; dz <= radius; dz++)
+                    {
+                        if (std::max({std::abs(dx), std::abs(dy), std::abs(dz)}) != radius)
+                        {
+                            continue;
+                        }
+                        std::unordered_map<uint64_t, std::vector<uint32_t> >::const_iterator it = cells_.find(key(cx + dx, cy + dy, cz + dz));
+                        if (it == cells_.end())
+                        {
+                            continue;
+                        }
+                        for (uint32_t point_index : it->second)
+                        {
+                            const Point& point = points_[point_index];
+                            const double distance = (point.x - query.x) * (point.x - query.x) + (point.y - query.y) * (point.y - query.y) +
+                                                    (point.z - query.z) * (point.z - query.z);
+                            best = std::min(best, distance);
+                        }
+                    }
+                }
+            }
+            const double searched = radius * cell_size_;
+            if (best <= searched * searched)
+            {
+                return best;
+            }
+            if (radius >= MAX_SEARCH_RADIUS)
+            {
+                break;
+            }
+        }
+        // isolated query, all points are compared
+        for (const Point& point : points_)
+        {
+            best = std::min(best, (point.x - query.x) * (point.x - query.x) + (point.y - query.y) * (point.y - query.y) +
+                                  (point.z - query.z) * (point.z - query.z));
+        }
+        return best;
+    }
+
+private:
+    //! shells searched before falling back to comparison with all points
+    static const int64_t MAX_SEARCH_RADIUS = 32;
+
+    int64_t cell(double coordinate) const
+    {
+        return int64_t(std::floor(coordinate / cell_size_));
+    }
+
+    static uint64_t key(int64_t x, int64_t y, int64_t z)
+    {
+        return (uint64_t(x) * 73856093u) ^ (uint64_t(y) * 19349663u) ^ (uint64_t(z) * 83492791u);
+    }
+
+    const std::vector<Point>& points_;
+    double cell_size_;
+    std::unordered_map<uint64_t, std::vector<uint32_t> > cells_;
+};
+
+//! checks if decoded cloud equals original in layout and every byte of data
+bool identical(const sensor_msgs::PointCloud2& original, const sensor_msgs::PointCloud2& decoded)
+{
+    if ((original.height != decoded.height) || (original.width != decoded.width) || (original.point_step != decoded.point_step) ||
+        (original.row_step != decoded.row_step) || (original.is_bigendian != decoded.is_bigendian) || (original.is_dense != decoded.is_dense) ||
+        (original.fields.size() != decoded.fields.size()) || (original.data != decoded.data))
+    {
+        return false;
+    }
+    for (size_t field_index = 0; field_index < original.fields.size(); field_index++)
+    {
+        const sensor_msgs::PointField& original_field = original.fields[field_index];
+        const sensor_msgs::PointField& decoded_field = decoded.fields[field_index];
+        if ((original_field.name != decoded_field.name) || (original_field.offset != decoded_field.offset) ||
+            (original_field.datatype != decoded_field.datatype) || (original_field.count != decoded_field.count))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//! adds symmetric point-to-point (D1) errors between x, y, z of original and decoded clouds to result
+void add_reconstruction_error(const sensor_msgs::PointCloud2& original, const sensor_msgs::PointCloud2& decoded, Result& result)
+{
+    std::vector<Point> original_points, decoded_points;
+    if (!read_positions(original, original_points) || !read_positions(decoded, decoded_points))
+    {
+        return;
+    }
+
+    // error in one direction misses lost or spurious points, the larger direction is reported
+    const PointGrid original_grid(original_points);
+    const PointGrid decoded_grid(decoded_points);
+    double sums[2] = {0.0, 0.0};
+    double max_distances[2] = {0.0, 0.0};
+    for (const Point& point : original_points)
+    {
+        const double distance = decoded_grid.nearest_squared_distance(point);
+        sums[0] += distance;
+        max_distances[0] = std::max(max_distances[0], distance);
+    }
+    for (const Point& point : decoded_points)
+    {
+        const double distance = original_grid.nearest_squared_distance(point);
+        sums[1] += distance;
+        max_distances[1] = std::max(max_distances[1], distance);
+    }
+    const int direction = (sums[0] / std::max<size_t>(1, original_points.size()) >= sums[1] / std::max<size_t>(1, decoded_points.size())) ? 0 : 1;
+    result.squared_error_sum += sums[direction];
+    result.error_count += (direction == 0) ? original_points.size() : decoded_points.size();
+    result.max_error = std::max(result.max_error, std::sqrt(std::max(max_distances[0], max_distances[1])));
+}
+
+//! copies of segments of compressed_data recorded while encoding or decoding message: chunks of tiled and stream messages,
+//! whole data otherwise. Segments shorter than MIN_RECORDED_COPY are not checked, false if no segment was checked.
+bool count_compressed_copies(const CompressedPointCloud2& message, size_t expected_copies, double& copies_per_segment, bool& as_expected)
+{
+    std::vector<size_t> offsets(message.chunk_offsets.begin(), message.chunk_offsets.end());
+    if (offsets.empty())
+    {
+        offsets.push_back(0);
+    }
+    size_t segments = 0, copies = 0;
+    as_expected = true;
+    for (size_t segment = 0; segment < offsets.size(); segment++)
+    {
+        const size_t end = (segment + 1 < offsets.size()) ? offsets[segment + 1] : message.compressed_data.size();
+        if ((offsets[segment] > end) || (end - offsets[segment] < MIN_RECORDED_COPY))
+        {
+            continue;
+        }
+        const size_t segment_copies = recorded_copies_of(message.compressed_data.data() + offsets[segment], end - offsets[segment]);
+        as_expected &= (segment_copies == expected_copies);
+        copies += segment_copies;
+        segments++;
+    }
+    copies_per_segment = (segments > 0) ? double(copies) / segments : 0.0;
+    return segments > 0;
+}
+
+//! lookups timed together, a single one is shorter than clock resolution
+const int PLAN_HIT_REPETITIONS = 1000;
+
+//! times building EncodingPlan of frame as the publisher does on a new layout or revision, and the lookup the publisher does
+//! for every other frame
+void time_encoding_plan(const sensor_msgs::PointCloud2& frame, const DracoPublisherConfig& config, Result& result)
+{
+    const uint32_t config_revision = 1;
+    const Clock::time_point build_start = Clock::now();
+    const EncodingPlan plan(frame, config, config_revision, "");
+    result.plan_build_seconds.push_back(std::chrono::duration<double>(Clock::now() - build_start).count());
+
+    size_t hits = 0;
+    const Clock::time_point hit_start = Clock::now();
+    for (int repetition = 0; repetition < PLAN_HIT_REPETITIONS; repetition++)
+    {
+        hits += plan.matches(EncodingPlan::layout_hash(frame), config_revision);
+    }
+    const double hit_seconds = std::chrono::duration<double>(Clock::now() - hit_start).count();
+    if (hits != PLAN_HIT_REPETITIONS)
+    {
+        std::cerr << "EncodingPlan does not match the frame it was built for!" << std::endl;
+    }
+    result.plan_hit_seconds.push_back(hit_seconds / PLAN_HIT_REPETITIONS);
+}
+
+//! encodes and decodes all frames of sequence with combination
+Result run(const CloudSequence& sequence, const Combination& combination, bool measure_error)
+{
+    Result result;
+    result.source = sequence.name;
+    result.combination = combination;
+
+    // fresh plugins, no state (plans, reference frames, pools) is shared between combinations
+    BenchmarkPublisher publisher;
+    publisher.configure(combination.config);
+    BenchmarkSubscriber subscriber;
+    subscriber.configure(DracoSubscriberConfig::__getDefault__());
+
+    for (const sensor_msgs::PointCloud2& frame : sequence.frames)
+    {
+        result.frames++;
+
+        // compressed message as it would arrive at subscriber
+        CompressedPointCloud2Ptr compressed;
+        Clock::time_point encoded;
+        uint64_t encode_allocations = 0, encode_copied_bytes = 0;
+        const uint64_t encode_start_allocations = allocation_count();
+        const uint64_t encode_start_copied_bytes = copied_bytes();
+        bool encode_copies_recorded = false;
+        start_recording_copies();
+        const Clock::time_point encode_start = Clock::now();
+        publisher.encodeFrame(frame, [&](const CompressedPointCloud2& message)
+        {
+            encoded = Clock::now();
+            // copy of message kept by benchmark is not counted
+            encode_allocations = allocation_count() - encode_start_allocations;
+            encode_copied_bytes = copied_bytes() - encode_start_copied_bytes;
+            encode_copies_recorded = stop_recording_copies();
+            compressed = boost::make_shared<CompressedPointCloud2>(message);
+        });
+        if (compressed == nullptr)
+        {
+            stop_recording_copies();
+            result.failures++;
+            continue;
+        }
+
+        // encoded data is copied once from draco::EncoderBuffer into the message, records are checked before decoding
+        // starts new ones; the copy kept by the benchmark was made after recording stopped
+        double encode_copies = 0.0;
+        bool encode_as_expected = true;
+        if (encode_copies_recorded && count_compressed_copies(*compressed, 1, encode_copies, encode_as_expected))
+        {
+            result.encode_compressed_copies.push_back(encode_copies);
+        }
+
+        sensor_msgs::PointCloud2ConstPtr decoded_frame;
+        Clock::time_point decoded;
+        uint64_t decode_allocations = 0, decode_copied_bytes = 0;
+        const uint64_t decode_start_allocations = allocation_count();
+        const uint64_t decode_start_copied_bytes = copied_bytes();
+        bool decode_copies_recorded = false;
+        start_recording_copies();
+        const Clock::time_point decode_start = Clock::now();
+        subscriber.decodeFrame(compressed, [&](const sensor_msgs::PointCloud2ConstPtr& message)
+        {
+            decoded = Clock::now();
+            decode_allocations = allocation_count() - decode_start_allocations;
+            decode_copied_bytes = copied_bytes() - decode_start_copied_bytes;
+            decode_copies_recorded = stop_recording_copies();
+            decoded_frame = message;
+        });
+        if (decoded_frame == nullptr)
+        {
+            stop_recording_copies();
+            result.failures++;
+            continue;
+        }
+
+        result.points += double(frame.height) * frame.width;
+        result.input_bytes += frame.data.size();
+        result.compressed_bytes += compressed->compressed_data.size();
+        result.encode_seconds.push_back(std::chrono::duration<double>(encoded - encode_start).count());
+        result.decode_seconds.push_back(std::chrono::duration<double>(decoded - decode_start).count());
+        result.encode_allocations.push_back(encode_allocations);
+        result.decode_allocations.push_back(decode_allocations);
+        result.encode_copied_bytes.push_back(encode_copied_bytes);
+        result.decode_copied_bytes.push_back(decode_copied_bytes);
+
+        // compressed data is decoded from the message in place
+        double decode_copies = 0.0;
+        bool decode_as_expected = true;
+        if (decode_copies_recorded && count_compressed_copies(*compressed, 0, decode_copies, decode_as_expected))
+        {
+            result.decode_compressed_copies.push_back(decode_copies);
+        }
+        if (!encode_as_expected || !decode_as_expected)
+        {
+            result.unexpected_copy_frames++;
+        }
+
+        time_encoding_plan(frame, combination.config, result);
+
+        if (identical(frame, *decoded_frame))
+        {
+            result.exact_frames++;
+        }
+        if (measure_error)
+        {
+            add_reconstruction_error(frame, *decoded_frame, result);
+        }
+    }
+    return result;
+}
+
+//! nearest-rank percentile in milliseconds
+double percentile_ms(std::vector<double> seconds, double fraction)
+{
+    if (seconds.empty())
+    {
+        return 0.0;
+    }
+    std::sort(seconds.begin(), seconds.end());
+    const size_t rank = size_t(std::ceil(fraction * seconds.size()));
+    return 1000.0 * seconds[std::min(seconds.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+double sum(const std::vector<double>& values)
+{
+    double total = 0.0;
+    for (double value : values)
+    {
+        total += value;
+    }
+    return total;
+}
+
+//! mean per frame after first frame, which fills pools and caches of plugins
+double steady_state(const std::vector<double>& values)
+{
+    if (values.size() < 2)
+    {
+        return values.empty() ? 0.0 : values.front();
+    }
+    return (sum(values) - values.front()) / (values.size() - 1);
+}
+
+std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::vector<int> split_int(const std::string& list)
+{
+    std::vector<int> values;
+    for (const std::string& item : split(list))
+    {
+        values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+//! names of encode_method values of DracoPublisher.cfg
+const char* METHOD_NAMES[] = {"auto", "kd_tree", "sequential"};
+
+//! configuration of combination, false if combination is not meaningful
+bool make_combination(const std::string& mode, int speed, const std::string& method, int bits, bool deduplicate, int tiles,
+                      int keyframe_interval, Combination& combination)
+{
+    DracoPublisherConfig config = DracoPublisherConfig::__getDefault__();
+    config.encode_speed = speed;
+    config.decode_speed = speed;
+    config.deduplicate = deduplicate;
+    config.quantization_POSITION = config.quantization_NORMAL = config.quantization_COLOR = bits;
+    config.quantization_TEX_COORD = config.quantization_GENERIC = bits;
+    // measured synchronously, in caller thread
+    config.async_queue_size = 0;
+    config.statistics_period = 0.0;
+
+    config.encode_method = -1;
+    for (int method_index = 0; method_index < 3; method_index++)
+    {
+        if (method == METHOD_NAMES[method_index])
+        {
+            config.encode_method = method_index;
+        }
+    }
+    if (config.encode_method < 0)
+    {
+        std::cerr << "Unknown encode method " << method << std::endl;
+        return false;
+    }
+    // sequential encoding is only possible without quantization, kd-tree is forced otherwise
+    config.force_quantization = (config.encode_method != 2);
+
+    if (mode == "prequantize")
+    {
+        config.prequantize = true;
+        if (!config.force_quantization)
+        {
+            return false;
+        }
+    }
+    else if (mode == "tiles")
+    {
+        config.tiles = tiles;
+    }
+    else if (mode == "streams")
+    {
+        config.attribute_streams = true;
+    }
+    else if (mode == "range_image")
+    {
+        config.range_image = true;
+    }
+    else if (mode == "lossless")
+    {
+        // quantization, deduplication and method are not used
+        config.lossless = true;
+        config.force_quantization = false;
+        config.deduplicate = false;
+    }
+    else if (mode == "temporal")
+    {
+        config.temporal_mode = true;
+        config.keyframe_interval = keyframe_interval;
+    }
+    else if (mode != "plain")
+    {
+        std::cerr << "Unknown mode " << mode << std::endl;
+        return false;
+    }
+    // attribute streams, range image, temporal and lossless frames are always encoded sequentially, method does not matter
+    if ((config.attribute_streams || config.range_image || config.temporal_mode || config.lossless) && (config.encode_method != 0))
+    {
+        return false;
+    }
+
+    combination.mode = mode;
+    combination.method = method;
+    combination.config = config;
+    return true;
+}
+
+const char* CSV_HEADER = "source,mode,encode_speed,encode_method,quantization_bits,deduplicate,frames,failures,exact_frames,points,input_bytes,"
+                         "compressed_bytes,compression_ratio,encode_points_per_s,encode_mb_per_s,decode_points_per_s,decode_mb_per_s,"
+                         "encode_ms_p50,encode_ms_p90,encode_ms_p99,decode_ms_p50,decode_ms_p90,decode_ms_p99,encode_allocations_per_frame,"
+                         "decode_allocations_per_frame,encode_copied_bytes_per_frame,decode_copied_bytes_per_frame,"
+                         "plan_build_us,plan_cache_hit_us,encode_compressed_copies,decode_compressed_copies,unexpected_copy_frames,rms_error,max_error";
+
+//! values of result in order of CSV_HEADER, error is empty (null in JSON) if it was not measured
+std::vector<std::string> result_values(const Result& result)
+{
+    const DracoPublisherConfig& config = result.combination.config;
+    const double encode_seconds = sum(result.encode_seconds);
+    const double decode_seconds = sum(result.decode_seconds);
+    const bool quantized = (config.force_quantization || config.range_image || config.temporal_mode) && !config.lossless;
+
+    std::vector<double> numbers = {double(config.encode_speed), quantized ? double(config.quantization_POSITION) : 0.0, double(config.deduplicate),
+                                   double(result.frames), double(result.failures), double(result.exact_frames), result.points, result.input_bytes, result.compressed_bytes,
+                                   (result.compressed_bytes > 0.0) ? result.input_bytes / result.compressed_bytes : 0.0,
+                                   (encode_seconds > 0.0) ? result.points / encode_seconds : 0.0,
+                                   (encode_seconds > 0.0) ? result.input_bytes / encode_seconds / 1e6 : 0.0,
+                                   (decode_seconds > 0.0) ? result.points / decode_seconds : 0.0,
+                                   (decode_seconds > 0.0) ? result.input_bytes / decode_seconds / 1e6 : 0.0,
+                                   percentile_ms(result.encode_seconds, 0.5), percentile_ms(result.encode_seconds, 0.9),
+                                   percentile_ms(result.encode_seconds, 0.99), percentile_ms(result.decode_seconds, 0.5),
+                                   percentile_ms(result.decode_seconds, 0.9), percentile_ms(result.decode_seconds, 0.99),
+                                   steady_state(result.encode_allocations), steady_state(result.decode_allocations),
+                                   steady_state(result.encode_copied_bytes), steady_state(result.decode_copied_bytes),
+                                   1e6 * sum(result.plan_build_seconds) / std::max<size_t>(1, result.plan_build_seconds.size()),
+                                   1e6 * sum(result.plan_hit_seconds) / std::max<size_t>(1, result.plan_hit_seconds.size()),
+                                   sum(result.encode_compressed_copies) / std::max<size_t>(1, result.encode_compressed_copies.size()),
+                                   sum(result.decode_compressed_copies) / std::max<size_t>(1, result.decode_compressed_copies.size()),
+                                   double(result.unexpected_copy_frames)};
+
+    std::vector<std::string> values = {result.source, result.combination.mode};
+    for (size_t index = 0; index < numbers.size(); index++)
+    {
+        std::ostringstream stream;
+        stream << std::setprecision(8) << numbers[index];
+        values.push_back(stream.str());
+        // method name follows encode_speed
+        if (index == 0)
+        {
+            values.push_back(result.combination.method);
+        }
+    }
+    for (double error : {std::sqrt(result.squared_error_sum / result.error_count), result.max_error})
+    {
+        std::ostringstream stream;
+        if (result.error_count > 0.0)
+        {
+            stream << std::setprecision(8) << error;
+        }
+        values.push_back(stream.str());
+    }
+    return values;
+}
+
+void write_csv(std::ostream& stream, const std::vector<Result>& results)
+{
+    stream << CSV_HEADER << "\n";
+    for (const Result& result : results)
+    {
+        const std::vector<std::string> values = result_values(result);
+        for (size_t index = 0; index < values.size(); index++)
+        {
+            stream << ((index > 0) ? "," : "") << values[index];
+        }
+        stream << "\n";
+    }
+}
+
+void write_json(std::ostream& stream, const std::vector<Result>& results)
+{
+    const std::vector<std::string> columns = split(CSV_HEADER);
+    stream << "[\n";
+    for (size_t result_index = 0; result_index < results.size(); result_index++)
+    {
+        const std::vector<std::string> values = result_values(results[result_index]);
+        stream << "  {";
+        for (size_t index = 0; index < columns.size(); index++)
+        {
+            stream << ((index > 0) ? ", " : "") << "\"" << columns[index] << "\": ";
+            // source, mode and method are strings
+            if ((index < 2) || (index == 3))
+            {
+                stream << "\"" << values[index] << "\"";
+            }
+            else
+            {
+                stream << (values[index].empty() ? "null" : values[index]);
+            }
+        }
+        stream << ((result_index + 1 < results.size()) ? "},\n" : "}\n");
+    }
+    stream << "]\n";
+}
+
+void print_usage()
+{
+    std::cerr << "Usage: draco_pct_benchmark [options]\n"
+                 "Inputs (default --synthetic lidar,rgbd,map):\n"
+                 "  --bag FILE [--topic TOPIC] [--max-frames N]   sensor_msgs/PointCloud2 messages of rosbag\n"
+                 "  --pcd FILE, --ply FILE                        single point cloud file, may be repeated\n"
+                 "  --synthetic lidar,rgbd,map,layouts            generated organized lidar, RGB-D, dense map and random layout clouds\n"
+                 "  --frames N                                    frames of synthetic sources (default 10)\n"
+                 "Sweep (comma separated lists):\n"
+                 "  --modes plain,prequantize,tiles,streams,range_image,temporal,lossless   (default plain)\n"
+                 "  --speeds 0,5,7,10  --methods auto,kd_tree,sequential  --bits 11,14  --deduplicate 1\n"
+                 "  --tiles N (default 4)  --keyframe-interval N (default 10)\n"
+                 "  Only these dimensions of DracoPublisher.cfg are swept, decode_speed follows encode_speed and bits apply\n"
+                 "  to all attribute types; every other option (expert quantization, rgba, region of interest, quality tiers,\n"
+                 "  chunk_points, asynchronous encoding, rate control, ...) keeps its default.\n"
+                 "Output:\n"
+                 "  --format csv|json  --output FILE  --no-error (skip reconstruction error)\n"
+                 "  --max-allocations N   fail if encoding or decoding allocates more than N times per frame after the first frame\n"
+                 "Exit status is 2 if a frame encoded with mode lossless was not restored byte for byte, 3 if allocations exceeded\n"
+                 "--max-allocations (malloc, calloc and realloc calls). Encoding reuses draco point clouds with their attribute\n"
+                 "buffers; known remaining allocations per frame are the metadata of the point cloud, the attribute encoders draco\n"
+                 "creates and the new draco::PointCloud with its attribute buffers the draco decoder creates for every frame (and tile).\n"
+                 "Exit status is 4 if compressed data was not copied exactly once by encoding or was copied by decoding.\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> bags, pcds, plys;
+    std::string topic, synthetic, format = "csv", output;
+    std::string modes = "plain", speeds = "0,5,7,10", methods = "auto,kd_tree,sequential", bits = "11,14", deduplicate = "1";
+    size_t max_frames = 0, frames = 10;
+    int tiles = 4, keyframe_interval = 10;
+    double max_allocations = -1.0;
+    bool measure_error = true;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        const std::string option = argv[arg];
+        if ((option == "--help") || (option == "-h"))
+        {
+            print_usage();
+            return 0;
+        }
+        if (option == "--no-error")
+        {
+            measure_error = false;
+            continue;
+        }
+        if (arg + 1 >= argc)
+        {
+            std::cerr << "Missing value of " << option << std::endl;
+            print_usage();
+            return 1;
+        }
+        const std::string value = argv[++arg];
+        if (option == "--bag") bags.push_back(value);
+        else if (option == "--topic") topic = value;
+        else if (option == "--max-frames") max_frames = std::stoul(value);
+        else if (option == "--pcd") pcds.push_back(value);
+        else if (option == "--ply") plys.push_back(value);
+        else if (option == "--synthetic") synthetic = value;
+        else if (option == "--frames") frames = std::stoul(value);
+        else if (option == "--modes") modes = value;
+        else if (option == "--speeds") speeds = value;
+        else if (option == "--methods") methods = value;
+        else if (option == "--bits") bits = value;
+        else if (option == "--deduplicate") deduplicate = value;
+        else if (option == "--tiles") tiles = std::stoi(value);
+        else if (option == "--keyframe-interval") keyframe_interval = std::stoi(value);
+        else if (option == "--format") format = value;
+        else if (option == "--output") output = value;
+        else if (option == "--max-allocations") max_allocations = std::stod(value);
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            print_usage();
+            return 1;
+        }
+    }
+    if ((format != "csv") && (format != "json"))
+    {
+        std::cerr << "Unknown format " << format << std::endl;
+        return 1;
+    }
+
+    // inputs
+    std::vector<CloudSequence> sequences;
+    for (const std::string& bag : bags)
+    {
+        CloudSequence sequence;
+        if (!load_rosbag(bag, topic, max_frames, sequence))
+        {
+            return 1;
+        }
+        sequences.push_back(sequence);
+    }
+    for (const std::string& pcd : pcds)
+    {
+        CloudSequence sequence;
+        sequence.name = pcd;
+        sequence.frames.resize(1);
+        if (!load_pcd(pcd, sequence.frames[0]))
+        {
+            return 1;
+        }
+        sequences.push_back(sequence);
+    }
+    for (const std::string& ply : plys)
+    {
+        CloudSequence sequence;
+        sequence.name = ply;
+        sequence.frames.resize(1);
+        if (!load_ply(ply, sequence.frames[0]))
+        {
+            return 1;
+        }
+        sequences.push_back(sequence);
+    }
+    if (sequences.empty() && synthetic.empty())
+    {
+        synthetic = "lidar,rgbd,map";
+    }
+    for (const std::string& generator : split(synthetic))
+    {
+        if (generator == "lidar") sequences.push_back(generate_lidar(64, 1024, frames, 1));
+        else if (generator == "rgbd") sequences.push_back(generate_rgbd(480, 640, frames, 2));
+        else if (generator == "map") sequences.push_back(generate_dense_map(200000, frames, 3));
+        else if (generator == "layouts") sequences.push_back(generate_layouts(frames, 4));
+        else
+        {
+            std::cerr << "Unknown synthetic source " << generator << std::endl;
+            return 1;
+        }
+    }
+
+    // sweep
+    std::vector<Result> results;
+    for (const CloudSequence& sequence : sequences)
+    {
+        if (sequence.frames.empty())
+        {
+            continue;
+        }
+        for (const std::string& mode : split(modes))
+        {
+            if ((mode == "range_image") && !PC2toRangeImage::compatible(sequence.frames.front()))
+            {
+                std::cerr << "Skipping range_image for unorganized source " << sequence.name << std::endl;
+                continue;
+            }
+            for (int speed : split_int(speeds))
+            {
+                for (const std::string& method : split(methods))
+                {
+                    for (int quantization_bits : split_int(bits))
+                    {
+                        for (int dedup : split_int(deduplicate))
+                        {
+                            Combination combination;
+                            if (!make_combination(mode, speed, method, quantization_bits, dedup != 0, tiles, keyframe_interval, combination))
+                            {
+                                continue;
+                            }
+                            // without quantization all bits settings are the same combination, without deduplication all deduplicate settings
+                            if (((!combination.config.force_quantization) && (quantization_bits != split_int(bits).front())) ||
+                                (combination.config.lossless && (dedup != split_int(deduplicate).front())))
+                            {
+                                continue;
+                            }
+                            std::cerr << sequence.name << " " << mode << " speed " << speed << " " << method << " " << quantization_bits
+                                      << " bits" << (dedup ? " deduplicated" : "") << std::endl;
+                            results.push_back(run(sequence, combination, measure_error));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // lossless mode must restore every frame exactly
+    bool lossless_ok = true;
+    for (const Result& result : results)
+    {
+        if (result.combination.config.lossless && (result.exact_frames != result.frames))
+        {
+            std::cerr << "Lossless round trip of " << result.source << " restored " << result.exact_frames << " of " << result.frames
+                      << " frames exactly!" << std::endl;
+            lossless_ok = false;
+        }
+    }
+
+    // compressed data is copied once into the message and decoded in place
+    bool copies_ok = true;
+    for (const Result& result : results)
+    {
+        if (result.unexpected_copy_frames > 0)
+        {
+            std::cerr << result.source << " " << result.combination.mode << " copied compressed data unexpectedly in "
+                      << result.unexpected_copy_frames << " of " << result.frames << " frames!" << std::endl;
+            copies_ok = false;
+        }
+    }
+
+    // steady-state allocations, pools and plans are filled by the first frame
+    bool allocations_ok = true;
+    for (const Result& result : results)
+    {
+        if ((max_allocations >= 0.0) && ((steady_state(result.encode_allocations) > max_allocations) ||
+                                         (steady_state(result.decode_allocations) > max_allocations)))
+        {
+            std::cerr << result.source << " " << result.combination.mode << " allocated " << steady_state(result.encode_allocations)
+                      << " times per frame when encoding and " << steady_state(result.decode_allocations) << " when decoding!" << std::endl;
+            allocations_ok = false;
+        }
+    }
+
+    // report
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            std::cerr << "Could not open " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& stream = output.empty() ? std::cout : file;
+    if (format == "csv")
+    {
+        write_csv(stream, results);
+    }
+    else
+    {
+        write_json(stream, results);
+    }
+    if (!lossless_ok)
+    {
+        return 2;
+    }
+    if (!allocations_ok)
+    {
+        return 3;
+    }
+    return copies_ok ? 0 : 4;
+}
@@ -0,0 +1,208 @@
+#include "instrumentation.h"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace draco_point_cloud_transport
+{
+namespace benchmark
+{
+
+namespace
+{
+
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> copies(0);
+
+typedef void* (*CopyFunction)(void*, const void*, std::size_t);
+
+//! byte by byte copy used while implementation of libc is looked up, volatile keeps compiler from calling memcpy
+void* plain_copy(void* destination, const void* source, std::size_t size)
+{
+    volatile unsigned char* to = static_cast<volatile unsigned char*>(destination);
+    const unsigned char* from = static_cast<const unsigned char*>(source);
+    for (std::size_t index = 0; index < size; index++)
+    {
+        to[index] = from[index];
+    }
+    return destination;
+}
+
+//! next definition of name after this executable, i.e. the one of libc
+CopyFunction libc_copy(const char* name, std::atomic<CopyFunction>& function)
+{
+    CopyFunction resolved = function.load(std::memory_order_acquire);
+    if (resolved == nullptr)
+    {
+        // copies made by the dynamic linker during lookup use plain_copy
+        static thread_local bool resolving = false;
+        if (resolving)
+        {
+            return plain_copy;
+        }
+        resolving = true;
+        resolved = reinterpret_cast<CopyFunction>(dlsym(RTLD_NEXT, name));
+        resolving = false;
+        if (resolved == nullptr)
+        {
+            std::abort();
+        }
+        function.store(resolved, std::memory_order_release);
+    }
+    return resolved;
+}
+
+std::atomic<CopyFunction> libc_memcpy(nullptr);
+std::atomic<CopyFunction> libc_memmove(nullptr);
+
+//! bytes at each end of copied data identifying copies
+const size_t FINGERPRINT_BYTES = 64;
+
+//! FNV-1a hash of size and bytes at both ends of data
+uint64_t fingerprint(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull ^ size;
+    const size_t head = (size < FINGERPRINT_BYTES) ? size : FINGERPRINT_BYTES;
+    for (size_t index = 0; index < head; index++)
+    {
+        hash = (hash ^ data[index]) * 1099511628211ull;
+    }
+    for (size_t index = size - head; index < size; index++)
+    {
+        hash = (hash ^ data[index]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+struct CopyRecord
+{
+    size_t size;
+    uint64_t fingerprint;
+};
+
+//! records are written without allocation, copies beyond capacity are only counted
+const size_t RECORD_CAPACITY = 1 << 16;
+CopyRecord records[RECORD_CAPACITY];
+std::atomic<size_t> number_of_records(0);
+std::atomic<bool> recording(false);
+
+void record_copy(const void* destination, size_t size)
+{
+    if ((size < MIN_RECORDED_COPY) || !recording.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    const size_t record_index = number_of_records.fetch_add(1, std::memory_order_relaxed);
+    if (record_index < RECORD_CAPACITY)
+    {
+        records[record_index] = {size, fingerprint(static_cast<const uint8_t*>(destination), size)};
+    }
+}
+
+} // namespace
+
+uint64_t allocation_count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t copied_bytes()
+{
+    return copies.load(std::memory_order_relaxed);
+}
+
+void start_recording_copies()
+{
+    number_of_records.store(0, std::memory_order_relaxed);
+    recording.store(true, std::memory_order_release);
+}
+
+bool stop_recording_copies()
+{
+    recording.store(false, std::memory_order_release);
+    return number_of_records.load(std::memory_order_acquire) <= RECORD_CAPACITY;
+}
+
+size_t recorded_copies_of(const uint8_t* data, size_t size)
+{
+    const uint64_t data_fingerprint = fingerprint(data, size);
+    const size_t recorded = std::min(number_of_records.load(std::memory_order_acquire), RECORD_CAPACITY);
+    size_t copies_of_data = 0;
+    for (size_t record_index = 0; record_index < recorded; record_index++)
+    {
+        copies_of_data += (records[record_index].size == size) && (records[record_index].fingerprint == data_fingerprint);
+    }
+    return copies_of_data;
+}
+
+} //namespace benchmark
+} //namespace draco_point_cloud_transport
+
+// interposed copy functions of libc, also called by draco and ros libraries; checked forms are used with _FORTIFY_SOURCE
+
+extern "C" void* memcpy(void* destination, const void* source, std::size_t size) noexcept
+{
+    draco_point_cloud_transport::benchmark::copies.fetch_add(size, std::memory_order_relaxed);
+    draco_point_cloud_transport::benchmark::libc_copy("memcpy", draco_point_cloud_transport::benchmark::libc_memcpy)(destination, source, size);
+    draco_point_cloud_transport::benchmark::record_copy(destination, size);
+    return destination;
+}
+
+extern "C" void* memmove(void* destination, const void* source, std::size_t size) noexcept
+{
+    draco_point_cloud_transport::benchmark::copies.fetch_add(size, std::memory_order_relaxed);
+    draco_point_cloud_transport::benchmark::libc_copy("memmove", draco_point_cloud_transport::benchmark::libc_memmove)(destination, source, size);
+    draco_point_cloud_transport::benchmark::record_copy(destination, size);
+    return destination;
+}
+
+extern "C" void* __memcpy_chk(void* destination, const void* source, std::size_t size, std::size_t destination_size) noexcept
+{
+    if (size > destination_size)
+    {
+        std::abort();
+    }
+    return memcpy(destination, source, size);
+}
+
+extern "C" void* __memmove_chk(void* destination, const void* source, std::size_t size, std::size_t destination_size) noexcept
+{
+    if (size > destination_size)
+    {
+        std::abort();
+    }
+    return memmove(destination, source, size);
+}
+
+// interposed allocation functions of libc, also called by operator new of libstdc++, draco and ros libraries; they forward to the
+// allocator of glibc, so memory is released by its free
+
+extern "C" void* __libc_malloc(std::size_t size);
+extern "C" void* __libc_calloc(std::size_t number, std::size_t size);
+extern "C" void* __libc_realloc(void* pointer, std::size_t size);
+
+extern "C" void* malloc(std::size_t size) noexcept
+{
+    draco_point_cloud_transport::benchmark::allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t number, std::size_t size) noexcept
+{
+    draco_point_cloud_transport::benchmark::allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(number, size);
+}
+
+extern "C" void* realloc(void* pointer, std::size_t size) noexcept
+{
+    // realloc may move the block, every call counts as an allocation
+    if (size > 0)
+    {
+        draco_point_cloud_transport::benchmark::allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_realloc(pointer, size);
+}
@@ -0,0 +1,37 @@
+#ifndef DRACO_POINT_CLOUD_TRANSPORT_BENCHMARK_INSTRUMENTATION_H
+#define DRACO_POINT_CLOUD_TRANSPORT_BENCHMARK_INSTRUMENTATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace draco_point_cloud_transport
+{
+namespace benchmark
+{
+
+//! Heap allocations of all threads of the benchmark since start through calls of malloc, calloc and realloc, which
+//! instrumentation.cpp interposes for the executable and the shared libraries it loads. Covers operator new of the plugins,
+//! draco and ros as well as their direct malloc calls; aligned allocations (posix_memalign, aligned_alloc) are not counted.
+uint64_t allocation_count();
+
+//! Bytes copied by all threads of the benchmark since start through calls of memcpy and memmove, which instrumentation.cpp
+//! interposes for the executable and the shared libraries it loads. Copies the compiler inlines (small or fixed-size
+//! values, e.g. single fields of a point) do not call memcpy and are not counted.
+uint64_t copied_bytes();
+
+//! shortest copy recorded by start_recording_copies, shorter ones are single values or points
+const size_t MIN_RECORDED_COPY = 256;
+
+//! starts recording memcpy and memmove calls of all threads copying at least MIN_RECORDED_COPY bytes, drops earlier records
+void start_recording_copies();
+
+//! stops recording, false if more copies were made than could be recorded
+bool stop_recording_copies();
+
+//! number of recorded copies of the size bytes at data, recognized by size and by bytes at both ends of copied data
+size_t recorded_copies_of(const uint8_t* data, size_t size);
+
+} //namespace benchmark
+} //namespace draco_point_cloud_transport
+
+#endif // DRACO_POINT_CLOUD_TRANSPORT_BENCHMARK_INSTRUMENTATION_H
@@ -1,6 +1,11 @@
 
 #include "draco_point_cloud_transport/conversion_utilities.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
 void assign_description_of_PointCloud2(sensor_msgs::PointCloud2& target, const draco_point_cloud_transport::CompressedPointCloud2& source)
 {
     target.header = source.header;
@@ -36,3 +41,396 @@ void assign_description_of_PointCloud2(sensor_msgs::PointCloud2& target, const d
     target.row_step = source->row_step;
     target.is_dense = source->is_dense;
 }
+
+uint32_t point_field_size(const sensor_msgs::PointField& field)
+{
+    switch (field.datatype)
+    {
+        case sensor_msgs::PointField::INT8 :
+        case sensor_msgs::PointField::UINT8 :
+            return field.count;
+        case sensor_msgs::PointField::INT16 :
+        case sensor_msgs::PointField::UINT16 :
+            return 2 * field.count;
+        case sensor_msgs::PointField::INT32 :
+        case sensor_msgs::PointField::UINT32 :
+        case sensor_msgs::PointField::FLOAT32 :
+            return 4 * field.count;
+        case sensor_msgs::PointField::FLOAT64 :
+            return 8 * field.count;
+        default :
+            return 0;
+    }
+}
+
+int64_t float32_field_offset(const sensor_msgs::PointCloud2& PC2, const std::string& name)
+{
+    for (const sensor_msgs::PointField& field : PC2.fields)
+    {
+        if ((field.name == name) && (field.datatype == sensor_msgs::PointField::FLOAT32) && (field.count == 1) &&
+            (field.offset + sizeof(float) <= PC2.point_step))
+        {
+            return field.offset;
+        }
+    }
+    return -1;
+}
+
+void project_fields(const std::vector<sensor_msgs::PointField>& fields, uint32_t point_step, const std::vector<std::string>& field_names,
+                    std::vector<sensor_msgs::PointField>& out_fields, uint32_t& out_point_step, std::vector<int>& out_field_index)
+{
+    out_fields.clear();
+    out_field_index.assign(fields.size(), -1);
+
+    // all fields in original layout
+    if (field_names.empty())
+    {
+        out_fields = fields;
+        out_point_step = point_step;
+        for (size_t field_index = 0; field_index < fields.size(); field_index++)
+        {
+            out_field_index[field_index] = field_index;
+        }
+        return;
+    }
+
+    // requested fields keep their order, but are packed without gaps
+    out_point_step = 0;
+    for (size_t field_index = 0; field_index < fields.size(); field_index++)
+    {
+        const sensor_msgs::PointField& field = fields[field_index];
+        if (std::find(field_names.begin(), field_names.end(), field.name) == field_names.end())
+        {
+            continue;
+        }
+        out_field_index[field_index] = out_fields.size();
+        out_fields.push_back(field);
+        out_fields.back().offset = out_point_step;
+        out_point_step += point_field_size(field);
+    }
+}
+
+namespace
+{
+
+//! strided copy of fixed size values, the constant size lets the compiler emit plain (vector) moves instead of memcpy calls
+template <size_t VALUE_SIZE>
+void scatter_fixed_size(const uint8_t* in_data, size_t in_stride, uint8_t* out_data, size_t out_stride, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        std::memcpy(out_data, in_data, VALUE_SIZE);
+        in_data += in_stride;
+        out_data += out_stride;
+    }
+}
+
+//! strided copy of values of any size
+void scatter_any_size(const uint8_t* in_data, size_t in_stride, uint8_t* out_data, size_t out_stride, uint32_t count, size_t value_size)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        std::memcpy(out_data, in_data, value_size);
+        in_data += in_stride;
+        out_data += out_stride;
+    }
+}
+
+//! strided copy dispatched on value size, common layouts (intensity, rgb, xy, xyz, xyz+pad / rgba float) get a specialized kernel
+void scatter_block(const uint8_t* in_data, size_t in_stride, uint8_t* out_data, size_t out_stride, uint32_t count, size_t value_size)
+{
+    switch (value_size)
+    {
+        case 1 : scatter_fixed_size<1>(in_data, in_stride, out_data, out_stride, count); break;
+        case 2 : scatter_fixed_size<2>(in_data, in_stride, out_data, out_stride, count); break;
+        case 4 : scatter_fixed_size<4>(in_data, in_stride, out_data, out_stride, count); break;
+        case 8 : scatter_fixed_size<8>(in_data, in_stride, out_data, out_stride, count); break;
+        case 12 : scatter_fixed_size<12>(in_data, in_stride, out_data, out_stride, count); break;
+        case 16 : scatter_fixed_size<16>(in_data, in_stride, out_data, out_stride, count); break;
+        case 24 : scatter_fixed_size<24>(in_data, in_stride, out_data, out_stride, count); break;
+        default : scatter_any_size(in_data, in_stride, out_data, out_stride, count, value_size);
+    }
+}
+
+} // namespace
+
+bool scatter_attribute(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                       uint8_t* out_data, uint32_t available_bytes, uint32_t point_step)
+{
+    // size of copied components of one value of attribute in Bytes, merged fields (e.g. x of x, y, z) are a part of value
+    const size_t component_size = draco::DataTypeLength(attribute.data_type());
+    const size_t component_offset = component_size * first_component;
+    const size_t value_size = component_size * number_of_components;
+
+    if ((value_size == 0) || (value_size > available_bytes) ||
+        (uint64_t(first_component) + number_of_components > uint64_t(attribute.num_components())))
+    {
+        return false;
+    }
+
+    if (number_of_points == 0)
+    {
+        return true;
+    }
+
+    if (attribute.is_mapping_identity())
+    {
+        // values are stored in point order, copy them as one strided block
+        scatter_block(attribute.GetAddress(draco::AttributeValueIndex(0)) + component_offset, attribute.byte_stride(), out_data, point_step,
+                      number_of_points, value_size);
+        return true;
+    }
+
+    // values are shared between points, resolve mapping point by point
+    for (draco::PointIndex point_index(0); point_index < draco::PointIndex(number_of_points); ++point_index)
+    {
+        std::memcpy(out_data, attribute.GetAddress(attribute.mapped_index(point_index)) + component_offset, value_size);
+        out_data += point_step;
+    }
+    return true;
+}
+
+draco::DataType quantized_data_type(int bits)
+{
+    if (bits <= 8)
+    {
+        return draco::DT_UINT8;
+    }
+    if (bits <= 16)
+    {
+        return draco::DT_UINT16;
+    }
+    return draco::DT_UINT32;
+}
+
+void compute_quantization_parameters(const uint8_t* in_data, uint32_t number_of_points, uint32_t count, uint32_t point_step, int bits, QuantizationParameters& params)
+{
+    std::vector<float> min_values(count, std::numeric_limits<float>::max());
+    std::vector<float> max_values(count, std::numeric_limits<float>::lowest());
+
+    for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        const uint8_t* point_data = in_data + size_t(point_index) * point_step;
+        for (uint32_t c = 0; c < count; c++)
+        {
+            float value;
+            std::memcpy(&value, point_data + c * sizeof(float), sizeof(float));
+            // comparisons with NaN are false, infinities are filtered explicitly
+            if (std::isfinite(value))
+            {
+                min_values[c] = std::min(min_values[c], value);
+                max_values[c] = std::max(max_values[c], value);
+            }
+        }
+    }
+
+    params.bits = bits;
+    params.origin.assign(count, 0.0);
+    params.range = 0.0;
+    for (uint32_t c = 0; c < count; c++)
+    {
+        // component without any finite value
+        if (min_values[c] > max_values[c])
+        {
+            continue;
+        }
+        params.origin[c] = min_values[c];
+        params.range = std::max(params.range, double(max_values[c]) - double(min_values[c]));
+    }
+    // all values are equal, any range quantizes them to 0
+    if (params.range == 0.0)
+    {
+        params.range = 1.0;
+    }
+}
+
+namespace
+{
+
+template <typename QuantizedT>
+void quantize_float32_typed(const uint8_t* in_data, uint32_t number_of_points, uint32_t count, uint32_t point_step, const QuantizationParameters& params, QuantizedT* out_data)
+{
+    const double max_quantized_value = double((uint64_t(1) << params.bits) - 1);
+    const double scale = max_quantized_value / params.range;
+
+    for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        const uint8_t* point_data = in_data + size_t(point_index) * point_step;
+        for (uint32_t c = 0; c < count; c++)
+        {
+            float value;
+            std::memcpy(&value, point_data + c * sizeof(float), sizeof(float));
+            double quantized = std::floor((double(value) - params.origin[c]) * scale + 0.5);
+            // NaN fails both comparisons and ends up as 0 as well
+            if (!(quantized > 0.0))
+            {
+                quantized = 0.0;
+            }
+            else if (quantized > max_quantized_value)
+            {
+                quantized = max_quantized_value;
+            }
+            *out_data++ = QuantizedT(quantized);
+        }
+    }
+}
+
+template <typename QuantizedT>
+void dequantize_typed(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                      uint8_t* out_data, uint32_t point_step, const QuantizationParameters& params)
+{
+    const double max_quantized_value = double((uint64_t(1) << params.bits) - 1);
+    const double scale = params.range / max_quantized_value;
+
+    for (draco::PointIndex point_index(0); point_index < draco::PointIndex(number_of_points); ++point_index)
+    {
+        const uint8_t* in_data = attribute.GetAddress(attribute.mapped_index(point_index));
+        for (uint32_t c = 0; c < number_of_components; c++)
+        {
+            QuantizedT quantized;
+            std::memcpy(&quantized, in_data + (first_component + c) * sizeof(QuantizedT), sizeof(QuantizedT));
+            const float value = float(double(quantized) * scale + params.origin[first_component + c]);
+            std::memcpy(out_data + c * sizeof(float), &value, sizeof(float));
+        }
+        out_data += point_step;
+    }
+}
+
+template <typename QuantizedT, typename OutT>
+void scatter_quantized_typed(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                             uint8_t* out_data, uint32_t point_step)
+{
+    for (draco::PointIndex point_index(0); point_index < draco::PointIndex(number_of_points); ++point_index)
+    {
+        const uint8_t* in_data = attribute.GetAddress(attribute.mapped_index(point_index));
+        for (uint32_t c = 0; c < number_of_components; c++)
+        {
+            QuantizedT quantized;
+            std::memcpy(&quantized, in_data + (first_component + c) * sizeof(QuantizedT), sizeof(QuantizedT));
+            const OutT value = OutT(quantized);
+            std::memcpy(out_data + c * sizeof(OutT), &value, sizeof(OutT));
+        }
+        out_data += point_step;
+    }
+}
+
+template <typename QuantizedT>
+bool scatter_quantized_to(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                          uint8_t* out_data, uint32_t point_step, draco::DataType out_data_type)
+{
+    switch (out_data_type)
+    {
+        case draco::DT_UINT8 :
+            scatter_quantized_typed<QuantizedT, uint8_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step);
+            return true;
+        case draco::DT_UINT16 :
+            scatter_quantized_typed<QuantizedT, uint16_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step);
+            return true;
+        case draco::DT_UINT32 :
+            scatter_quantized_typed<QuantizedT, uint32_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step);
+            return true;
+        default :
+            return false;
+    }
+}
+
+} // namespace
+
+void quantize_float32(const uint8_t* in_data, uint32_t number_of_points, uint32_t count, uint32_t point_step, const QuantizationParameters& params, std::vector<uint8_t>& out_data)
+{
+    const draco::DataType data_type = quantized_data_type(params.bits);
+    out_data.resize(size_t(number_of_points) * count * draco::DataTypeLength(data_type));
+
+    switch (data_type)
+    {
+        case draco::DT_UINT8 :
+            quantize_float32_typed(in_data, number_of_points, count, point_step, params, reinterpret_cast<uint8_t*>(out_data.data()));
+            break;
+        case draco::DT_UINT16 :
+            quantize_float32_typed(in_data, number_of_points, count, point_step, params, reinterpret_cast<uint16_t*>(out_data.data()));
+            break;
+        default :
+            quantize_float32_typed(in_data, number_of_points, count, point_step, params, reinterpret_cast<uint32_t*>(out_data.data()));
+    }
+}
+
+bool dequantize_attribute(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components, uint32_t number_of_points,
+                          uint8_t* out_data, uint32_t available_bytes, uint32_t point_step, const QuantizationParameters& params)
+{
+    if ((number_of_components * sizeof(float) > available_bytes) || (params.origin.size() != size_t(attribute.num_components())) ||
+        (uint64_t(first_component) + number_of_components > uint64_t(attribute.num_components())))
+    {
+        return false;
+    }
+
+    switch (attribute.data_type())
+    {
+        case draco::DT_UINT8 :
+            dequantize_typed<uint8_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, params);
+            return true;
+        case draco::DT_UINT16 :
+            dequantize_typed<uint16_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, params);
+            return true;
+        case draco::DT_UINT32 :
+            dequantize_typed<uint32_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, params);
+            return true;
+        case draco::DT_INT32 :
+            dequantize_typed<int32_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, params);
+            return true;
+        default :
+            return false;
+    }
+}
+
+bool scatter_quantized_attribute(const draco::PointAttribute& attribute, uint32_t first_component, uint32_t number_of_components,
+                                 uint32_t number_of_points, uint8_t* out_data, uint32_t available_bytes, uint32_t point_step,
+                                 draco::DataType out_data_type)
+{
+    // values of the same type are copied as they are
+    if (attribute.data_type() == out_data_type)
+    {
+        return scatter_attribute(attribute, first_component, number_of_components, number_of_points, out_data, available_bytes, point_step);
+    }
+
+    if ((number_of_components * uint64_t(draco::DataTypeLength(out_data_type)) > available_bytes) ||
+        (uint64_t(first_component) + number_of_components > uint64_t(attribute.num_components())))
+    {
+        return false;
+    }
+
+    // draco keeps attributes with skipped dequantization as uint32, values are narrowed to the type fitting their bits
+    switch (attribute.data_type())
+    {
+        case draco::DT_UINT8 :
+            return scatter_quantized_to<uint8_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, out_data_type);
+        case draco::DT_UINT16 :
+            return scatter_quantized_to<uint16_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, out_data_type);
+        case draco::DT_UINT32 :
+            return scatter_quantized_to<uint32_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, out_data_type);
+        case draco::DT_INT32 :
+            return scatter_quantized_to<int32_t>(attribute, first_component, number_of_components, number_of_points, out_data, point_step, out_data_type);
+        default :
+            return false;
+    }
+}
+
+void add_quantization_metadata(draco::GeometryMetadata& metadata, int att_id, const QuantizationParameters& params)
+{
+    const std::string suffix = std::to_string(att_id);
+    metadata.AddEntryInt("quantization_bits_" + suffix, params.bits);
+    metadata.AddEntryDoubleArray("quantization_origin_" + suffix, params.origin);
+    metadata.AddEntryDouble("quantization_range_" + suffix, params.range);
+}
+
+bool get_quantization_metadata(const draco::GeometryMetadata& metadata, int att_id, QuantizationParameters& params)
+{
+    const std::string suffix = std::to_string(att_id);
+    int32_t bits = 0;
+    if (!metadata.GetEntryInt("quantization_bits_" + suffix, &bits))
+    {
+        return false;
+    }
+    params.bits = bits;
+    return metadata.GetEntryDoubleArray("quantization_origin_" + suffix, &params.origin) &&
+           metadata.GetEntryDouble("quantization_range_" + suffix, &params.range);
+}
@@ -5,11 +5,17 @@
 #include "draco_point_cloud_transport/draco_common.h"
 #include "draco_point_cloud_transport/conversion_utilities.h"
 #include "draco_point_cloud_transport/PC2toDraco.h"
+#include "draco_point_cloud_transport/lossless.h"
+#include "draco_point_cloud_transport/range_image.h"
+#include "draco_point_cloud_transport/region_filter.h"
 
 // draco library
 #include <draco/compression/expert_encode.h>
 #include <draco/compression/encode.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <vector>
 
 namespace draco_point_cloud_transport
@@ -23,66 +29,322 @@ void DracoPublisher::advertiseImpl(ros::NodeHandle &nh, const std::string &base_
   typedef point_cloud_transport::SimplePublisherPlugin<draco_point_cloud_transport::CompressedPointCloud2> Base;
   Base::advertiseImpl(nh, base_topic, queue_size, user_connect_cb, user_disconnect_cb, tracked_object, latch);
 
+  // quality tiers are advertised and shut down by reconfiguration
+  {
+    std::lock_guard<std::mutex> lock(tiers_mutex_);
+    tiers_nh_ = nh;
+    tiers_queue_size_ = queue_size;
+    tiers_latch_ = latch;
+    tiers_advertisable_ = true;
+    low_tier_.name = "low";
+    high_tier_.name = "high";
+  }
+
   // Set up reconfigure server for this topic
   reconfigure_server_ = boost::make_shared<ReconfigureServer>(this->nh());
   ReconfigureServer::CallbackType f = boost::bind(&DracoPublisher::configCb, this, _1, _2);
   reconfigure_server_->setCallback(f);
 
   base_topic_ = base_topic;
+
+  statistics_.reset(new Statistics("publisher",
+                                   {"convert_time", "encode_time", "serialize_time", "publish_time", "input_bytes", "output_bytes",
+                                    "compression_ratio", "input_points", "encoded_points", "allocations", "dropped_frames"},
+                                   {"s", "s", "s", "s", "B", "B", "", "", "", "", ""}));
+  statistics_->advertise(this->nh());
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  statistics_->set_period(base_config_.statistics_period);
+}
+
+void DracoPublisher::updateQualityTiers(bool enabled)
+{
+  std::lock_guard<std::mutex> lock(tiers_mutex_);
+  for (QualityTier* tier : {&low_tier_, &high_tier_})
+  {
+    // tier subscribers are counted by getNumSubscribers, user status callbacks are not connected to tiers
+    if (enabled && tiers_advertisable_ && !tier->publisher)
+    {
+      tier->publisher = tiers_nh_.advertise<draco_point_cloud_transport::CompressedPointCloud2>(this->getTopic() + "/" + tier->name,
+                                                                                               tiers_queue_size_, tiers_latch_);
+    }
+    else if ((!enabled || !tiers_advertisable_) && tier->publisher)
+    {
+      tier->publisher.shutdown();
+      tier->publisher = ros::Publisher();
+    }
+  }
+}
+
+ros::Publisher DracoPublisher::tierPublisher(const QualityTier& tier) const
+{
+  std::lock_guard<std::mutex> lock(tiers_mutex_);
+  return tier.publisher;
+}
+
+uint32_t DracoPublisher::getNumSubscribers() const
+{
+  typedef point_cloud_transport::SimplePublisherPlugin<draco_point_cloud_transport::CompressedPointCloud2> Base;
+  return Base::getNumSubscribers() + tierPublisher(low_tier_).getNumSubscribers() + tierPublisher(high_tier_).getNumSubscribers();
 }
 
 void DracoPublisher::configCb(Config& config, uint32_t level)
 {
+  updateQualityTiers(config.quality_tiers);
+  if (statistics_ != nullptr)
+  {
+    statistics_->set_period(config.statistics_period);
+  }
+
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  base_config_ = config;
   config_ = config;
+  // rate control starts again from configured settings
+  rate_controller_.reset(config);
+  if ((config.target_bandwidth > 0.0) || (config.max_encode_latency > 0.0))
+  {
+    rate_controller_.apply(config_);
+  }
+  // invalidates cached encoding plan
+  config_revision_++;
 }
 
-void DracoPublisher::publish(const sensor_msgs::PointCloud2& message, const PublishFn& publish_fn) const
+std::shared_ptr<const EncodingPlan> DracoPublisher::encodingPlan(const sensor_msgs::PointCloud2& message, const Config& config,
+                                                                 uint32_t config_revision) const
+{
+    return encodingPlan(message, config, config_revision, plan_);
+}
+
+std::shared_ptr<const EncodingPlan> DracoPublisher::encodingPlan(const sensor_msgs::PointCloud2& message, const Config& config,
+                                                                 uint32_t config_revision, std::shared_ptr<const EncodingPlan>& cached_plan) const
+{
+    const size_t layout_hash = EncodingPlan::layout_hash(message);
+
+    std::lock_guard<std::mutex> lock(plan_mutex_);
+    // plan is resolved only for new field layouts and configurations
+    if ((cached_plan == nullptr) || !cached_plan->matches(layout_hash, config_revision))
+    {
+        cached_plan = std::make_shared<const EncodingPlan>(message, config, config_revision, base_topic_);
+    }
+    return cached_plan;
+}
+
+boost::shared_ptr<draco::PointCloud> DracoPublisher::convert(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const Config& config,
+                                                            uint32_t first_point, uint32_t number_of_points) const
+{
+    // buffer for quantized values recycled between frames
+    boost::shared_ptr<std::vector<uint8_t> > quantization_buffer = quantization_buffer_pool_->acquire();
+
+    PC2toDraco converter(message, plan);
+    converter.set_point_range(first_point, number_of_points);
+    converter.set_quantization_buffer(*quantization_buffer);
+
+    // points keep the order of the index map only if they are encoded sequentially
+    const bool sequential = (config.encode_method == 2) && !config.force_quantization;
+    if (config.deduplicate && config.deduplicate_point_map && !sequential)
+    {
+        ROS_WARN_STREAM_ONCE("Deduplication point map of " << base_topic_ << " requires sequential encoding without quantization, it is not sent.");
+    }
+    converter.set_deduplication(config.deduplicate_tolerance, config.deduplicate_attributes, config.deduplicate_point_map && sequential);
+
+    // point clouds are recycled, attributes keep their allocated storage between frames
+    boost::shared_ptr<std::unique_ptr<draco::PointCloud> > recycled_pc = point_cloud_pool_->acquire();
+    if (!converter.convert(config.deduplicate, *recycled_pc))
+    {
+        return nullptr;
+    }
+    return boost::shared_ptr<draco::PointCloud>(recycled_pc, recycled_pc->get());
+}
+
+DracoPublisher::Config DracoPublisher::integerConfig(const Config& config)
+{
+    Config integer_config = config;
+    integer_config.encode_method = 2;
+    integer_config.force_quantization = false;
+    integer_config.expert_quantization = false;
+    return integer_config;
+}
+
+DracoPublisher::Config DracoPublisher::tierConfig(const Config& config, int quantization_POSITION, int encode_speed, int decode_speed)
 {
-  // Compressed message
-    draco_point_cloud_transport::CompressedPointCloud2 compressed;
+    // tiers differ in encoder settings only, conversion does not depend on them
+    Config tier_config = config;
+    tier_config.force_quantization = true;
+    tier_config.prequantize = false;
+    tier_config.expert_quantization = false;
+    tier_config.lossless = false;
+    tier_config.temporal_mode = false;
+    tier_config.range_image = false;
+    tier_config.attribute_streams = false;
+    tier_config.tiles = 1;
+    tier_config.chunk_points = 0;
+    tier_config.quantization_POSITION = quantization_POSITION;
+    tier_config.encode_speed = encode_speed;
+    tier_config.decode_speed = decode_speed;
+    return tier_config;
+}
+
+bool DracoPublisher::sharesConversion(const Config& config)
+{
+    // quantized by encoder into one draco point cloud, like the tiers
+    return config.force_quantization && !(config.prequantize || config.lossless || config.temporal_mode || config.range_image ||
+                                          config.attribute_streams || (config.tiles > 1) || (config.chunk_points > 0));
+}
 
+void DracoPublisher::initializeCompressed(draco_point_cloud_transport::CompressedPointCloud2& compressed, const sensor_msgs::PointCloud2& message)
+{
     assign_description_of_PointCloud2(compressed, message);
+    compressed.chunk_offsets.clear();
+    compressed.attribute_streams = false;
+    compressed.frame_type = draco_point_cloud_transport::CompressedPointCloud2::INTRA_FRAME;
+    compressed.frame_sequence = 0;
+    compressed.chunk_frame = 0;
+    compressed.chunk_index = 0;
+    compressed.chunk_count = 0;
+    compressed.chunk_first_point = 0;
+    compressed.cloud_height = message.height;
+    compressed.cloud_width = message.width;
+}
+
+void DracoPublisher::assignEncoderSettings(draco_point_cloud_transport::CompressedPointCloud2& compressed, const Config& config)
+{
+    compressed.encode_speed = config.encode_speed;
+    compressed.decode_speed = config.decode_speed;
+    compressed.quantization_bits.clear();
+    if ((config.force_quantization || config.range_image || config.temporal_mode) && !config.lossless)
+    {
+        compressed.quantization_bits = {uint8_t(config.quantization_POSITION), uint8_t(config.quantization_NORMAL), uint8_t(config.quantization_COLOR),
+                                        uint8_t(config.quantization_TEX_COORD), uint8_t(config.quantization_GENERIC)};
+    }
+}
+
+void DracoPublisher::encodeTiers(const sensor_msgs::PointCloud2& message, const Config& config, uint32_t config_revision,
+                                 const std::vector<std::pair<const QualityTier*, Config> >& tiers, const PublishFn* main_publish_fn,
+                                 size_t& main_bytes, size_t& tier_bytes, MessageStatistics& statistics) const
+{
+    main_bytes = 0;
+    tier_bytes = 0;
+
+    // one encoding per topic, main topic first
+    struct TierEncoding
+    {
+        const QualityTier* tier;
+        Config config;
+        std::shared_ptr<const EncodingPlan> plan;
+        boost::shared_ptr<draco_point_cloud_transport::CompressedPointCloud2> compressed;
+    };
+    std::vector<TierEncoding> encodings;
+    if (main_publish_fn != nullptr)
+    {
+        encodings.push_back({nullptr, config, encodingPlan(message, config, config_revision), nullptr});
+    }
+    for (const std::pair<const QualityTier*, Config>& tier : tiers)
+    {
+        encodings.push_back({tier.first, tier.second, encodingPlan(message, tier.second, config_revision, tier.first->plan), nullptr});
+    }
+
+    // conversion shared by all tiers
+    const uint32_t number_of_points = message.height * message.width;
+    const boost::shared_ptr<draco::PointCloud> pc = convert(message, *encodings.front().plan, encodings.front().config, 0, number_of_points);
+    statistics.convert_seconds += statistics.timer.lap();
+    if (pc == nullptr)
+    {
+        if (statistics_ != nullptr)
+        {
+            statistics_->add_failure();
+        }
+        return;
+    }
+    const draco::PointCloud& shared_pc = *pc;
+
+    const std::shared_ptr<ThreadPool> pool = encodePool(config.encoding_threads);
+
+    // tiers are encoded in parallel from the same draco point cloud
+    std::vector<std::future<bool> > results;
+    for (TierEncoding& encoding : encodings)
+    {
+        // messages are recycled, compressed_data keeps its allocated storage between frames
+        encoding.compressed = message_pool_->acquire();
+        initializeCompressed(*encoding.compressed, message);
+        assignEncoderSettings(*encoding.compressed, encoding.config);
+
+        TierEncoding* tier_encoding = &encoding;
+        results.push_back(pool->submit([this, &shared_pc, tier_encoding]()
+        {
+            boost::shared_ptr<draco::EncoderBuffer> encode_buffer = encode_buffer_pool_->acquire();
+            encode_buffer->Clear();
+            if (!encode(shared_pc, *tier_encoding->plan, tier_encoding->config, *encode_buffer))
+            {
+                return false;
+            }
+            // draco::EncoderBuffer stores char, message uint8
+            const unsigned char* cast_buffer = reinterpret_cast<const unsigned char*>(encode_buffer->data());
+            tier_encoding->compressed->compressed_data.assign(cast_buffer, cast_buffer + encode_buffer->size());
+            return true;
+        }));
+    }
+
+    std::vector<uint8_t> encoded(encodings.size(), 0);
+    for (size_t index = 0; index < encodings.size(); index++)
+    {
+        encoded[index] = results[index].get();
+    }
+    statistics.encode_seconds += statistics.timer.lap();
 
-    PC2toDraco converter(message, base_topic_);
-    std::unique_ptr<draco::PointCloud> pc = converter.convert(config_.deduplicate, config_.expert_attribute_types);
-    draco::EncoderBuffer encode_buffer;
+    for (size_t index = 0; index < encodings.size(); index++)
+    {
+        const TierEncoding& encoding = encodings[index];
+        if (!encoded[index])
+        {
+            if (statistics_ != nullptr)
+            {
+                statistics_->add_failure();
+            }
+            continue;
+        }
+        statistics.encoded_points += shared_pc.num_points();
+        if (encoding.tier == nullptr)
+        {
+            (*main_publish_fn)(*encoding.compressed);
+            main_bytes += encoding.compressed->compressed_data.size();
+        }
+        else
+        {
+            tierPublisher(*encoding.tier).publish(*encoding.compressed);
+            tier_bytes += encoding.compressed->compressed_data.size();
+        }
+    }
+    statistics.publish_seconds += statistics.timer.lap();
+}
 
+bool DracoPublisher::encode(const draco::PointCloud& pc, const EncodingPlan& plan, const Config& config,
+                            draco::EncoderBuffer& encode_buffer) const
+{
     // tracks if all necessary parameters were set for expert encoder
-    bool expert_settings_ok = true;
+    bool expert_settings_ok = (!config.force_quantization) || plan.expert_quantization_ok();
 
     // expert encoder
-    if (config_.expert_quantization) {
+    if (config.expert_quantization && expert_settings_ok) {
 
-        draco::ExpertEncoder expert_encoder(*pc);
-        expert_encoder.SetSpeedOptions(config_.encode_speed, config_.decode_speed);
+        draco::ExpertEncoder expert_encoder(pc);
+        expert_encoder.SetSpeedOptions(config.encode_speed, config.decode_speed);
 
         // default
-        if((config_.encode_method==0) && (!config_.force_quantization))
+        if((config.encode_method==0) && (!config.force_quantization))
         {
             // let draco handle method selection
         }
             // force kd tree
-        else if ((config_.encode_method==1) || (config_.force_quantization))
+        else if ((config.encode_method==1) || (config.force_quantization))
         {
-            if(config_.force_quantization)
+            if(config.force_quantization)
             {
-                // keep track of which attribute is being processed
-                int att_id = 0;
-                int attribute_quantization_bits;
-
-                for (sensor_msgs::PointField field : message.fields)
+                // quantization bits were resolved per field by encoding plan
+                for (const FieldEncoding& encoding : plan.fields())
                 {
-                    if (ros::param::getCached(base_topic_ + "/draco/attribute_mapping/quantization_bits/" + field.name, attribute_quantization_bits))
+                    if (EncodingPlan::adds_attribute(encoding))
                     {
-                        expert_encoder.SetAttributeQuantization(att_id, attribute_quantization_bits);
+                        expert_encoder.SetAttributeQuantization(encoding.attribute_id, encoding.expert_quantization_bits);
                     }
-                    else
-                    {
-                        ROS_ERROR_STREAM ("Attribute quantization not specified for " + field.name + " field entry. Using regular encoder instead.");
-                        ROS_INFO_STREAM ("To set quantization for " + field.name + " field entry, set " + base_topic_ + "/draco/attribute_mapping/quantization_bits/" + field.name);
-                        expert_settings_ok = false;
-                    }
-                    att_id++;
                 }
 
             }
@@ -94,37 +356,38 @@ void DracoPublisher::publish(const sensor_msgs::PointCloud2& message, const Publ
         }
 
         // encodes point cloud and raises error if encoding fails
-        //draco::Status status = encoder.EncodePointCloudToBuffer(*pc, &encode_buffer);
+        //draco::Status status = encoder.EncodePointCloudToBuffer(pc, &encode_buffer);
         draco::Status status = expert_encoder.EncodeToBuffer(&encode_buffer);
 
         if (status.code() != 0)
         {
             ROS_ERROR_STREAM (status);
+            return false;
         }
     }
     // expert encoder end
 
     // regular encoder
-    if ((!config_.expert_quantization) || (!expert_settings_ok))
+    if ((!config.expert_quantization) || (!expert_settings_ok))
     {
         draco::Encoder encoder;
-        encoder.SetSpeedOptions(config_.encode_speed, config_.decode_speed);
+        encoder.SetSpeedOptions(config.encode_speed, config.decode_speed);
 
         // default
-        if((config_.encode_method==0) && (!config_.force_quantization))
+        if((config.encode_method==0) && (!config.force_quantization))
         {
             // let draco handle method selection
         }
             // force kd tree
-        else if ((config_.encode_method==1) || (config_.force_quantization))
+        else if ((config.encode_method==1) || (config.force_quantization))
         {
-            if(config_.force_quantization)
+            if(config.force_quantization)
             {
-                encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, config_.quantization_POSITION);
-                encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL, config_.quantization_NORMAL);
-                encoder.SetAttributeQuantization(draco::GeometryAttribute::COLOR, config_.quantization_COLOR);
-                encoder.SetAttributeQuantization(draco::GeometryAttribute::TEX_COORD, config_.quantization_TEX_COORD);
-                encoder.SetAttributeQuantization(draco::GeometryAttribute::GENERIC, config_.quantization_GENERIC);
+                encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, config.quantization_POSITION);
+                encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL, config.quantization_NORMAL);
+                encoder.SetAttributeQuantization(draco::GeometryAttribute::COLOR, config.quantization_COLOR);
+                encoder.SetAttributeQuantization(draco::GeometryAttribute::TEX_COORD, config.quantization_TEX_COORD);
+                encoder.SetAttributeQuantization(draco::GeometryAttribute::GENERIC, config.quantization_GENERIC);
             }
             encoder.SetEncodingMethod(draco::POINT_CLOUD_KD_TREE_ENCODING);
         }
@@ -134,22 +397,550 @@ void DracoPublisher::publish(const sensor_msgs::PointCloud2& message, const Publ
         }
 
         // encodes point cloud and raises error if encoding fails
-        //draco::Status status = encoder.EncodePointCloudToBuffer(*pc, &encode_buffer);
-        draco::Status status = encoder.EncodePointCloudToBuffer(*pc, &encode_buffer);
+        //draco::Status status = encoder.EncodePointCloudToBuffer(pc, &encode_buffer);
+        draco::Status status = encoder.EncodePointCloudToBuffer(pc, &encode_buffer);
 
         if (status.code() != 0)
         {
             ROS_ERROR_STREAM (status);
+            return false;
         }
     }
     // regular encoder end
 
-    uint32_t compressed_data_size = encode_buffer.size();
-    unsigned char* cast_buffer = (unsigned char*)encode_buffer.data();
-    std::vector <unsigned char> vec_data(cast_buffer, cast_buffer + compressed_data_size);
-    compressed.compressed_data = vec_data;
+    return true;
+}
+
+bool DracoPublisher::encodeTiles(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const Config& config,
+                                 draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const
+{
+    const uint32_t number_of_points = message.height * message.width;
+
+    // organized clouds are split along rows (rings of spinning lidars), others into ranges of consecutive points
+    const uint32_t rows = (message.height > 1) ? message.height : number_of_points;
+    const uint32_t points_per_row = (message.height > 1) ? message.width : 1;
+    const uint32_t number_of_tiles = std::min<uint32_t>(config.tiles, rows);
+    const uint32_t rows_per_tile = (rows + number_of_tiles - 1) / number_of_tiles;
+
+    const std::shared_ptr<ThreadPool> pool = encodePool(config.encoding_threads);
+
+    // each tile is converted and encoded independently
+    std::vector<std::future<bool> > results;
+    std::vector<boost::shared_ptr<draco::EncoderBuffer> > tile_buffers;
+    // points of each tile after deduplication, written by its own task only
+    std::vector<uint32_t> tile_points(number_of_tiles, 0);
+    for (uint32_t tile = 0; tile < number_of_tiles; tile++)
+    {
+        const uint32_t first_row = tile * rows_per_tile;
+        const uint32_t tile_rows = std::min(rows_per_tile, rows - std::min(rows, first_row));
+
+        // encoder buffers are recycled between frames
+        tile_buffers.push_back(encode_buffer_pool_->acquire());
+        tile_buffers.back()->Clear();
+        draco::EncoderBuffer* tile_buffer = tile_buffers.back().get();
+
+        uint32_t* encoded_points = &tile_points[tile];
+
+        results.push_back(pool->submit([this, &message, &plan, &config, first_row, tile_rows, points_per_row, tile_buffer, encoded_points]()
+        {
+            const boost::shared_ptr<draco::PointCloud> pc = convert(message, plan, config, first_row * points_per_row, tile_rows * points_per_row);
+            if (pc == nullptr)
+            {
+                return false;
+            }
+            *encoded_points = pc->num_points();
+            return encode(*pc, plan, config, *tile_buffer);
+        }));
+    }
+
+    bool tiles_ok = true;
+    for (std::future<bool>& result : results)
+    {
+        tiles_ok = result.get() && tiles_ok;
+    }
+    // tiles are converted and encoded together
+    statistics.encode_seconds += statistics.timer.lap();
+    for (uint32_t encoded_points : tile_points)
+    {
+        statistics.encoded_points += encoded_points;
+    }
+    if (!tiles_ok)
+    {
+        return false;
+    }
+
+    // pack tiles into one message
+    packChunks(tile_buffers, compressed);
+    statistics.serialize_seconds += statistics.timer.lap();
+    return true;
+}
+
+bool DracoPublisher::encodeStreams(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const Config& config,
+                                   draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const
+{
+    const uint32_t number_of_points = message.height * message.width;
+    const int number_of_streams = plan.number_of_attributes();
+
+    // points of all streams stay in order of message, sequential encoding of integer and prequantized attributes
+    Config stream_config = integerConfig(config);
+    stream_config.deduplicate = false;
+
+    const std::shared_ptr<ThreadPool> pool = encodePool(config.encoding_threads);
+
+    // each attribute is converted and encoded independently
+    std::vector<std::future<bool> > results;
+    std::vector<boost::shared_ptr<draco::EncoderBuffer> > stream_buffers;
+    for (int stream = 0; stream < number_of_streams; stream++)
+    {
+        // encoder buffers are recycled between frames
+        stream_buffers.push_back(encode_buffer_pool_->acquire());
+        stream_buffers.back()->Clear();
+        draco::EncoderBuffer* stream_buffer = stream_buffers.back().get();
+
+        results.push_back(pool->submit([this, &message, &plan, &stream_config, number_of_points, stream, stream_buffer]()
+        {
+            // buffer for quantized values recycled between frames
+            boost::shared_ptr<std::vector<uint8_t> > quantization_buffer = quantization_buffer_pool_->acquire();
+
+            PC2toDraco converter(message, plan);
+            converter.set_attribute_range(stream, 1);
+            converter.set_quantization_buffer(*quantization_buffer);
+            // point clouds are recycled, attributes keep their allocated storage between frames
+            boost::shared_ptr<std::unique_ptr<draco::PointCloud> > recycled_pc = point_cloud_pool_->acquire();
+            return converter.convert(false, *recycled_pc) && encode(**recycled_pc, plan, stream_config, *stream_buffer);
+        }));
+    }
+
+    bool streams_ok = true;
+    for (std::future<bool>& result : results)
+    {
+        streams_ok = result.get() && streams_ok;
+    }
+    // streams are converted and encoded together
+    statistics.encode_seconds += statistics.timer.lap();
+    statistics.encoded_points += number_of_points;
+    if (!streams_ok)
+    {
+        return false;
+    }
+
+    packChunks(stream_buffers, compressed);
+    compressed.attribute_streams = true;
+    statistics.serialize_seconds += statistics.timer.lap();
+    return true;
+}
+
+void DracoPublisher::packChunks(const std::vector<boost::shared_ptr<draco::EncoderBuffer> >& chunk_buffers,
+                                draco_point_cloud_transport::CompressedPointCloud2& compressed)
+{
+    // chunk_offsets index start of each chunk in compressed_data
+    size_t compressed_data_size = 0;
+    for (const boost::shared_ptr<draco::EncoderBuffer>& chunk_buffer : chunk_buffers)
+    {
+        compressed_data_size += chunk_buffer->size();
+    }
+    compressed.compressed_data.resize(compressed_data_size);
+    compressed.chunk_offsets.clear();
+
+    size_t offset = 0;
+    for (const boost::shared_ptr<draco::EncoderBuffer>& chunk_buffer : chunk_buffers)
+    {
+        compressed.chunk_offsets.push_back(offset);
+        std::memcpy(compressed.compressed_data.data() + offset, chunk_buffer->data(), chunk_buffer->size());
+        offset += chunk_buffer->size();
+    }
+}
+
+std::shared_ptr<ThreadPool> DracoPublisher::encodePool(int number_of_threads) const
+{
+    std::lock_guard<std::mutex> lock(encode_pool_mutex_);
+    if ((encode_pool_ == nullptr) || (encode_pool_threads_ != number_of_threads))
+    {
+        encode_pool_ = std::make_shared<ThreadPool>(number_of_threads);
+        encode_pool_threads_ = number_of_threads;
+    }
+    return encode_pool_;
+}
+
+void DracoPublisher::publish(const sensor_msgs::PointCloud2& message, const PublishFn& publish_fn) const
+{
+    // configuration used for the whole message, config_ may be changed by reconfigure server or rate control meanwhile
+    Config config;
+    uint32_t config_revision;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        config = config_;
+        config_revision = config_revision_;
+    }
+
+    // synchronous mode, encode in caller thread
+    if (config.async_queue_size == 0)
+    {
+        encodeAndPublish(message, config, config_revision, publish_fn);
+        return;
+    }
+
+    // message is only borrowed by the caller, the queue keeps its own copy
+    QueuedMessage queued_message;
+    queued_message.message = boost::make_shared<sensor_msgs::PointCloud2>(message);
+    queued_message.config = config;
+    queued_message.config_revision = config_revision;
+    queued_message.publish_fn = publish_fn;
+
+    uint64_t dropped_frames = 0;
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        const uint64_t encoder_generation = encoder_generation_;
+        if (config.async_drop_policy == DracoPublisher_Block)
+        {
+            // a stop while waiting is noticed even if the flag was already reset
+            queue_condition_.wait(lock, [this, &config, encoder_generation]()
+            {
+                return stop_encoder_thread_ || (encoder_generation_ != encoder_generation) ||
+                       (queue_.size() < size_t(config.async_queue_size));
+            });
+        }
+        else
+        {
+            while (queue_.size() >= size_t(config.async_queue_size))
+            {
+                queue_.pop_front();
+                dropped_frames++;
+                dropped_frames_++;
+                ROS_WARN_STREAM_THROTTLE(1.0, "Draco encoder queue of " << base_topic_ << " is full, dropped " << dropped_frames_ << " frames so far.");
+            }
+        }
+        // messages published across a stop are dropped, otherwise the encoder thread is started with the same lock held, so a
+        // concurrent stop can not leave a queued message without thread
+        if (!stop_encoder_thread_ && (encoder_generation_ == encoder_generation))
+        {
+            queue_.push_back(std::move(queued_message));
+            startEncoderThread();
+        }
+    }
+    if ((dropped_frames > 0) && (config.statistics_period > 0.0) && (statistics_ != nullptr))
+    {
+        statistics_->add(DROPPED_FRAMES, dropped_frames);
+    }
+    queue_condition_.notify_all();
+}
+
+void DracoPublisher::startEncoderThread() const
+{
+    if (!encoder_thread_.joinable() && !stop_encoder_thread_)
+    {
+        encoder_thread_ = std::thread(&DracoPublisher::encoderThread, this);
+    }
+}
+
+void DracoPublisher::stopEncoderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stop_encoder_thread_ = true;
+        encoder_generation_++;
+        queue_.clear();
+    }
+    queue_condition_.notify_all();
+    if (encoder_thread_.joinable())
+    {
+        encoder_thread_.join();
+    }
+    // thread is started again by the next asynchronously published message, e.g. after advertising again
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stop_encoder_thread_ = false;
+}
+
+void DracoPublisher::encoderThread() const
+{
+    while (true)
+    {
+        QueuedMessage queued_message;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_condition_.wait(lock, [this]() { return stop_encoder_thread_ || !queue_.empty(); });
+            if (stop_encoder_thread_)
+            {
+                return;
+            }
+            queued_message = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        // wakes up publish() waiting for free space in queue
+        queue_condition_.notify_all();
+
+        // messages are encoded one after another, which keeps their order
+        encodeAndPublish(*queued_message.message, queued_message.config, queued_message.config_revision, queued_message.publish_fn);
+    }
+}
+
+uint64_t DracoPublisher::getDroppedFrames() const
+{
+    return dropped_frames_;
+}
+
+void DracoPublisher::shutdown()
+{
+    stopEncoderThread();
+    if (statistics_ != nullptr)
+    {
+        statistics_->shutdown();
+    }
+    {
+        std::lock_guard<std::mutex> lock(tiers_mutex_);
+        tiers_advertisable_ = false;
+    }
+    updateQualityTiers(false);
+    point_cloud_transport::SimplePublisherPlugin<draco_point_cloud_transport::CompressedPointCloud2>::shutdown();
+}
+
+void DracoPublisher::encodeAndPublish(const sensor_msgs::PointCloud2& input, const Config& config, uint32_t config_revision,
+                                      const PublishFn& publish_fn) const
+{
+    const std::chrono::steady_clock::time_point encode_start = std::chrono::steady_clock::now();
+
+    // instrumentation reads no clocks and counters when statistics are disabled
+    const bool statistics_enabled = (config.statistics_period > 0.0) && (statistics_ != nullptr);
+    const size_t allocations = statistics_enabled ? poolAllocations() : 0;
+    MessageStatistics statistics(statistics_enabled);
+
+    // points outside region of interest never reach conversion and encoder, filtering is counted as conversion
+    const RegionFilter region(config);
+    boost::shared_ptr<sensor_msgs::PointCloud2> region_message;
+    if (region.active())
+    {
+        region_message = region_message_pool_->acquire();
+        if (!region.apply(input, *region_message))
+        {
+            ROS_WARN_STREAM_ONCE("Region of interest of " << base_topic_ << " requires float32 x, y, z fields, clouds are sent unfiltered.");
+            region_message.reset();
+        }
+    }
+    const sensor_msgs::PointCloud2& message = (region_message != nullptr) ? *region_message : input;
+
+    // quality tiers with subscribers, main topic joins their conversion if its encoding allows it
+    typedef point_cloud_transport::SimplePublisherPlugin<draco_point_cloud_transport::CompressedPointCloud2> Base;
+    std::vector<std::pair<const QualityTier*, Config> > tiers;
+    if (tierPublisher(low_tier_).getNumSubscribers() > 0)
+    {
+        tiers.emplace_back(&low_tier_, tierConfig(config, config.low_quantization_POSITION, config.low_encode_speed, config.low_decode_speed));
+    }
+    if (tierPublisher(high_tier_).getNumSubscribers() > 0)
+    {
+        tiers.emplace_back(&high_tier_, tierConfig(config, config.high_quantization_POSITION, config.high_encode_speed, config.high_decode_speed));
+    }
+    const bool main_subscribed = tiers.empty() || (Base::getNumSubscribers() > 0);
+    const bool main_shares_conversion = main_subscribed && (!tiers.empty()) && sharesConversion(config);
+
+    size_t compressed_bytes = 0;
+    size_t tier_bytes = 0;
+    if (!tiers.empty())
+    {
+        encodeTiers(message, config, config_revision, tiers, main_shares_conversion ? &publish_fn : nullptr, compressed_bytes, tier_bytes,
+                    statistics);
+    }
+
+    // large clouds are sent as independently decodable chunks, each published as soon as it is encoded
+    const uint32_t number_of_points = message.height * message.width;
+    const bool progressive = (config.chunk_points > 0) && (number_of_points > uint32_t(config.chunk_points)) &&
+                             !(config.lossless || config.temporal_mode || config.range_image);
+    // organized clouds are split along rows, others into ranges of consecutive points
+    const uint32_t rows = (message.height > 1) ? message.height : number_of_points;
+    const uint32_t points_per_row = (message.height > 1) ? message.width : 1;
+    const uint32_t rows_per_chunk = progressive ? std::max<uint32_t>(1, config.chunk_points / points_per_row) : rows;
+    // main topic encoded on its own unless it shared conversion with quality tiers
+    const uint32_t number_of_chunks = (main_subscribed && !main_shares_conversion) ?
+                                      (progressive ? (rows + rows_per_chunk - 1) / rows_per_chunk : 1) : 0;
+    const uint32_t chunk_frame = (progressive && (number_of_chunks > 0)) ? ++chunk_frame_ : 0;
+
+    for (uint32_t chunk = 0; chunk < number_of_chunks; chunk++)
+    {
+        // Compressed message
+        // messages are recycled, compressed_data keeps its allocated storage between frames
+        boost::shared_ptr<draco_point_cloud_transport::CompressedPointCloud2> compressed_ptr = message_pool_->acquire();
+        draco_point_cloud_transport::CompressedPointCloud2& compressed = *compressed_ptr;
+
+        initializeCompressed(compressed, message);
+        compressed.chunk_frame = chunk_frame;
+
+        bool encoded = false;
+        if (progressive)
+        {
+            // chunk is described as a point cloud of its own
+            const uint32_t first_row = chunk * rows_per_chunk;
+            const uint32_t chunk_rows = std::min(rows_per_chunk, rows - first_row);
+            compressed.chunk_index = chunk;
+            compressed.chunk_count = number_of_chunks;
+            compressed.chunk_first_point = first_row * points_per_row;
+            compressed.height = (message.height > 1) ? chunk_rows : 1;
+            compressed.width = (message.height > 1) ? message.width : chunk_rows;
+            compressed.row_step = compressed.width * message.point_step;
+
+            const std::shared_ptr<const EncodingPlan> plan = encodingPlan(message, config, config_revision);
+            const boost::shared_ptr<draco::PointCloud> pc = convert(message, *plan, config, compressed.chunk_first_point, chunk_rows * points_per_row);
+            statistics.convert_seconds += statistics.timer.lap();
+            encoded = (pc != nullptr) && encodeInto(*pc, *plan, config, compressed, statistics);
+        }
+        else
+        {
+            encoded = encodeMessage(message, config, config_revision, compressed, statistics);
+        }
+
+        if (!encoded)
+        {
+            if (statistics_enabled)
+            {
+                statistics_->add_failure();
+            }
+            return;
+        }
+
+        // settings used for this message
+        assignEncoderSettings(compressed, config);
+
+        statistics.timer.lap();
+        publish_fn(compressed);
+        statistics.publish_seconds += statistics.timer.lap();
+        compressed_bytes += compressed.compressed_data.size();
+    }
+
+    const double encode_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count();
+
+    if (statistics_enabled)
+    {
+        const double input_bytes = input.data.size();
+        const double output_bytes = compressed_bytes + tier_bytes;
+        statistics_->add(CONVERT_TIME, statistics.convert_seconds);
+        statistics_->add(ENCODE_TIME, statistics.encode_seconds);
+        statistics_->add(SERIALIZE_TIME, statistics.serialize_seconds);
+        statistics_->add(PUBLISH_TIME, statistics.publish_seconds);
+        statistics_->add(INPUT_BYTES, input_bytes);
+        statistics_->add(OUTPUT_BYTES, output_bytes);
+        statistics_->add(COMPRESSION_RATIO, (output_bytes > 0.0) ? input_bytes / output_bytes : 0.0);
+        statistics_->add(INPUT_POINTS, double(input.height) * input.width);
+        statistics_->add(ENCODED_POINTS, statistics.encoded_points);
+        statistics_->add(ALLOCATIONS, poolAllocations() - allocations);
+    }
+
+    // rate control adjusts settings of the main topic, frames encoded only for quality tiers do not measure them
+    const bool main_encoded = main_shares_conversion ? (compressed_bytes > 0) : (number_of_chunks > 0);
+    if (main_encoded)
+    {
+        updateRateControl(config, compressed_bytes, encode_seconds);
+    }
+}
+
+size_t DracoPublisher::poolAllocations() const
+{
+    return message_pool_->allocations() + encode_buffer_pool_->allocations() + quantization_buffer_pool_->allocations() +
+           point_cloud_pool_->allocations() + region_message_pool_->allocations();
+}
+
+bool DracoPublisher::encodeMessage(const sensor_msgs::PointCloud2& message, const Config& config, uint32_t config_revision,
+                                   draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const
+{
+    // encoding of fields, resolved only when field layout or configuration changes
+    const std::shared_ptr<const EncodingPlan> plan = encodingPlan(message, config, config_revision);
+
+    // all bytes restored by subscriber, integer attributes only
+    if (config.lossless)
+    {
+        PC2toLossless converter(message);
+        std::unique_ptr<draco::PointCloud> pc = converter.convert();
+        statistics.convert_seconds += statistics.timer.lap();
+        // sequential encoding keeps order of points
+        return (pc != nullptr) && encodeInto(*pc, *plan, integerConfig(config), compressed, statistics);
+    }
+
+    // key and delta frames referencing previous frame
+    if (config.temporal_mode)
+    {
+        std::lock_guard<std::mutex> lock(temporal_mutex_);
+        std::unique_ptr<draco::PointCloud> pc = temporal_encoder_.convert(message, *plan, config, config_revision, compressed);
+        statistics.convert_seconds += statistics.timer.lap();
+        if (pc != nullptr)
+        {
+            // sequential encoding keeps points aligned with reference frame
+            if (encodeInto(*pc, *plan, integerConfig(config), compressed, statistics))
+            {
+                return true;
+            }
+            // subscribers miss this frame, the next one must not reference it
+            temporal_encoder_.reset();
+            return false;
+        }
+        // fields which can not be coded temporally are sent as independent frames
+        compressed.frame_type = draco_point_cloud_transport::CompressedPointCloud2::INTRA_FRAME;
+        compressed.frame_sequence = 0;
+    }
+
+    // organized point cloud as range image
+    if (config.range_image && PC2toRangeImage::compatible(message))
+    {
+        PC2toRangeImage converter(message, *plan);
+        std::unique_ptr<draco::PointCloud> pc = converter.convert(config.quantization_POSITION);
+        statistics.convert_seconds += statistics.timer.lap();
+        // sequential encoding keeps valid points in order of validity bitmap
+        return (pc != nullptr) && encodeInto(*pc, *plan, integerConfig(config), compressed, statistics);
+    }
+
+    // attributes encoded as independent streams in parallel
+    if (config.attribute_streams && (plan->number_of_attributes() > 1))
+    {
+        return encodeStreams(message, *plan, config, compressed, statistics);
+    }
+
+    // tiled encoding in parallel
+    if ((config.tiles > 1) && (message.height * message.width > 1))
+    {
+        return encodeTiles(message, *plan, config, compressed, statistics);
+    }
+
+    const boost::shared_ptr<draco::PointCloud> pc = convert(message, *plan, config, 0, message.height * message.width);
+    statistics.convert_seconds += statistics.timer.lap();
+    return (pc != nullptr) && encodeInto(*pc, *plan, config, compressed, statistics);
+}
+
+void DracoPublisher::updateRateControl(const Config& config, size_t compressed_bytes, double encode_seconds) const
+{
+    if ((config.target_bandwidth <= 0.0) && (config.max_encode_latency <= 0.0))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (!rate_controller_.update(base_config_, compressed_bytes, encode_seconds, std::chrono::steady_clock::now()))
+    {
+        return;
+    }
+
+    // chosen settings are used from next published message
+    config_ = base_config_;
+    rate_controller_.apply(config_);
+    config_revision_++;
+    ROS_INFO_STREAM("Draco rate control of " << base_topic_ << " set encode_speed " << config_.encode_speed
+                    << ", quantization_POSITION " << config_.quantization_POSITION << " bits.");
+}
+
+bool DracoPublisher::encodeInto(const draco::PointCloud& pc, const EncodingPlan& plan, const Config& config,
+                                draco_point_cloud_transport::CompressedPointCloud2& compressed, MessageStatistics& statistics) const
+{
+    boost::shared_ptr<draco::EncoderBuffer> encode_buffer_ptr = encode_buffer_pool_->acquire();
+    draco::EncoderBuffer& encode_buffer = *encode_buffer_ptr;
+    encode_buffer.Clear();
+    const bool encoded = encode(pc, plan, config, encode_buffer);
+    statistics.encode_seconds += statistics.timer.lap();
+    statistics.encoded_points += pc.num_points();
+    if (!encoded)
+    {
+        return false;
+    }
 
-    publish_fn(compressed);
+    // single copy of encoded data into recycled message, draco::EncoderBuffer stores char, message uint8
+    const unsigned char* cast_buffer = reinterpret_cast<const unsigned char*>(encode_buffer.data());
+    compressed.compressed_data.assign(cast_buffer, cast_buffer + encode_buffer.size());
+    statistics.serialize_seconds += statistics.timer.lap();
+    return true;
 }
 
 } //namespace draco_point_cloud_transport
@@ -2,98 +2,863 @@
 
 #include "draco_point_cloud_transport/draco_common.h"
 #include "draco_point_cloud_transport/DracotoPC2.h"
+#include "draco_point_cloud_transport/field_layout.h"
 #include "draco_point_cloud_transport/conversion_utilities.h"
+#include "draco_point_cloud_transport/lossless.h"
+#include "draco_point_cloud_transport/range_image.h"
 
 #include "draco/compression/decode.h"
 
+#include <algorithm>
+#include <future>
 #include <limits>
+#include <sstream>
+#include <string>
 #include <vector>
 
 namespace draco_point_cloud_transport
 {
 
+namespace
+{
+
+//! splits comma separated list of field names
+std::vector<std::string> parse_field_names(const std::string& fields)
+{
+    std::vector<std::string> field_names;
+    std::stringstream stream(fields);
+    std::string field_name;
+    while (std::getline(stream, field_name, ','))
+    {
+        // strip whitespace around names
+        const size_t begin = field_name.find_first_not_of(" \t");
+        const size_t end = field_name.find_last_not_of(" \t");
+        if (begin != std::string::npos)
+        {
+            field_names.push_back(field_name.substr(begin, end - begin + 1));
+        }
+    }
+    return field_names;
+}
+
+//! fields have the same names, offsets, datatypes and counts
+bool same_field_types(const std::vector<sensor_msgs::PointField>& fields, const std::vector<sensor_msgs::PointField>& other_fields)
+{
+    if (fields.size() != other_fields.size())
+    {
+        return false;
+    }
+    for (size_t field_index = 0; field_index < fields.size(); field_index++)
+    {
+        if ((fields[field_index].name != other_fields[field_index].name) || (fields[field_index].offset != other_fields[field_index].offset) ||
+            (fields[field_index].datatype != other_fields[field_index].datatype) || (fields[field_index].count != other_fields[field_index].count))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
 void DracoSubscriber::subscribeImpl(ros::NodeHandle& nh, const std::string& base_topic, uint32_t queue_size,
                              const Callback& callback, const ros::VoidPtr& tracked_object,
                              const point_cloud_transport::TransportHints& transport_hints)
 {
     typedef point_cloud_transport::SimpleSubscriberPlugin<draco_point_cloud_transport::CompressedPointCloud2> Base;
+    // quality tier decides topic to subscribe
+    transport_hints.getParameterNH().getParam("draco_tier", hint_tier_);
     Base::subscribeImpl(nh, base_topic, queue_size, callback, tracked_object, transport_hints);
 
+    // quantization topic is advertised by reconfiguration while integer fields are delivered
+    {
+        std::lock_guard<std::mutex> lock(quantization_mutex_);
+        quantization_advertisable_ = true;
+    }
+
     // Set up reconfigure server for this topic
     reconfigure_server_ = boost::make_shared<ReconfigureServer>(this->nh());
     ReconfigureServer::CallbackType f = boost::bind(&DracoSubscriber::configCb, this, _1, _2);
     reconfigure_server_->setCallback(f);
+
+    // fields requested through transport hints
+    transport_hints.getParameterNH().getParam("draco_fields", hint_fields_);
+
+    statistics_.reset(new Statistics("subscriber",
+                                     {"decode_time", "scatter_time", "input_bytes", "output_bytes", "compression_ratio", "decoded_points", "allocations",
+                                      "queue_age", "skipped_frames"},
+                                     {"s", "s", "B", "B", "", "", "", "s", ""}));
+    // nh() of subscriber is namespace of transport hint parameters, statistics go next to the topic of the publisher
+    statistics_->advertise(ros::NodeHandle(nh, base_topic + "/" + getTransportName()));
+    double statistics_period;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        statistics_period = config_.statistics_period;
+    }
+    statistics_->set_period(statistics_period);
+}
+
+std::string DracoSubscriber::getTopicToSubscribe(const std::string& base_topic) const
+{
+    std::string topic = base_topic + "/" + getTransportName();
+    if (!hint_tier_.empty())
+    {
+        topic += "/" + hint_tier_;
+    }
+    return topic;
 }
 
 void DracoSubscriber::configCb(Config& config, uint32_t level)
 {
-  config_ = config;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    config_ = config;
+  }
+  message_pool_->set_max_size(config.message_pool_size);
+  updateQuantizationPublisher(config);
+  if (statistics_ != nullptr)
+  {
+    statistics_->set_period(config.statistics_period);
+  }
 }
 
-void DracoSubscriber::shutdown()
+void DracoSubscriber::updateQuantizationPublisher(const Config& config)
 {
-  reconfigure_server_.reset();
-    point_cloud_transport::SimpleSubscriberPlugin<draco_point_cloud_transport::CompressedPointCloud2>::shutdown();
+    const std::vector<bool> skipped = skippedDequantization(config);
+    const bool enabled = std::find(skipped.begin(), skipped.end(), true) != skipped.end();
+
+    std::lock_guard<std::mutex> lock(quantization_mutex_);
+    if (enabled && quantization_advertisable_ && !quantization_publisher_)
+    {
+        // private namespace of subscribing node, other subscribers of the topic publish their own parameters
+        std::string topic = this->getTopic();
+        topic.erase(0, topic.find_first_not_of('/'));
+        quantization_publisher_ = ros::NodeHandle("~").advertise<draco_point_cloud_transport::DracoQuantization>(topic + "/quantization", 1);
+    }
+    else if ((!enabled || !quantization_advertisable_) && quantization_publisher_)
+    {
+        quantization_publisher_.shutdown();
+        quantization_publisher_ = ros::Publisher();
+    }
 }
 
-void DracoSubscriber::internalCallback(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
-                                            const Callback& user_cb)
+ros::Publisher DracoSubscriber::quantizationPublisher() const
+{
+    std::lock_guard<std::mutex> lock(quantization_mutex_);
+    return quantization_publisher_;
+}
 
+void DracoSubscriber::setOutputAllocator(const OutputAllocator& allocator)
 {
-    // get size of buffer with compressed data in Bytes
-    uint32_t compressed_data_size = message->compressed_data.size();
+    std::lock_guard<std::mutex> lock(output_allocator_mutex_);
+    output_allocator_ = allocator;
+}
 
-    // empty buffer
-    if (compressed_data_size==0)
+sensor_msgs::PointCloud2Ptr DracoSubscriber::acquireOutput()
+{
     {
-        return ;
+        std::lock_guard<std::mutex> lock(output_allocator_mutex_);
+        if (output_allocator_)
+        {
+            return output_allocator_();
+        }
     }
+    return message_pool_->acquire();
+}
+
+bool DracoSubscriber::decodeInto(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message, sensor_msgs::PointCloud2& PC2)
+{
+    Config config;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        config = config_;
+    }
+    if (message->compressed_data.empty())
+    {
+        return false;
+    }
+    DecodeStatistics statistics(false);
+    return decodeMessage(message, config, requestedFields(*message, config), statistics, PC2);
+}
+
+std::vector<std::string> DracoSubscriber::requestedFields(const draco_point_cloud_transport::CompressedPointCloud2& message,
+                                                          const Config& config) const
+{
+    // dynamic reconfiguration takes precedence over transport hints
+    std::vector<std::string> field_names = parse_field_names(config.fields.empty() ? hint_fields_ : config.fields);
+
+    // all fields packed without padding, fields which were not encoded are dropped
+    if (field_names.empty() && config.dense_layout)
+    {
+        const FieldLayout layout(message.fields, message.point_step);
+        for (size_t field_index = 0; field_index < message.fields.size(); field_index++)
+        {
+            if (layout.valid(field_index))
+            {
+                field_names.push_back(message.fields[field_index].name);
+            }
+        }
+    }
+    return field_names;
+}
+
+void DracoSubscriber::shutdown()
+{
+  stopFramePool();
+  reconfigure_server_.reset();
+  {
+    std::lock_guard<std::mutex> lock(quantization_mutex_);
+    quantization_advertisable_ = false;
+  }
+  Config config;
+  {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    config = config_;
+  }
+  updateQuantizationPublisher(config);
+  if (statistics_ != nullptr)
+  {
+    statistics_->shutdown();
+  }
+    point_cloud_transport::SimpleSubscriberPlugin<draco_point_cloud_transport::CompressedPointCloud2>::shutdown();
+}
+
+std::vector<bool> DracoSubscriber::skippedDequantization(const Config& config)
+{
+    // order of draco::GeometryAttribute::Type
+    return {config.SkipDequantizationPOSITION, config.SkipDequantizationNORMAL, config.SkipDequantizationCOLOR,
+            config.SkipDequantizationTEX_COORD, config.SkipDequantizationGENERIC};
+}
 
+std::unique_ptr<draco::PointCloud> DracoSubscriber::decode(const unsigned char* data, size_t size, const Config& config) const
+{
     draco::DecoderBuffer decode_buffer;
-    std::vector <unsigned char> vec_data = (message->compressed_data);
 
     // Sets the buffer's internal data. Note that no copy of the input data is
     // made so the data owner needs to keep the data valid and unchanged for
     // runtime of the decoder.
-    decode_buffer.Init(reinterpret_cast<const char *>(&vec_data[0]), compressed_data_size);
+    decode_buffer.Init(reinterpret_cast<const char *>(data), size);
 
     // create decoder object
     draco::Decoder decoder;
     // set decoder from dynamic reconfiguration
-    if(config_.SkipDequantizationPOSITION)
+    if(config.SkipDequantizationPOSITION)
     {
         decoder.SetSkipAttributeTransform(draco::GeometryAttribute::POSITION);
     }
-    if(config_.SkipDequantizationNORMAL)
+    if(config.SkipDequantizationNORMAL)
     {
         decoder.SetSkipAttributeTransform(draco::GeometryAttribute::NORMAL);
     }
-    if(config_.SkipDequantizationCOLOR)
+    if(config.SkipDequantizationCOLOR)
     {
         decoder.SetSkipAttributeTransform(draco::GeometryAttribute::COLOR);
     }
-    if(config_.SkipDequantizationTEX_COORD)
+    if(config.SkipDequantizationTEX_COORD)
     {
         decoder.SetSkipAttributeTransform(draco::GeometryAttribute::TEX_COORD);
     }
-    if(config_.SkipDequantizationGENERIC)
+    if(config.SkipDequantizationGENERIC)
     {
         decoder.SetSkipAttributeTransform(draco::GeometryAttribute::GENERIC);
     }
 
     // decode buffer into draco point cloud
-    std::unique_ptr<draco::PointCloud> decoded_pc =
-            decoder.DecodePointCloudFromBuffer(&decode_buffer).value();
+    draco::StatusOr<std::unique_ptr<draco::PointCloud> > decoded = decoder.DecodePointCloudFromBuffer(&decode_buffer);
+    if (!decoded.ok())
+    {
+        ROS_ERROR_STREAM(decoded.status());
+        return nullptr;
+    }
+    return std::move(decoded).value();
+}
+
+bool DracoSubscriber::decodeTiles(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
+                                  const Config& config, const std::vector<std::string>& field_names,
+                                  DecodeStatistics& statistics, sensor_msgs::PointCloud2& PC2)
+{
+    const size_t number_of_tiles = message->chunk_offsets.size();
+    const size_t compressed_data_size = message->compressed_data.size();
+
+    const std::shared_ptr<ThreadPool> decode_pool = decodePool(config.decoding_threads);
+
+    // decode all tiles in parallel
+    std::vector<std::future<std::unique_ptr<draco::PointCloud> > > decoded_tiles;
+    for (size_t tile = 0; tile < number_of_tiles; tile++)
+    {
+        const size_t begin = message->chunk_offsets[tile];
+        const size_t end = (tile + 1 < number_of_tiles) ? message->chunk_offsets[tile + 1] : compressed_data_size;
+        if ((begin > end) || (end > compressed_data_size))
+        {
+            ROS_ERROR_STREAM("Invalid chunk_offsets in CompressedPointCloud2!");
+            return false;
+        }
+        const unsigned char* tile_data = message->compressed_data.data() + begin;
+
+        decoded_tiles.push_back(decode_pool->submit([this, tile_data, begin, end, &config]()
+        {
+            return decode(tile_data, end - begin, config);
+        }));
+    }
+
+    // attributes of tiles with skipped dequantization are delivered as integer fields, each tile has parameters of its own;
+    // attribute streams hold different fields of one layout, which their converters can not pack consistently
+    const std::vector<bool> skipped = skippedDequantization(config);
+    const bool quantized_output = std::find(skipped.begin(), skipped.end(), true) != skipped.end();
+    if (quantized_output && message->attribute_streams)
+    {
+        ROS_WARN_STREAM_ONCE("Attribute streams of " << this->getTopic() << " are always dequantized, SkipDequantization* does not apply to them.");
+    }
+
+    std::vector<std::unique_ptr<DracotoPC2> > converters;
+    bool tiles_ok = true;
+    for (std::future<std::unique_ptr<draco::PointCloud> >& decoded_tile : decoded_tiles)
+    {
+        std::unique_ptr<draco::PointCloud> pc = decoded_tile.get();
+        tiles_ok = tiles_ok && (pc != nullptr);
+        if (pc != nullptr)
+        {
+            converters.emplace_back(new DracotoPC2(std::move(pc), message));
+            converters.back()->set_restore_duplicates(config.restore_duplicates);
+            converters.back()->set_field_projection(field_names);
+            if (quantized_output && !message->attribute_streams)
+            {
+                converters.back()->set_quantized_output(skipped);
+            }
+        }
+    }
+    statistics.decode_seconds += statistics.timer.lap();
+    if ((!tiles_ok) || converters.empty())
+    {
+        return false;
+    }
+
+    // tiles which did not quantize the same attributes (e.g. empty tiles) would deliver fields of different types, all of them
+    // are dequantized then
+    if (quantized_output && !message->attribute_streams)
+    {
+        bool same_fields = true;
+        for (const std::unique_ptr<DracotoPC2>& converter : converters)
+        {
+            same_fields = same_fields && same_field_types(converter->output_fields(), converters.front()->output_fields());
+        }
+        if (!same_fields)
+        {
+            ROS_WARN_STREAM_THROTTLE(10.0, "Tiles of " << this->getTopic() << " were quantized differently, they are dequantized.");
+            for (const std::unique_ptr<DracotoPC2>& converter : converters)
+            {
+                converter->set_quantized_output(std::vector<bool>());
+            }
+        }
+    }
+
+    // stitch tiles back into a single PointCloud2
+    converters.front()->assign_output_description(PC2);
+
+    // attribute streams hold different fields of the same points, which are written into output concurrently
+    if (message->attribute_streams)
+    {
+        return scatterStreams(*message, converters, *decode_pool, statistics, PC2);
+    }
+
+    uint32_t number_of_points = 0;
+    bool deduplicated = false;
+    bool covers_point_step = true;
+    for (const std::unique_ptr<DracotoPC2>& converter : converters)
+    {
+        number_of_points += converter->num_points();
+        deduplicated = deduplicated || converter->deduplicated();
+        covers_point_step = covers_point_step && converter->covers_point_step();
+    }
+    if (deduplicated)
+    {
+        PC2.width = number_of_points;
+        PC2.height = 1;
+        PC2.row_step = number_of_points * PC2.point_step;
+    }
+    // padding bytes are not written by tiles
+    if (!covers_point_step)
+    {
+        PC2.data.clear();
+    }
+    PC2.data.resize(size_t(number_of_points) * PC2.point_step);
+
+    // scatter tiles into their slices of output in parallel
+    std::vector<std::future<void> > written_tiles;
+    size_t offset = 0;
+    for (const std::unique_ptr<DracotoPC2>& converter : converters)
+    {
+        uint8_t* tile_data = PC2.data.data() + offset;
+        const DracotoPC2* tile_converter = converter.get();
+        written_tiles.push_back(decode_pool->submit([tile_converter, tile_data]() { tile_converter->write_points(tile_data); }));
+        offset += size_t(converter->num_points()) * PC2.point_step;
+    }
+    for (std::future<void>& written_tile : written_tiles)
+    {
+        written_tile.get();
+    }
+    statistics.scatter_seconds += statistics.timer.lap();
+
+    // consumers of integer fields need scale and offsets of each tile
+    if (quantized_output)
+    {
+        uint32_t first_point = 0;
+        for (const std::unique_ptr<DracotoPC2>& converter : converters)
+        {
+            if (converter->num_points() > 0)
+            {
+                publishQuantization(*converter, PC2.header, first_point, converter->num_points());
+            }
+            first_point += converter->num_points();
+        }
+    }
 
+    return true;
+}
+
+bool DracoSubscriber::scatterStreams(const draco_point_cloud_transport::CompressedPointCloud2& message,
+                                     const std::vector<std::unique_ptr<DracotoPC2> >& converters, ThreadPool& decode_pool,
+                                     DecodeStatistics& statistics, sensor_msgs::PointCloud2& PC2)
+{
+    const uint32_t number_of_points = converters.front()->num_points();
+    for (const std::unique_ptr<DracotoPC2>& converter : converters)
+    {
+        if (converter->num_points() != number_of_points)
+        {
+            ROS_ERROR_STREAM("Attribute streams of CompressedPointCloud2 differ in number of points!");
+            return false;
+        }
+    }
+
+    // zero-filling is skipped if fields written by streams cover whole point_step
+    bool covers_point_step = (FieldLayout(PC2.fields, PC2.point_step).padding_bytes() == 0);
+    for (size_t field_index = 0; field_index < message.fields.size(); field_index++)
+    {
+        bool written = false;
+        for (const std::unique_ptr<DracotoPC2>& converter : converters)
+        {
+            written = written || converter->writes_field(field_index);
+        }
+        covers_point_step = covers_point_step && (written || !converters.front()->delivers_field(field_index));
+    }
+    if (!covers_point_step)
+    {
+        PC2.data.clear();
+    }
+    PC2.data.resize(size_t(number_of_points) * PC2.point_step);
+
+    // streams write disjoint fields of all points in parallel
+    std::vector<std::future<void> > written_streams;
+    uint8_t* out_data = PC2.data.data();
+    for (const std::unique_ptr<DracotoPC2>& converter : converters)
+    {
+        const DracotoPC2* stream_converter = converter.get();
+        written_streams.push_back(decode_pool.submit([stream_converter, out_data]() { stream_converter->write_points(out_data); }));
+    }
+    for (std::future<void>& written_stream : written_streams)
+    {
+        written_stream.get();
+    }
+    statistics.scatter_seconds += statistics.timer.lap();
+
+    return true;
+}
+
+bool DracoSubscriber::decodeMessage(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
+                                    const Config& config, const std::vector<std::string>& field_names,
+                                    DecodeStatistics& statistics, sensor_msgs::PointCloud2& PC2)
+{
+    // get size of buffer with compressed data in Bytes
+    uint32_t compressed_data_size = message->compressed_data.size();
+
+    // key and delta frames of temporal compression
+    if (message->frame_type != draco_point_cloud_transport::CompressedPointCloud2::INTRA_FRAME)
+    {
+        std::unique_ptr<draco::PointCloud> decoded_pc = decode(message->compressed_data.data(), compressed_data_size, config);
+        statistics.decode_seconds += statistics.timer.lap();
+        if (decoded_pc == nullptr)
+        {
+            return false;
+        }
+        if (!temporal_decoder_.convert(*decoded_pc, *message, field_names, PC2))
+        {
+            ROS_WARN_STREAM_THROTTLE(1.0, "Reference frame of Draco delta frame was not received, waiting for next key frame.");
+            return false;
+        }
+        statistics.scatter_seconds += statistics.timer.lap();
+        return true;
+    }
+
+    // point cloud was encoded as independent tiles
+    if (!message->chunk_offsets.empty())
+    {
+        return decodeTiles(message, config, field_names, statistics, PC2);
+    }
+
+    // decode buffer into draco point cloud, message holds the data for the whole decoding
+    std::unique_ptr<draco::PointCloud> decoded_pc = decode(message->compressed_data.data(), compressed_data_size, config);
+    statistics.decode_seconds += statistics.timer.lap();
+    if (decoded_pc == nullptr)
+    {
+        return false;
+    }
+
+    // point cloud encoded without loss
+    if (LosslesstoPC2::is_lossless(*decoded_pc))
+    {
+        LosslesstoPC2 converter(*decoded_pc, *message);
+        if (!converter.convert(field_names, PC2))
+        {
+            return false;
+        }
+        statistics.scatter_seconds += statistics.timer.lap();
+        return true;
+    }
+
+    // organized point cloud encoded as range image
+    if (RangeImagetoPC2::is_range_image(*decoded_pc))
+    {
+        RangeImagetoPC2 converter(*decoded_pc, *message);
+        if (!converter.convert(field_names, PC2))
+        {
+            return false;
+        }
+        statistics.scatter_seconds += statistics.timer.lap();
+        return true;
+    }
 
     // create and initiate converter object
     DracotoPC2 converter_b(std::move(decoded_pc), message);
-    // convert draco point cloud to sensor_msgs::PointCloud2
-    sensor_msgs::PointCloud2Ptr ptr_PC2( new sensor_msgs::PointCloud2( std::move(converter_b.convert()) ) );
+    converter_b.set_restore_duplicates(config.restore_duplicates);
+    converter_b.set_field_projection(field_names);
+    // attributes with skipped dequantization are delivered as integer fields
+    converter_b.set_quantized_output(skippedDequantization(config));
+    // convert draco point cloud in place, data of PC2 keeps its allocated storage
+    converter_b.convert(PC2);
+    statistics.scatter_seconds += statistics.timer.lap();
+
+    // consumers of integer fields need their scale and offsets
+    publishQuantization(converter_b, PC2.header, 0, 0);
+
+    return true;
+}
+
+void DracoSubscriber::publishQuantization(const DracotoPC2& converter, const std_msgs::Header& header, uint32_t first_point,
+                                          uint32_t number_of_points) const
+{
+    const ros::Publisher quantization_publisher = quantizationPublisher();
+    if (quantization_publisher.getNumSubscribers() > 0)
+    {
+        draco_point_cloud_transport::DracoQuantization quantization;
+        converter.get_quantization(quantization);
+        if (!quantization.field_names.empty())
+        {
+            quantization.header = header;
+            quantization.first_point = first_point;
+            quantization.number_of_points = number_of_points;
+            quantization_publisher.publish(quantization);
+        }
+    }
+}
+
+void DracoSubscriber::internalCallback(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
+                                            const Callback& user_cb)
+
+{
+    // configuration used for the whole message, config_ may be changed by reconfigure server meanwhile
+    Config config;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        config = config_;
+    }
+
+    // empty buffer
+    if (message->compressed_data.empty())
+    {
+        return ;
+    }
+
+    // decoded by frame decoding threads, callback thread only queues the frame
+    if (config.decode_queue_size > 0)
+    {
+        queueFrame(message, config, user_cb);
+        return;
+    }
+
+    deliverFrame(*message, config, decodeFrame(message, config), user_cb);
+}
 
+sensor_msgs::PointCloud2Ptr DracoSubscriber::decodeFrame(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message,
+                                                         const Config& config)
+{
+    // fields requested by user
+    const std::vector<std::string> field_names = requestedFields(*message, config);
+
+    // instrumentation reads no clocks and counters when statistics are disabled
+    const bool statistics_enabled = (config.statistics_period > 0.0) && (statistics_ != nullptr);
+    const size_t allocations = statistics_enabled ? message_pool_->allocations() : 0;
+    DecodeStatistics statistics(statistics_enabled);
+
+    // decoded in place into message from allocator of user or recycled one, returned to pool when user releases it
+    sensor_msgs::PointCloud2Ptr ptr_PC2 = acquireOutput();
+    if ((ptr_PC2 != nullptr) && !decodeMessage(message, config, field_names, statistics, *ptr_PC2))
+    {
+        ptr_PC2.reset();
+    }
+
+    if (statistics_enabled)
+    {
+        if (ptr_PC2 == nullptr)
+        {
+            statistics_->add_failure();
+        }
+        else
+        {
+            const double input_bytes = message->compressed_data.size();
+            const double output_bytes = ptr_PC2->data.size();
+            statistics_->add(DECODE_TIME, statistics.decode_seconds);
+            statistics_->add(SCATTER_TIME, statistics.scatter_seconds);
+            statistics_->add(INPUT_BYTES, input_bytes);
+            statistics_->add(OUTPUT_BYTES, output_bytes);
+            statistics_->add(COMPRESSION_RATIO, output_bytes / input_bytes);
+            statistics_->add(DECODED_POINTS, double(ptr_PC2->height) * ptr_PC2->width);
+            statistics_->add(ALLOCATIONS, message_pool_->allocations() - allocations);
+        }
+    }
+
+    return ptr_PC2;
+}
+
+void DracoSubscriber::deliverFrame(const draco_point_cloud_transport::CompressedPointCloud2& message, const Config& config,
+                                   sensor_msgs::PointCloud2Ptr PC2, const Callback& user_cb)
+{
+    if (PC2 == nullptr)
+    {
+        return;
+    }
+
+    // chunk of progressively sent cloud, delivered with the other chunks once all of them arrived
+    if ((message.chunk_count > 0) && config.assemble_chunks)
+    {
+        PC2 = assembleChunk(message, PC2);
+        if (PC2 == nullptr)
+        {
+            return;
+        }
+    }
 
     // Publish message to user callback
-    user_cb(ptr_PC2);
+    user_cb(PC2);
+}
+
+void DracoSubscriber::queueFrame(const draco_point_cloud_transport::CompressedPointCloud2ConstPtr& message, const Config& config,
+                                 const Callback& user_cb)
+{
+    // lazily created pool of frame decoding threads, not recreated while frames_mutex_ is held; a pool replaced by
+    // reconfiguration is only swapped out here, it finishes its queued frames before it is destroyed by the new pool
+    std::shared_ptr<ThreadPool> frame_pool;
+    std::shared_ptr<ThreadPool> retired_frame_pool;
+    {
+        std::lock_guard<std::mutex> lock(frame_pool_mutex_);
+        if ((frame_pool_ == nullptr) || (frame_pool_threads_ != config.frame_decoding_threads))
+        {
+            retired_frame_pool = std::move(frame_pool_);
+            frame_pool_ = std::make_shared<ThreadPool>(config.frame_decoding_threads);
+            frame_pool_threads_ = config.frame_decoding_threads;
+        }
+        frame_pool = frame_pool_;
+    }
+
+    PendingFrame frame;
+    frame.message = message;
+    frame.config = config;
+    frame.user_cb = user_cb;
+    frame.received = std::chrono::steady_clock::now();
+
+    uint64_t skipped_frames = 0;
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex_);
+        // stale frames are dropped before they are decoded; temporal frames and chunks depend on each other and are kept
+        if (config.latest_only)
+        {
+            const size_t queued_frames = pending_frames_.size();
+            pending_frames_.erase(std::remove_if(pending_frames_.begin(), pending_frames_.end(), [](const PendingFrame& pending_frame)
+            {
+                return (pending_frame.message->frame_type == draco_point_cloud_transport::CompressedPointCloud2::INTRA_FRAME) &&
+                       (pending_frame.message->chunk_count == 0);
+            }), pending_frames_.end());
+            skipped_frames += queued_frames - pending_frames_.size();
+        }
+        // full queue drops its oldest frames
+        while (pending_frames_.size() >= size_t(config.decode_queue_size))
+        {
+            pending_frames_.pop_front();
+            skipped_frames++;
+        }
+        pending_frames_.push_back(std::move(frame));
+    }
+
+    if (skipped_frames > 0)
+    {
+        skipped_frames_ += skipped_frames;
+        ROS_DEBUG_STREAM_THROTTLE(1.0, "Draco subscriber skipped " << skipped_frames_ << " stale frames so far.");
+        if ((config.statistics_period > 0.0) && (statistics_ != nullptr))
+        {
+            statistics_->add(SKIPPED_FRAMES, skipped_frames);
+        }
+    }
+
+    // one task per queued frame, tasks of skipped frames find the queue empty
+    frame_pool->submit([this]() { decodeQueuedFrame(); });
+
+    // joining the replaced pool waits for its backlog, which must not block the subscription callback
+    if (retired_frame_pool != nullptr)
+    {
+        frame_pool->submit([retired_pool = std::move(retired_frame_pool)]() mutable { retired_pool.reset(); });
+    }
+}
+
+void DracoSubscriber::decodeQueuedFrame()
+{
+    PendingFrame frame;
+    uint64_t sequence;
+    {
+        std::unique_lock<std::mutex> lock(frames_mutex_);
+        if (pending_frames_.empty())
+        {
+            return;
+        }
+        frame = std::move(pending_frames_.front());
+        pending_frames_.pop_front();
+        sequence = next_sequence_++;
+
+        // temporal frames depend on the previous one, they are decoded only after all preceding frames
+        if (frame.message->frame_type != draco_point_cloud_transport::CompressedPointCloud2::INTRA_FRAME)
+        {
+            frames_condition_.wait(lock, [this, sequence]() { return next_delivery_ == sequence; });
+        }
+    }
+
+    if ((frame.config.statistics_period > 0.0) && (statistics_ != nullptr))
+    {
+        statistics_->add(QUEUE_AGE, std::chrono::duration<double>(std::chrono::steady_clock::now() - frame.received).count());
+    }
+
+    DecodedFrame decoded_frame;
+    decoded_frame.PC2 = decodeFrame(frame.message, frame.config);
+    decoded_frame.frame = std::move(frame);
+
+    // frames are delivered in order of reception by one thread at a time, which picks up frames decoded meanwhile
+    std::unique_lock<std::mutex> lock(frames_mutex_);
+    decoded_frames_.emplace(sequence, std::move(decoded_frame));
+    if (delivering_)
+    {
+        return;
+    }
+    delivering_ = true;
+    while ((!decoded_frames_.empty()) && (decoded_frames_.begin()->first == next_delivery_))
+    {
+        DecodedFrame next_frame = std::move(decoded_frames_.begin()->second);
+        decoded_frames_.erase(decoded_frames_.begin());
+        next_delivery_++;
+        frames_condition_.notify_all();
+
+        lock.unlock();
+        deliverFrame(*next_frame.frame.message, next_frame.frame.config, next_frame.PC2, next_frame.frame.user_cb);
+        lock.lock();
+    }
+    delivering_ = false;
+}
+
+void DracoSubscriber::stopFramePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex_);
+        pending_frames_.clear();
+    }
+    // finishes frames being decoded, remaining tasks find the queue empty
+    std::shared_ptr<ThreadPool> frame_pool;
+    {
+        std::lock_guard<std::mutex> lock(frame_pool_mutex_);
+        frame_pool = std::move(frame_pool_);
+        frame_pool_threads_ = 0;
+    }
+    frame_pool.reset();
+}
+
+uint64_t DracoSubscriber::getSkippedFrames() const
+{
+    return skipped_frames_;
+}
+
+std::shared_ptr<ThreadPool> DracoSubscriber::decodePool(int number_of_threads)
+{
+    std::lock_guard<std::mutex> lock(decode_pool_mutex_);
+    if ((decode_pool_ == nullptr) || (decode_pool_threads_ != number_of_threads))
+    {
+        decode_pool_ = std::make_shared<ThreadPool>(number_of_threads);
+        decode_pool_threads_ = number_of_threads;
+    }
+    return decode_pool_;
+}
+
+sensor_msgs::PointCloud2Ptr DracoSubscriber::assembleChunk(const draco_point_cloud_transport::CompressedPointCloud2& message,
+                                                           const sensor_msgs::PointCloud2Ptr& chunk)
+{
+    // chunks arrive in order, a missing chunk discards the cloud
+    if ((message.chunk_index == 0) || (assembled_ == nullptr) || (message.chunk_frame != assembled_frame_) ||
+        (message.chunk_index != assembled_chunks_))
+    {
+        if ((assembled_ != nullptr) && (assembled_chunks_ > 0))
+        {
+            ROS_WARN_STREAM_THROTTLE(1.0, "Chunk of progressively sent Draco point cloud was lost, incomplete cloud dropped.");
+        }
+        assembled_.reset();
+        assembled_chunks_ = 0;
+        if (message.chunk_index != 0)
+        {
+            return nullptr;
+        }
+        assembled_ = acquireOutput();
+        assembled_frame_ = message.chunk_frame;
+        // description of cloud only, data of recycled message keeps its allocated storage
+        assembled_->header = chunk->header;
+        assembled_->height = chunk->height;
+        assembled_->width = chunk->width;
+        assembled_->fields = chunk->fields;
+        assembled_->is_bigendian = chunk->is_bigendian;
+        assembled_->point_step = chunk->point_step;
+        assembled_->row_step = chunk->row_step;
+        assembled_->is_dense = chunk->is_dense;
+        assembled_->data.clear();
+        assembled_->data.reserve(size_t(message.cloud_height) * message.cloud_width * chunk->point_step);
+    }
+
+    // points of chunks follow each other
+    assembled_->data.insert(assembled_->data.end(), chunk->data.begin(), chunk->data.end());
+    assembled_chunks_++;
+    if (assembled_chunks_ < message.chunk_count)
+    {
+        return nullptr;
+    }
+
+    // cloud keeps its organization unless points were deduplicated
+    sensor_msgs::PointCloud2Ptr assembled = assembled_;
+    assembled_.reset();
+    assembled_chunks_ = 0;
+    const size_t number_of_points = (assembled->point_step > 0) ? assembled->data.size() / assembled->point_step : 0;
+    if (number_of_points == size_t(message.cloud_height) * message.cloud_width)
+    {
+        assembled->height = message.cloud_height;
+        assembled->width = message.cloud_width;
+    }
+    else
+    {
+        assembled->height = 1;
+        assembled->width = number_of_points;
+    }
+    assembled->row_step = assembled->width * assembled->point_step;
+    return assembled;
 }
 
 } //namespace draco_point_cloud_transport
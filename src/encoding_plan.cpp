@@ -0,0 +1,350 @@
+#include "draco_point_cloud_transport/encoding_plan.h"
+
+#include <ros/ros.h>
+
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+namespace draco_point_cloud_transport
+{
+
+EncodingPlan::EncodingPlan(const sensor_msgs::PointCloud2& PC2, const DracoPublisherConfig& config, uint32_t config_revision, const std::string& base_topic) :
+    layout_(PC2.fields, PC2.point_step), number_of_attributes_(0), expert_quantization_ok_(config.expert_quantization),
+    layout_hash_(layout_hash(PC2)), config_revision_(config_revision)
+{
+    // tracks if all necessary parameters were set for expert attribute types
+    bool expert_settings_ok = true;
+
+    std::string expert_attribute_data_type;
+
+    // quantization bits by draco::GeometryAttribute::Type for quantization during conversion
+    // attribute streams are encoded sequentially to keep points aligned, floats are quantized before encoding
+    const bool prequantize = (config.prequantize || config.attribute_streams) && config.force_quantization;
+    const int type_quantization_bits[] = {config.quantization_POSITION, config.quantization_NORMAL, config.quantization_COLOR,
+                                          config.quantization_TEX_COORD, config.quantization_GENERIC};
+
+    for (const sensor_msgs::PointField& field : PC2.fields)
+    {
+        FieldEncoding encoding;
+        encoding.attribute_type = draco::GeometryAttribute::INVALID;
+        encoding.rgba_tweak = false;
+        encoding.expert_quantization_bits = -1;
+        encoding.prequantization_bits = 0;
+        encoding.attribute_id = -1;
+        encoding.duplicate = layout_.duplicate_of(fields_.size()) >= 0;
+        encoding.first_component = 0;
+        encoding.merged_components = 0;
+
+        if (config.expert_attribute_types) // find attribute type in user specified parameters
+        {
+            if (ros::param::getCached(base_topic + "/draco/attribute_mapping/attribute_type/" + field.name, expert_attribute_data_type))
+            {
+                if (expert_attribute_data_type.compare("POSITION")==0) // if data type is POSITION
+                {
+                    encoding.attribute_type = draco::GeometryAttribute::POSITION;
+                }
+                else if (expert_attribute_data_type.compare("NORMAL")==0) // if data type is NORMAL
+                {
+                    encoding.attribute_type = draco::GeometryAttribute::NORMAL;
+                }
+                else if (expert_attribute_data_type.compare("COLOR")==0) // if data type is COLOR
+                {
+                    encoding.attribute_type = draco::GeometryAttribute::COLOR;
+                    ros::param::getCached(base_topic + "/draco/attribute_mapping/rgba_tweak/" + field.name, encoding.rgba_tweak);
+                }
+                else if (expert_attribute_data_type.compare("TEX_COORD")==0) // if data type is TEX_COORD
+                {
+                    encoding.attribute_type = draco::GeometryAttribute::TEX_COORD;
+                }
+                else if (expert_attribute_data_type.compare("GENERIC")==0) // if data type is GENERIC
+                {
+                    encoding.attribute_type = draco::GeometryAttribute::GENERIC;
+                }
+                else
+                {
+                    ROS_ERROR_STREAM ("Attribute data type not recognized for " + field.name + " field entry. Using regular type recognition instead.");
+                    expert_settings_ok = false;
+                }
+            }
+            else
+            {
+                ROS_ERROR_STREAM ("Attribute data type not specified for " + field.name + " field entry. Using regular type recognition instead.");
+                ROS_INFO_STREAM ("To set attribute type for " + field.name + " field entry, set " + base_topic + "/draco/attribute_mapping/attribute_type/" + field.name);
+                expert_settings_ok = false;
+            }
+        }
+
+        if ((!config.expert_attribute_types) || (!expert_settings_ok)) // find attribute type in recognized names
+        {
+            encoding.rgba_tweak = false;
+            encoding.attribute_type = recognized_attribute_type(field.name, encoding.rgba_tweak);
+        }
+
+        // attribute data type switch
+        switch (field.datatype) {
+            case sensor_msgs::PointField::INT8 :
+                encoding.data_type = draco::DT_INT8;
+                break;
+            case sensor_msgs::PointField::UINT8 :
+                encoding.data_type = draco::DT_UINT8;
+                break;
+            case sensor_msgs::PointField::INT16 :
+                encoding.data_type = draco::DT_INT16;
+                break;
+            case sensor_msgs::PointField::UINT16 :
+                encoding.data_type = draco::DT_UINT16;
+                break;
+            case sensor_msgs::PointField::INT32 :
+                encoding.data_type = draco::DT_INT32;
+                break;
+            case sensor_msgs::PointField::UINT32 :
+                encoding.data_type = draco::DT_UINT32;
+                break;
+            case sensor_msgs::PointField::FLOAT32 :
+                encoding.data_type = draco::DT_FLOAT32;
+                break;
+            case sensor_msgs::PointField::FLOAT64 :
+                encoding.data_type = draco::DT_FLOAT64;
+                break;
+            default:
+                encoding.data_type = draco::DT_INVALID;
+                // RAISE ERROR - INVALID DATA TYPE
+                ROS_FATAL_STREAM(" Invalid data type in PointCloud2 to Draco conversion");
+                break;
+        }  // attribute data type switch end
+
+        if (encoding.rgba_tweak) // attribute is rgb/rgba color
+        {
+            // 64bit colors are encoded in 16bits per color, 32bit colors in 8bits per color
+            encoding.attribute_data_type = (encoding.data_type == draco::DT_FLOAT64) ? draco::DT_UINT16 : draco::DT_UINT8;
+            encoding.num_components = 4 * field.count;
+        }
+        else // attribute is not rgb/rgba color, this is the default behavior
+        {
+            encoding.attribute_data_type = encoding.data_type;
+            encoding.num_components = field.count;
+        }
+
+        // quantization bits of expert encoder
+        if (config.expert_quantization)
+        {
+            int attribute_quantization_bits;
+            if (ros::param::getCached(base_topic + "/draco/attribute_mapping/quantization_bits/" + field.name, attribute_quantization_bits))
+            {
+                encoding.expert_quantization_bits = attribute_quantization_bits;
+            }
+            else
+            {
+                if (config.force_quantization)
+                {
+                    ROS_ERROR_STREAM ("Attribute quantization not specified for " + field.name + " field entry. Using regular encoder instead.");
+                    ROS_INFO_STREAM ("To set quantization for " + field.name + " field entry, set " + base_topic + "/draco/attribute_mapping/quantization_bits/" + field.name);
+                }
+                expert_quantization_ok_ = false;
+            }
+        }
+
+        // float attributes quantized during conversion
+        if (prequantize && (!encoding.rgba_tweak) && (encoding.data_type == draco::DT_FLOAT32) &&
+            ((encoding.attribute_type == draco::GeometryAttribute::POSITION) ||
+             (encoding.attribute_type == draco::GeometryAttribute::NORMAL) ||
+             (encoding.attribute_type == draco::GeometryAttribute::GENERIC)))
+        {
+            encoding.prequantization_bits = type_quantization_bits[encoding.attribute_type];
+        }
+
+        fields_.push_back(encoding);
+    }
+
+    // field layout is analyzed once per layout and configuration
+    if (layout_.padding_bytes() > 0)
+    {
+        ROS_DEBUG_STREAM("Draco encoding of " << base_topic << ": " << layout_.describe());
+    }
+    for (size_t field_index = 0; field_index < PC2.fields.size(); field_index++)
+    {
+        if ((!layout_.valid(field_index)) || (layout_.duplicate_of(field_index) >= 0) || layout_.overlapping(field_index))
+        {
+            ROS_WARN_STREAM("Unusual PointField layout of " << base_topic << ", invalid fields are not encoded, duplicates are restored "
+                            "from the field they duplicate: " << layout_.describe());
+            break;
+        }
+    }
+
+    // expert quantization overrides quantization by attribute type only if it is complete
+    if (expert_quantization_ok_)
+    {
+        for (FieldEncoding& encoding : fields_)
+        {
+            if (encoding.prequantization_bits > 0)
+            {
+                encoding.prequantization_bits = encoding.expert_quantization_bits;
+            }
+        }
+    }
+
+    if (config.merge_fields)
+    {
+        merge_contiguous_fields();
+    }
+    assign_attributes();
+}
+
+void EncodingPlan::merge_contiguous_fields()
+{
+    for (const std::vector<size_t>& group : layout_.contiguous_groups())
+    {
+        // runs of fields within group which are quantized the same way
+        size_t run_begin = 0;
+        for (size_t member = 1; member <= group.size(); member++)
+        {
+            const FieldEncoding& first = fields_[group[run_begin]];
+            if (member < group.size())
+            {
+                const FieldEncoding& encoding = fields_[group[member]];
+                if ((encoding.attribute_type == first.attribute_type) && (encoding.rgba_tweak == first.rgba_tweak) &&
+                    (encoding.expert_quantization_bits == first.expert_quantization_bits) &&
+                    (encoding.prequantization_bits == first.prequantization_bits) &&
+                    (member - run_begin < size_t(std::numeric_limits<int8_t>::max())))
+                {
+                    continue;
+                }
+            }
+
+            // single fields, generic fields (e.g. intensity, ring) and packed colors keep their own attributes
+            const size_t run_size = member - run_begin;
+            if ((run_size > 1) && (!first.rgba_tweak) &&
+                ((first.attribute_type == draco::GeometryAttribute::POSITION) ||
+                 (first.attribute_type == draco::GeometryAttribute::NORMAL) ||
+                 (first.attribute_type == draco::GeometryAttribute::COLOR)))
+            {
+                fields_[group[run_begin]].merged_components = run_size;
+                for (size_t component = 1; component < run_size; component++)
+                {
+                    fields_[group[run_begin + component]].first_component = component;
+                }
+            }
+            run_begin = member;
+        }
+    }
+}
+
+void EncodingPlan::assign_attributes()
+{
+    // attributes are added in order of fields, fields outside point_step are not read
+    for (size_t field_index = 0; field_index < fields_.size(); field_index++)
+    {
+        const FieldEncoding& encoding = fields_[field_index];
+        if (layout_.valid(field_index) && (!encoding.duplicate) && (encoding.first_component == 0))
+        {
+            fields_[field_index].attribute_id = number_of_attributes_++;
+        }
+    }
+
+    // merged fields are held by attribute of first field of their group
+    for (const std::vector<size_t>& group : layout_.contiguous_groups())
+    {
+        for (size_t member = 1; member < group.size(); member++)
+        {
+            FieldEncoding& encoding = fields_[group[member]];
+            if (encoding.first_component > 0)
+            {
+                encoding.attribute_id = fields_[group[member - encoding.first_component]].attribute_id;
+            }
+        }
+    }
+
+    // duplicates are restored from the field they duplicate
+    for (size_t field_index = 0; field_index < fields_.size(); field_index++)
+    {
+        const int original = layout_.duplicate_of(field_index);
+        if (original >= 0)
+        {
+            fields_[field_index].attribute_id = fields_[original].attribute_id;
+            fields_[field_index].first_component = fields_[original].first_component;
+        }
+    }
+}
+
+size_t EncodingPlan::layout_hash(const sensor_msgs::PointCloud2& PC2)
+{
+    // boost::hash_combine
+    size_t hash = PC2.point_step;
+    auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2); };
+
+    std::hash<std::string> string_hash;
+    combine(PC2.is_bigendian);
+    for (const sensor_msgs::PointField& field : PC2.fields)
+    {
+        combine(string_hash(field.name));
+        combine(field.offset);
+        combine(field.datatype);
+        combine(field.count);
+    }
+    return hash;
+}
+
+bool EncodingPlan::matches(size_t layout_hash, uint32_t config_revision) const
+{
+    return (layout_hash_ == layout_hash) && (config_revision_ == config_revision);
+}
+
+const std::vector<FieldEncoding>& EncodingPlan::fields() const
+{
+    return fields_;
+}
+
+bool EncodingPlan::expert_quantization_ok() const
+{
+    return expert_quantization_ok_;
+}
+
+const FieldLayout& EncodingPlan::layout() const
+{
+    return layout_;
+}
+
+int EncodingPlan::number_of_attributes() const
+{
+    return number_of_attributes_;
+}
+
+bool EncodingPlan::adds_attribute(const FieldEncoding& encoding)
+{
+    return (encoding.attribute_id >= 0) && (!encoding.duplicate) && (encoding.first_component == 0);
+}
+
+draco::GeometryAttribute::Type EncodingPlan::recognized_attribute_type(const std::string& name, bool& rgba_tweak)
+{
+    // recognized names, built once
+    // TODO: add texture coordinate (TEX_COORD) recognized names
+    static const std::unordered_map<std::string, draco::GeometryAttribute::Type> recognized_names = {
+            {"x", draco::GeometryAttribute::POSITION},
+            {"y", draco::GeometryAttribute::POSITION},
+            {"z", draco::GeometryAttribute::POSITION},
+            {"pos", draco::GeometryAttribute::POSITION},
+            {"position", draco::GeometryAttribute::POSITION},
+            {"r", draco::GeometryAttribute::COLOR},
+            {"g", draco::GeometryAttribute::COLOR},
+            {"b", draco::GeometryAttribute::COLOR},
+            {"a", draco::GeometryAttribute::COLOR},
+            {"rgb", draco::GeometryAttribute::COLOR},
+            {"rgba", draco::GeometryAttribute::COLOR},
+            {"nx", draco::GeometryAttribute::NORMAL},
+            {"ny", draco::GeometryAttribute::NORMAL},
+            {"nz", draco::GeometryAttribute::NORMAL}};
+
+    // rgb/rgba are 4 colors saved as one variable
+    rgba_tweak = (name == "rgb") || (name == "rgba");
+
+    std::unordered_map<std::string, draco::GeometryAttribute::Type>::const_iterator it = recognized_names.find(name);
+    if (it == recognized_names.end())
+    {
+        // all unrecognized attributes
+        return draco::GeometryAttribute::GENERIC;
+    }
+    return it->second;
+}
+
+} //namespace draco_point_cloud_transport
@@ -0,0 +1,152 @@
+#include "draco_point_cloud_transport/field_layout.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace draco_point_cloud_transport
+{
+
+FieldLayout::FieldLayout(const std::vector<sensor_msgs::PointField>& fields, uint32_t point_step) :
+    fields_(fields), point_step_(point_step), valid_(fields.size(), 0), duplicate_of_(fields.size(), -1), overlapping_(fields.size(), 0),
+    payload_bytes_(0)
+{
+    // number of valid fields covering each byte of point_step, duplicates are not counted
+    std::vector<uint8_t> coverage(point_step, 0);
+    for (size_t field_index = 0; field_index < fields_.size(); field_index++)
+    {
+        const sensor_msgs::PointField& field = fields_[field_index];
+        const uint32_t field_size = point_field_size(field);
+        valid_[field_index] = (field_size > 0) && (uint64_t(field.offset) + field_size <= point_step);
+        if (!valid_[field_index])
+        {
+            continue;
+        }
+        for (size_t other_index = 0; other_index < field_index; other_index++)
+        {
+            const sensor_msgs::PointField& other = fields_[other_index];
+            if (valid_[other_index] && (duplicate_of_[other_index] < 0) && (other.offset == field.offset) &&
+                (other.datatype == field.datatype) && (other.count == field.count))
+            {
+                duplicate_of_[field_index] = other_index;
+                break;
+            }
+        }
+        if (duplicate_of_[field_index] >= 0)
+        {
+            continue;
+        }
+        for (uint32_t byte = field.offset; byte < field.offset + field_size; byte++)
+        {
+            coverage[byte] = std::min(coverage[byte] + 1, 255);
+        }
+    }
+
+    std::vector<size_t> by_offset;
+    for (size_t field_index = 0; field_index < fields_.size(); field_index++)
+    {
+        if ((!valid_[field_index]) || (duplicate_of_[field_index] >= 0))
+        {
+            continue;
+        }
+        const sensor_msgs::PointField& field = fields_[field_index];
+        overlapping_[field_index] = std::any_of(coverage.begin() + field.offset, coverage.begin() + field.offset + point_field_size(field),
+                                                [](uint8_t count) { return count > 1; });
+        by_offset.push_back(field_index);
+    }
+    payload_bytes_ = point_step - std::count(coverage.begin(), coverage.end(), 0);
+
+    // runs of fields of one datatype without gaps, e.g. x, y, z
+    std::stable_sort(by_offset.begin(), by_offset.end(), [this](size_t a, size_t b) { return fields_[a].offset < fields_[b].offset; });
+    std::vector<size_t> group;
+    for (size_t field_index : by_offset)
+    {
+        const sensor_msgs::PointField& field = fields_[field_index];
+        const bool groupable = (field.count == 1) && !overlapping_[field_index];
+        if (!group.empty())
+        {
+            const sensor_msgs::PointField& previous = fields_[group.back()];
+            if (groupable && (field.datatype == previous.datatype) && (field.offset == previous.offset + point_field_size(previous)))
+            {
+                group.push_back(field_index);
+                continue;
+            }
+            if (group.size() > 1)
+            {
+                contiguous_groups_.push_back(group);
+            }
+            group.clear();
+        }
+        if (groupable)
+        {
+            group.push_back(field_index);
+        }
+    }
+    if (group.size() > 1)
+    {
+        contiguous_groups_.push_back(group);
+    }
+}
+
+bool FieldLayout::valid(size_t field_index) const
+{
+    return valid_[field_index];
+}
+
+int FieldLayout::duplicate_of(size_t field_index) const
+{
+    return duplicate_of_[field_index];
+}
+
+bool FieldLayout::overlapping(size_t field_index) const
+{
+    return overlapping_[field_index];
+}
+
+uint32_t FieldLayout::payload_bytes() const
+{
+    return payload_bytes_;
+}
+
+uint32_t FieldLayout::padding_bytes() const
+{
+    return point_step_ - payload_bytes_;
+}
+
+const std::vector<std::vector<size_t> >& FieldLayout::contiguous_groups() const
+{
+    return contiguous_groups_;
+}
+
+std::string FieldLayout::describe() const
+{
+    std::ostringstream description;
+    description << "point_step " << point_step_ << " B, payload " << payload_bytes_ << " B, padding " << padding_bytes() << " B";
+    for (size_t field_index = 0; field_index < fields_.size(); field_index++)
+    {
+        const std::string& name = fields_[field_index].name;
+        if (!valid_[field_index])
+        {
+            description << ", field " << name << " invalid";
+        }
+        else if (duplicate_of_[field_index] >= 0)
+        {
+            description << ", field " << name << " duplicates " << fields_[duplicate_of_[field_index]].name;
+        }
+        else if (overlapping_[field_index])
+        {
+            description << ", field " << name << " overlaps other fields";
+        }
+    }
+    for (const std::vector<size_t>& group : contiguous_groups_)
+    {
+        description << ", contiguous";
+        for (size_t field_index : group)
+        {
+            description << " " << fields_[field_index].name;
+        }
+    }
+    return description.str();
+}
+
+} //namespace draco_point_cloud_transport
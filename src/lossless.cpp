@@ -0,0 +1,348 @@
+#include "draco_point_cloud_transport/lossless.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
+
+#include <ros/ros.h>
+
+// draco
+#include <draco/point_cloud/point_cloud_builder.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+//! bytes at the same offset of every point, stored in one attribute
+struct Segment
+{
+    uint32_t offset;
+    uint32_t size;
+    draco::DataType data_type;
+    int num_components;
+};
+
+//! draco attributes have at most 127 components (int8_t)
+const uint32_t MAX_COMPONENTS = 127;
+
+//! adds segments holding number_of_values consecutive values of value_size Bytes starting at offset
+void add_segments(std::vector<Segment>& segments, uint32_t offset, uint32_t number_of_values, draco::DataType data_type, uint32_t value_size)
+{
+    while (number_of_values > 0)
+    {
+        const uint32_t components = std::min(number_of_values, MAX_COMPONENTS);
+        segments.push_back({offset, components * value_size, data_type, int(components)});
+        offset += components * value_size;
+        number_of_values -= components;
+    }
+}
+
+//! splits point_step into segments covering every byte exactly once
+std::vector<Segment> layout_segments(const sensor_msgs::PointCloud2& PC2)
+{
+    std::vector<Segment> segments;
+    std::vector<uint8_t> covered(PC2.point_step, 0);
+    for (const sensor_msgs::PointField& field : PC2.fields)
+    {
+        const uint32_t field_size = point_field_size(field);
+        if ((field_size == 0) || (uint64_t(field.offset) + field_size > PC2.point_step))
+        {
+            continue;
+        }
+        std::vector<uint8_t>::iterator field_begin = covered.begin() + field.offset;
+        std::vector<uint8_t>::iterator field_end = field_begin + field_size;
+        // bytes of fields overlapping previous fields are kept as raw bytes
+        if (std::find(field_begin, field_end, 1) != field_end)
+        {
+            continue;
+        }
+        std::fill(field_begin, field_end, 1);
+
+        switch (field.datatype)
+        {
+            case sensor_msgs::PointField::INT8 :
+                add_segments(segments, field.offset, field.count, draco::DT_INT8, 1);
+                break;
+            case sensor_msgs::PointField::UINT8 :
+                add_segments(segments, field.offset, field.count, draco::DT_UINT8, 1);
+                break;
+            case sensor_msgs::PointField::INT16 :
+                add_segments(segments, field.offset, field.count, draco::DT_INT16, 2);
+                break;
+            case sensor_msgs::PointField::UINT16 :
+                add_segments(segments, field.offset, field.count, draco::DT_UINT16, 2);
+                break;
+            default :
+                // 32 and 64 bit values are split into 16 bit words, integer prediction of draco needs differences within int32
+                add_segments(segments, field.offset, field_size / 2, draco::DT_UINT16, 2);
+                break;
+        }
+    }
+
+    // padding and bytes of fields with unknown datatype
+    uint32_t offset = 0;
+    while (offset < PC2.point_step)
+    {
+        if (covered[offset])
+        {
+            offset++;
+            continue;
+        }
+        uint32_t end = offset;
+        while ((end < PC2.point_step) && !covered[end])
+        {
+            end++;
+        }
+        add_segments(segments, offset, end - offset, draco::DT_UINT8, 1);
+        offset = end;
+    }
+    return segments;
+}
+
+//! binary metadata entry, empty if it is missing (empty entries are not stored)
+std::vector<uint8_t> get_binary(const draco::GeometryMetadata& metadata, const std::string& name)
+{
+    std::vector<uint8_t> value;
+    metadata.GetEntryBinary(name, &value);
+    return value;
+}
+
+} // namespace
+
+PC2toLossless::PC2toLossless(const sensor_msgs::PointCloud2& PC2) : PC2_(PC2)
+{
+}
+
+std::unique_ptr<draco::PointCloud> PC2toLossless::convert() const
+{
+    const uint32_t height = PC2_.height;
+    const uint32_t width = PC2_.width;
+    const uint64_t number_of_points = uint64_t(height) * width;
+    const size_t row_payload = size_t(width) * PC2_.point_step;
+    const size_t rows_size = size_t(height) * PC2_.row_step;
+
+    std::unique_ptr<draco::GeometryMetadata> metadata =
+            std::unique_ptr<draco::GeometryMetadata>(new draco::GeometryMetadata());
+    metadata->AddEntryInt("deduplicate", 0);
+    metadata->AddEntryInt("lossless", 1);
+
+    // draco counts points in 32 bits, neither points nor bytes stored one per point may exceed it
+    if (PC2_.data.size() > std::numeric_limits<uint32_t>::max())
+    {
+        ROS_ERROR_STREAM("Lossless conversion of PointCloud2 with " << PC2_.data.size() << " bytes of data failed, at most "
+                         << std::numeric_limits<uint32_t>::max() << " bytes can be encoded.");
+        return nullptr;
+    }
+
+    draco::PointCloudBuilder builder;
+
+    // data which is not described by height, width, point_step and row_step is stored as it is, one byte per point
+    if ((PC2_.row_step < row_payload) || (PC2_.data.size() < rows_size) || (number_of_points > std::numeric_limits<uint32_t>::max()))
+    {
+        builder.Start(PC2_.data.size());
+        const int att_id = builder.AddAttribute(draco::GeometryAttribute::GENERIC, 1, draco::DT_UINT8);
+        if (!PC2_.data.empty())
+        {
+            builder.SetAttributeValuesForAllPoints(att_id, PC2_.data.data(), 0);
+        }
+        metadata->AddEntryInt("lossless_raw", 1);
+    }
+    else
+    {
+        builder.Start(number_of_points);
+
+        // values of each segment are gathered from all points, in order of points
+        std::vector<int32_t> segment_entries;
+        std::vector<uint8_t> values;
+        for (const Segment& segment : layout_segments(PC2_))
+        {
+            values.resize(number_of_points * segment.size);
+            uint8_t* out_data = values.data();
+            for (uint32_t row = 0; row < height; row++)
+            {
+                const uint8_t* in_data = PC2_.data.data() + size_t(row) * PC2_.row_step + segment.offset;
+                for (uint32_t column = 0; column < width; column++)
+                {
+                    std::memcpy(out_data, in_data, segment.size);
+                    out_data += segment.size;
+                    in_data += PC2_.point_step;
+                }
+            }
+
+            const int att_id = builder.AddAttribute(draco::GeometryAttribute::GENERIC, segment.num_components, segment.data_type);
+            if (number_of_points > 0)
+            {
+                builder.SetAttributeValuesForAllPoints(att_id, values.data(), 0);
+            }
+            segment_entries.push_back(segment.offset);
+            segment_entries.push_back(segment.size);
+        }
+
+        // bytes at end of rows and after last row
+        std::vector<uint8_t> row_padding;
+        row_padding.reserve(size_t(height) * (PC2_.row_step - row_payload));
+        for (uint32_t row = 0; row < height; row++)
+        {
+            const uint8_t* row_data = PC2_.data.data() + size_t(row) * PC2_.row_step;
+            row_padding.insert(row_padding.end(), row_data + row_payload, row_data + PC2_.row_step);
+        }
+        const std::vector<uint8_t> trailing(PC2_.data.begin() + rows_size, PC2_.data.end());
+
+        if (!segment_entries.empty())
+        {
+            metadata->AddEntryIntArray("lossless_segments", segment_entries);
+        }
+        if (!row_padding.empty())
+        {
+            metadata->AddEntryBinary("lossless_row_padding", row_padding);
+        }
+        if (!trailing.empty())
+        {
+            metadata->AddEntryBinary("lossless_trailing", trailing);
+        }
+    }
+
+    // points must stay in order
+    std::unique_ptr<draco::PointCloud> pc = builder.Finalize(false);
+    if (pc == nullptr)
+    {
+        ROS_FATAL_STREAM("Lossless conversion of PointCloud2 to Draco::PointCloud failed");
+        return pc;
+    }
+    pc->AddMetadata(std::move(metadata));
+
+    return pc;
+}
+
+LosslesstoPC2::LosslesstoPC2(const draco::PointCloud& pc, const draco_point_cloud_transport::CompressedPointCloud2& compressed) :
+    pc_(pc), compressed_(compressed)
+{
+}
+
+bool LosslesstoPC2::is_lossless(const draco::PointCloud& pc)
+{
+    int32_t lossless = 0;
+    return (pc.metadata() != nullptr) && pc.metadata()->GetEntryInt("lossless", &lossless) && (lossless == 1);
+}
+
+bool LosslesstoPC2::convert(const std::vector<std::string>& field_names, sensor_msgs::PointCloud2& PC2) const
+{
+    const draco::GeometryMetadata* metadata = pc_.metadata();
+    if (metadata == nullptr)
+    {
+        ROS_ERROR_STREAM("In point_cloud_transport::LosslesstoPC2, metadata are missing!");
+        return false;
+    }
+    assign_description_of_PointCloud2(PC2, compressed_);
+
+    // data stored as it is, layout is not applied
+    int32_t raw = 0;
+    if (metadata->GetEntryInt("lossless_raw", &raw) && (raw == 1))
+    {
+        if ((pc_.num_attributes() != 1) || (pc_.attribute(0)->byte_stride() != 1))
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::LosslesstoPC2, raw data are corrupted!");
+            return false;
+        }
+        const draco::PointAttribute* attribute = pc_.attribute(0);
+        PC2.data.resize(pc_.num_points());
+        for (draco::PointIndex i(0); i < draco::PointIndex(pc_.num_points()); ++i)
+        {
+            PC2.data[i.value()] = *attribute->GetAddress(attribute->mapped_index(i));
+        }
+        return true;
+    }
+
+    const uint32_t height = compressed_.height;
+    const uint32_t width = compressed_.width;
+    const uint32_t point_step = compressed_.point_step;
+    const uint32_t row_step = compressed_.row_step;
+    const size_t number_of_points = size_t(height) * width;
+    const size_t row_payload = size_t(width) * point_step;
+
+    std::vector<int32_t> segment_entries;
+    metadata->GetEntryIntArray("lossless_segments", &segment_entries);
+    const std::vector<uint8_t> row_padding = get_binary(*metadata, "lossless_row_padding");
+    const std::vector<uint8_t> trailing = get_binary(*metadata, "lossless_trailing");
+
+    bool valid = (segment_entries.size() == 2 * size_t(pc_.num_attributes())) && (pc_.num_points() == number_of_points) &&
+                 (row_step >= row_payload) && (row_padding.size() == size_t(height) * (row_step - row_payload));
+    // segments cover each byte of point_step once
+    uint64_t covered_bytes = 0;
+    for (size_t segment = 0; valid && (segment < size_t(pc_.num_attributes())); segment++)
+    {
+        const int32_t offset = segment_entries[2 * segment];
+        const int32_t size = segment_entries[2 * segment + 1];
+        valid = (offset >= 0) && (size > 0) && (uint64_t(offset) + size <= point_step) && (pc_.attribute(segment)->byte_stride() == size);
+        covered_bytes += size;
+    }
+    valid = valid && (covered_bytes == point_step);
+    if (!valid)
+    {
+        ROS_ERROR_STREAM("In point_cloud_transport::LosslesstoPC2, lossless point cloud is corrupted!");
+        return false;
+    }
+
+    if (field_names.empty())
+    {
+        // every byte is written, recycled data is not cleared
+        PC2.data.resize(size_t(height) * row_step + trailing.size());
+        for (int att_id = 0; att_id < pc_.num_attributes(); att_id++)
+        {
+            const draco::PointAttribute* attribute = pc_.attribute(att_id);
+            const uint32_t offset = segment_entries[2 * att_id];
+            const uint32_t size = segment_entries[2 * att_id + 1];
+            draco::PointIndex point_index(0);
+            for (uint32_t row = 0; row < height; row++)
+            {
+                uint8_t* out_data = PC2.data.data() + size_t(row) * row_step + offset;
+                for (uint32_t column = 0; column < width; column++)
+                {
+                    std::memcpy(out_data, attribute->GetAddress(attribute->mapped_index(point_index)), size);
+                    out_data += point_step;
+                    ++point_index;
+                }
+            }
+        }
+        const size_t padding_size = row_step - row_payload;
+        for (uint32_t row = 0; row < height; row++)
+        {
+            std::copy(row_padding.begin() + row * padding_size, row_padding.begin() + (row + 1) * padding_size,
+                      PC2.data.begin() + size_t(row) * row_step + row_payload);
+        }
+        std::copy(trailing.begin(), trailing.end(), PC2.data.begin() + size_t(height) * row_step);
+        return true;
+    }
+
+    // requested fields packed without gaps, each point is restored in full before its fields are copied
+    std::vector<int> output_field_index;
+    project_fields(compressed_.fields, point_step, field_names, PC2.fields, PC2.point_step, output_field_index);
+    PC2.row_step = width * PC2.point_step;
+    PC2.data.resize(number_of_points * PC2.point_step);
+
+    std::vector<uint8_t> point(point_step);
+    for (draco::PointIndex point_index(0); point_index < draco::PointIndex(pc_.num_points()); ++point_index)
+    {
+        for (int att_id = 0; att_id < pc_.num_attributes(); att_id++)
+        {
+            const draco::PointAttribute* attribute = pc_.attribute(att_id);
+            std::memcpy(point.data() + segment_entries[2 * att_id], attribute->GetAddress(attribute->mapped_index(point_index)),
+                        segment_entries[2 * att_id + 1]);
+        }
+        uint8_t* out_data = PC2.data.data() + size_t(point_index.value()) * PC2.point_step;
+        for (size_t field_index = 0; field_index < compressed_.fields.size(); field_index++)
+        {
+            const sensor_msgs::PointField& field = compressed_.fields[field_index];
+            if ((output_field_index[field_index] >= 0) && (uint64_t(field.offset) + point_field_size(field) <= point_step))
+            {
+                std::memcpy(out_data + PC2.fields[output_field_index[field_index]].offset, point.data() + field.offset, point_field_size(field));
+            }
+        }
+    }
+    return true;
+}
+
+} //namespace draco_point_cloud_transport
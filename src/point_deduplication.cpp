@@ -0,0 +1,212 @@
+#include "draco_point_cloud_transport/point_deduplication.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
+#include "draco_point_cloud_transport/field_layout.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+const uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+//! mixes 64 bit word into hash (multiply and xor-shift, as in common hash finalizers)
+inline uint64_t mix(uint64_t hash, uint64_t word)
+{
+    hash ^= word;
+    hash *= 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 32);
+}
+
+} // namespace
+
+PointDeduplicator::PointDeduplicator(const sensor_msgs::PointCloud2& PC2, double tolerance, bool compare_attributes) :
+    PC2_(PC2), inverse_tolerance_(0.0)
+{
+    const int64_t position_offsets[] = {float32_field_offset(PC2, "x"), float32_field_offset(PC2, "y"), float32_field_offset(PC2, "z")};
+    const bool has_position = (position_offsets[0] >= 0) && (position_offsets[1] >= 0) && (position_offsets[2] >= 0);
+
+    // bytes of point covered by fields, padding does not make points different
+    const FieldLayout layout(PC2.fields, PC2.point_step);
+    std::vector<uint8_t> compared(PC2.point_step, 0);
+    for (size_t field_index = 0; field_index < PC2.fields.size(); field_index++)
+    {
+        if (layout.valid(field_index) && (layout.duplicate_of(field_index) < 0) && (compare_attributes || !has_position))
+        {
+            const sensor_msgs::PointField& field = PC2.fields[field_index];
+            std::fill(compared.begin() + field.offset, compared.begin() + field.offset + point_field_size(field), 1);
+        }
+    }
+    if (has_position)
+    {
+        for (int64_t offset : position_offsets)
+        {
+            // coordinates snapped to grid are not compared byte by byte
+            std::fill(compared.begin() + offset, compared.begin() + offset + sizeof(float), (tolerance > 0.0) ? 0 : 1);
+            if (tolerance > 0.0)
+            {
+                position_offsets_.push_back(offset);
+            }
+        }
+        inverse_tolerance_ = (tolerance > 0.0) ? 1.0 / tolerance : 0.0;
+    }
+
+    // runs of compared bytes
+    for (uint32_t byte = 0; byte < PC2.point_step; byte++)
+    {
+        if (!compared[byte])
+        {
+            continue;
+        }
+        if ((!exact_segments_.empty()) && (exact_segments_.back().first + exact_segments_.back().second == byte))
+        {
+            exact_segments_.back().second++;
+        }
+        else
+        {
+            exact_segments_.emplace_back(byte, 1);
+        }
+    }
+}
+
+uint32_t PointDeduplicator::deduplicate(uint32_t first_point, uint32_t number_of_points)
+{
+    const uint8_t* points = PC2_.data.data() + size_t(first_point) * PC2_.point_step;
+    const size_t point_step = PC2_.point_step;
+
+    // keys are hashed in one pass over the points, table is probed in a second one
+    hashes_.resize(number_of_points);
+    for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        hashes_[point_index] = hash(points + point_index * point_step);
+    }
+
+    // power of two table at most half full, linear probing keeps probes within few cache lines
+    size_t table_size = 16;
+    while (table_size < 2 * size_t(number_of_points))
+    {
+        table_size *= 2;
+    }
+    const size_t mask = table_size - 1;
+    table_.assign(table_size, EMPTY_SLOT);
+
+    unique_points_.clear();
+    point_map_.resize(number_of_points);
+    for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        const uint64_t point_hash = hashes_[point_index];
+        const uint8_t* point = points + point_index * point_step;
+        size_t slot = point_hash & mask;
+        while (true)
+        {
+            const uint32_t other_index = table_[slot];
+            if (other_index == EMPTY_SLOT)
+            {
+                // first point of its key
+                table_[slot] = point_index;
+                point_map_[point_index] = unique_points_.size();
+                unique_points_.push_back(point_index);
+                break;
+            }
+            if ((hashes_[other_index] == point_hash) && equal_keys(points + other_index * point_step, point))
+            {
+                point_map_[point_index] = point_map_[other_index];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    return unique_points_.size();
+}
+
+const std::vector<uint32_t>& PointDeduplicator::unique_points() const
+{
+    return unique_points_;
+}
+
+const std::vector<int32_t>& PointDeduplicator::point_map() const
+{
+    return point_map_;
+}
+
+void PointDeduplicator::gather(uint32_t first_point, std::vector<uint8_t>& out_data) const
+{
+    const uint8_t* points = PC2_.data.data() + size_t(first_point) * PC2_.point_step;
+    const size_t point_step = PC2_.point_step;
+
+    out_data.resize(unique_points_.size() * point_step);
+    uint8_t* out_point = out_data.data();
+    for (uint32_t point_index : unique_points_)
+    {
+        std::memcpy(out_point, points + point_index * point_step, point_step);
+        out_point += point_step;
+    }
+}
+
+uint64_t PointDeduplicator::hash(const uint8_t* point) const
+{
+    uint64_t point_hash = 0;
+    for (uint32_t offset : position_offsets_)
+    {
+        point_hash = mix(point_hash, uint64_t(cell(point, offset)));
+    }
+    for (const std::pair<uint32_t, uint32_t>& segment : exact_segments_)
+    {
+        // whole 64 bit words, then the remaining bytes
+        const uint8_t* bytes = point + segment.first;
+        uint32_t size = segment.second;
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes, sizeof(uint64_t));
+            point_hash = mix(point_hash, word);
+        }
+        if (size > 0)
+        {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes, size);
+            point_hash = mix(point_hash, word);
+        }
+    }
+    return point_hash;
+}
+
+bool PointDeduplicator::equal_keys(const uint8_t* a, const uint8_t* b) const
+{
+    for (uint32_t offset : position_offsets_)
+    {
+        if (cell(a, offset) != cell(b, offset))
+        {
+            return false;
+        }
+    }
+    for (const std::pair<uint32_t, uint32_t>& segment : exact_segments_)
+    {
+        if (std::memcmp(a + segment.first, b + segment.first, segment.second) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t PointDeduplicator::cell(const uint8_t* point, uint32_t offset) const
+{
+    float value;
+    std::memcpy(&value, point + offset, sizeof(float));
+    const double scaled = std::floor(double(value) * inverse_tolerance_);
+    // cells of finite values stay below 2^62, non-finite values are keyed by their bits above
+    if (std::isfinite(scaled) && (std::abs(scaled) < double(int64_t(1) << 62)))
+    {
+        return int64_t(scaled);
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+    return (int64_t(1) << 62) + bits;
+}
+
+} //namespace draco_point_cloud_transport
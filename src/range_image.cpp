@@ -0,0 +1,566 @@
+#include "draco_point_cloud_transport/range_image.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
+
+#include <ros/ros.h>
+
+// draco
+#include <draco/point_cloud/point_cloud_builder.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+//! attributes preceding attributes of other fields
+enum RangeImageAttribute
+{
+    RANGE = 0,
+    AZIMUTH_RESIDUAL = 1,
+    ELEVATION_RESIDUAL = 2,
+    NUMBER_OF_RANGE_IMAGE_ATTRIBUTES = 3
+};
+
+//! finds index of float32 field with one component, -1 if there is none
+int find_float32_field(const sensor_msgs::PointCloud2& PC2, const std::string& name)
+{
+    for (size_t field_index = 0; field_index < PC2.fields.size(); field_index++)
+    {
+        const sensor_msgs::PointField& field = PC2.fields[field_index];
+        if ((field.name == name) && (field.datatype == sensor_msgs::PointField::FLOAT32) && (field.count == 1))
+        {
+            return field_index;
+        }
+    }
+    return -1;
+}
+
+void append_varint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+bool read_varint(const std::vector<uint8_t>& in, size_t& position, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; (shift < 64) && (position < in.size()); shift += 7)
+    {
+        const uint8_t byte = in[position++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//! table values are stored as zigzag coded differences to the previous value, neighbouring entries differ only slightly
+std::vector<uint8_t> encode_table(const std::vector<int32_t>& table)
+{
+    std::vector<uint8_t> encoded;
+    int64_t previous = 0;
+    for (int32_t value : table)
+    {
+        const int64_t difference = int64_t(value) - previous;
+        append_varint(encoded, (uint64_t(difference) << 1) ^ uint64_t(difference >> 63));
+        previous = value;
+    }
+    return encoded;
+}
+
+bool decode_table(const std::vector<uint8_t>& encoded, size_t size, std::vector<int32_t>& table)
+{
+    table.resize(size);
+    size_t position = 0;
+    int64_t previous = 0;
+    for (size_t index = 0; index < size; index++)
+    {
+        uint64_t zigzag;
+        if (!read_varint(encoded, position, zigzag))
+        {
+            return false;
+        }
+        previous += int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+        table[index] = int32_t(previous);
+    }
+    return true;
+}
+
+//! validity of points is stored as lengths of alternating runs of valid and invalid points, starting with valid
+std::vector<uint8_t> encode_validity(const std::vector<uint8_t>& valid)
+{
+    std::vector<uint8_t> encoded;
+    uint8_t current = 1;
+    uint64_t run = 0;
+    for (uint8_t point_valid : valid)
+    {
+        if (point_valid != current)
+        {
+            append_varint(encoded, run);
+            current = point_valid;
+            run = 0;
+        }
+        run++;
+    }
+    append_varint(encoded, run);
+    return encoded;
+}
+
+bool decode_validity(const std::vector<uint8_t>& encoded, size_t size, std::vector<uint8_t>& valid)
+{
+    valid.clear();
+    valid.reserve(size);
+    size_t position = 0;
+    uint8_t current = 1;
+    while (position < encoded.size())
+    {
+        uint64_t run;
+        if ((!read_varint(encoded, position, run)) || (run > size - valid.size()))
+        {
+            return false;
+        }
+        valid.insert(valid.end(), run, current);
+        current = 1 - current;
+    }
+    return valid.size() == size;
+}
+
+//! maps angle into (-pi, pi]
+double wrap_angle(double angle)
+{
+    while (angle > M_PI)
+    {
+        angle -= 2.0 * M_PI;
+    }
+    while (angle <= -M_PI)
+    {
+        angle += 2.0 * M_PI;
+    }
+    return angle;
+}
+
+int32_t round_to_int(double value)
+{
+    return int32_t(std::floor(value + 0.5));
+}
+
+} // namespace
+
+PC2toRangeImage::PC2toRangeImage(const sensor_msgs::PointCloud2& PC2, const EncodingPlan& plan) : PC2_(PC2), plan_(plan)
+{
+}
+
+bool PC2toRangeImage::compatible(const sensor_msgs::PointCloud2& PC2)
+{
+    return (PC2.height > 1) && (find_float32_field(PC2, "x") >= 0) && (find_float32_field(PC2, "y") >= 0) && (find_float32_field(PC2, "z") >= 0);
+}
+
+std::unique_ptr<draco::PointCloud> PC2toRangeImage::convert(int bits) const
+{
+    const uint32_t height = PC2_.height;
+    const uint32_t width = PC2_.width;
+    const size_t number_of_points = size_t(height) * width;
+    const int x_index = find_float32_field(PC2_, "x");
+    const int y_index = find_float32_field(PC2_, "y");
+    const int z_index = find_float32_field(PC2_, "z");
+
+    if ((x_index < 0) || (y_index < 0) || (z_index < 0) || (PC2_.data.size() < number_of_points * PC2_.point_step) ||
+        (plan_.fields().size() != PC2_.fields.size()))
+    {
+        ROS_ERROR_STREAM("Organized sensor_msgs::PointCloud2 can not be converted into range image!");
+        return nullptr;
+    }
+
+    // larger quantized angles would not fit into int32
+    bits = std::max(1, std::min(bits, 24));
+
+    // spherical coordinates of all points
+    std::vector<uint8_t> valid(number_of_points, 0);
+    std::vector<double> ranges(number_of_points, 0.0);
+    std::vector<double> azimuths(number_of_points, 0.0);
+    std::vector<double> elevations(number_of_points, 0.0);
+    double max_range = 0.0;
+    uint32_t number_of_valid_points = 0;
+
+    for (size_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        const uint8_t* point_data = PC2_.data.data() + point_index * PC2_.point_step;
+        float x, y, z;
+        std::memcpy(&x, point_data + PC2_.fields[x_index].offset, sizeof(float));
+        std::memcpy(&y, point_data + PC2_.fields[y_index].offset, sizeof(float));
+        std::memcpy(&z, point_data + PC2_.fields[z_index].offset, sizeof(float));
+        if (!(std::isfinite(x) && std::isfinite(y) && std::isfinite(z)))
+        {
+            continue;
+        }
+        valid[point_index] = 1;
+        number_of_valid_points++;
+
+        const double range = std::sqrt(double(x) * x + double(y) * y + double(z) * z);
+        ranges[point_index] = range;
+        if (range > 0.0)
+        {
+            azimuths[point_index] = std::atan2(double(y), double(x));
+            elevations[point_index] = std::asin(std::max(-1.0, std::min(1.0, z / range)));
+        }
+        max_range = std::max(max_range, range);
+    }
+    if (max_range == 0.0)
+    {
+        max_range = 1.0;
+    }
+
+    // angular step of range_step / max_range bounds position error of angles by range_step
+    const double max_quantized_range = double((uint64_t(1) << bits) - 1);
+    const double range_step = max_range / max_quantized_range;
+    const double angle_step = 1.0 / max_quantized_range;
+
+    // tables hold angle of first valid point of each column and row, columns and rows without valid point repeat previous entry
+    std::vector<int32_t> azimuth_table(width, 0);
+    std::vector<int32_t> elevation_table(height, 0);
+    std::vector<uint8_t> azimuth_set(width, 0);
+    std::vector<uint8_t> elevation_set(height, 0);
+    for (uint32_t row = 0; row < height; row++)
+    {
+        for (uint32_t column = 0; column < width; column++)
+        {
+            const size_t point_index = size_t(row) * width + column;
+            if ((!valid[point_index]) || (ranges[point_index] == 0.0))
+            {
+                continue;
+            }
+            if (!azimuth_set[column])
+            {
+                azimuth_table[column] = round_to_int(azimuths[point_index] / angle_step);
+                azimuth_set[column] = 1;
+            }
+            if (!elevation_set[row])
+            {
+                elevation_table[row] = round_to_int(elevations[point_index] / angle_step);
+                elevation_set[row] = 1;
+            }
+        }
+    }
+    for (uint32_t column = 1; column < width; column++)
+    {
+        if (!azimuth_set[column])
+        {
+            azimuth_table[column] = azimuth_table[column - 1];
+        }
+    }
+    for (uint32_t row = 1; row < height; row++)
+    {
+        if (!elevation_set[row])
+        {
+            elevation_table[row] = elevation_table[row - 1];
+        }
+    }
+
+    // quantized range and angle residuals of valid points in row-major order
+    std::vector<uint32_t> quantized_ranges;
+    std::vector<int32_t> azimuth_residuals;
+    std::vector<int32_t> elevation_residuals;
+    quantized_ranges.reserve(number_of_valid_points);
+    azimuth_residuals.reserve(number_of_valid_points);
+    elevation_residuals.reserve(number_of_valid_points);
+    for (uint32_t row = 0; row < height; row++)
+    {
+        for (uint32_t column = 0; column < width; column++)
+        {
+            const size_t point_index = size_t(row) * width + column;
+            if (!valid[point_index])
+            {
+                continue;
+            }
+            quantized_ranges.push_back(uint32_t(std::floor(ranges[point_index] / range_step + 0.5)));
+            if (ranges[point_index] == 0.0)
+            {
+                azimuth_residuals.push_back(0);
+                elevation_residuals.push_back(0);
+                continue;
+            }
+            azimuth_residuals.push_back(round_to_int(wrap_angle(azimuths[point_index] - azimuth_table[column] * angle_step) / angle_step));
+            elevation_residuals.push_back(round_to_int((elevations[point_index] - elevation_table[row] * angle_step) / angle_step));
+        }
+    }
+
+    draco::PointCloudBuilder builder;
+    builder.Start(number_of_valid_points);
+
+    const int range_id = builder.AddAttribute(draco::GeometryAttribute::GENERIC, 1, draco::DT_UINT32);
+    const int azimuth_id = builder.AddAttribute(draco::GeometryAttribute::GENERIC, 1, draco::DT_INT32);
+    const int elevation_id = builder.AddAttribute(draco::GeometryAttribute::GENERIC, 1, draco::DT_INT32);
+    if (number_of_valid_points > 0)
+    {
+        builder.SetAttributeValuesForAllPoints(range_id, quantized_ranges.data(), 0);
+        builder.SetAttributeValuesForAllPoints(azimuth_id, azimuth_residuals.data(), 0);
+        builder.SetAttributeValuesForAllPoints(elevation_id, elevation_residuals.data(), 0);
+    }
+
+    // other fields of valid points; members of merged groups are read with the first field of their group and duplicates are
+    // restored from the field they duplicate, fields sharing attribute of a coordinate are encoded on their own
+    const std::vector<FieldEncoding>& encodings = plan_.fields();
+    const int coordinate_attributes[3] = {encodings[x_index].attribute_id, encodings[y_index].attribute_id, encodings[z_index].attribute_id};
+    // first field of each encoded attribute, attribute and its components holding each field
+    std::vector<int32_t> field_indices;
+    std::vector<int32_t> field_attributes(PC2_.fields.size(), -1);
+    std::vector<int32_t> field_components(2 * PC2_.fields.size(), 0);
+    std::vector<uint8_t> field_values;
+    for (size_t field_index = 0; field_index < PC2_.fields.size(); field_index++)
+    {
+        const FieldEncoding& encoding = encodings[field_index];
+        if ((int(field_index) == x_index) || (int(field_index) == y_index) || (int(field_index) == z_index) ||
+            (encoding.attribute_id < 0))
+        {
+            continue;
+        }
+        const bool coordinate_attribute = std::find(coordinate_attributes, coordinate_attributes + 3, encoding.attribute_id) != coordinate_attributes + 3;
+        if (!coordinate_attribute && !EncodingPlan::adds_attribute(encoding))
+        {
+            continue;
+        }
+        const sensor_msgs::PointField& field = PC2_.fields[field_index];
+        const int num_components = (!coordinate_attribute && (encoding.merged_components > 0)) ? encoding.merged_components : encoding.num_components;
+        const uint32_t value_size = uint32_t(num_components) * draco::DataTypeLength(encoding.attribute_data_type);
+
+        field_values.resize(size_t(number_of_valid_points) * value_size);
+        uint8_t* out_data = field_values.data();
+        for (size_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            if (valid[point_index])
+            {
+                std::memcpy(out_data, PC2_.data.data() + point_index * PC2_.point_step + field.offset, value_size);
+                out_data += value_size;
+            }
+        }
+
+        const int att_id = builder.AddAttribute(encoding.attribute_type, num_components, encoding.attribute_data_type);
+        if (number_of_valid_points > 0)
+        {
+            builder.SetAttributeValuesForAllPoints(att_id, field_values.data(), 0);
+        }
+        field_attributes[field_index] = int32_t(field_indices.size());
+        field_components[2 * field_index] = coordinate_attribute ? 0 : encoding.first_component;
+        field_components[2 * field_index + 1] = encoding.num_components;
+        field_indices.push_back(field_index);
+    }
+    // duplicates and members of merged groups share attribute of the field holding their values
+    for (size_t field_index = 0; field_index < PC2_.fields.size(); field_index++)
+    {
+        const FieldEncoding& encoding = encodings[field_index];
+        if ((field_attributes[field_index] >= 0) || (encoding.attribute_id < 0))
+        {
+            continue;
+        }
+        for (size_t holding_field = 0; holding_field < field_indices.size(); holding_field++)
+        {
+            const FieldEncoding& holding_encoding = encodings[field_indices[holding_field]];
+            if ((holding_encoding.attribute_id == encoding.attribute_id) && EncodingPlan::adds_attribute(holding_encoding))
+            {
+                field_attributes[field_index] = int32_t(holding_field);
+                field_components[2 * field_index] = encoding.first_component;
+                field_components[2 * field_index + 1] = encoding.num_components;
+                break;
+            }
+        }
+    }
+
+    // valid points must stay in order of validity bitmap
+    std::unique_ptr<draco::PointCloud> pc = builder.Finalize(false);
+    if (pc == nullptr)
+    {
+        ROS_FATAL_STREAM("Conversion of range image to Draco::PointCloud failed");
+        return pc;
+    }
+
+    std::unique_ptr<draco::GeometryMetadata> metadata =
+            std::unique_ptr<draco::GeometryMetadata>(new draco::GeometryMetadata());
+    metadata->AddEntryInt("deduplicate", 0);
+    metadata->AddEntryInt("range_image", 1);
+    metadata->AddEntryInt("range_image_bits", bits);
+    metadata->AddEntryDouble("range_image_max_range", max_range);
+    metadata->AddEntryBinary("range_image_validity", encode_validity(valid));
+    metadata->AddEntryBinary("range_image_azimuth", encode_table(azimuth_table));
+    metadata->AddEntryBinary("range_image_elevation", encode_table(elevation_table));
+    metadata->AddEntryIntArray("range_image_fields", field_indices);
+    metadata->AddEntryIntArray("range_image_field_attributes", field_attributes);
+    metadata->AddEntryIntArray("range_image_field_components", field_components);
+    pc->AddMetadata(std::move(metadata));
+
+    return pc;
+}
+
+RangeImagetoPC2::RangeImagetoPC2(const draco::PointCloud& pc, const draco_point_cloud_transport::CompressedPointCloud2& compressed) :
+    pc_(pc), compressed_(compressed)
+{
+}
+
+bool RangeImagetoPC2::is_range_image(const draco::PointCloud& pc)
+{
+    int32_t range_image = 0;
+    return (pc.metadata() != nullptr) && pc.metadata()->GetEntryInt("range_image", &range_image) && (range_image == 1);
+}
+
+bool RangeImagetoPC2::convert(const std::vector<std::string>& field_names, sensor_msgs::PointCloud2& PC2) const
+{
+    const uint32_t height = compressed_.height;
+    const uint32_t width = compressed_.width;
+    const size_t number_of_points = size_t(height) * width;
+    const draco::GeometryMetadata* metadata = pc_.metadata();
+
+    int32_t bits = 0;
+    double max_range = 0.0;
+    std::vector<uint8_t> encoded_validity, encoded_azimuth, encoded_elevation;
+    std::vector<int32_t> field_indices;
+    std::vector<uint8_t> valid;
+    std::vector<int32_t> azimuth_table, elevation_table;
+    if ((metadata == nullptr) || !(metadata->GetEntryInt("range_image_bits", &bits) && metadata->GetEntryDouble("range_image_max_range", &max_range) &&
+                                   metadata->GetEntryBinary("range_image_validity", &encoded_validity) &&
+                                   metadata->GetEntryBinary("range_image_azimuth", &encoded_azimuth) &&
+                                   metadata->GetEntryBinary("range_image_elevation", &encoded_elevation) &&
+                                   metadata->GetEntryIntArray("range_image_fields", &field_indices)) ||
+        (bits < 1) || (bits > 24) || !decode_validity(encoded_validity, number_of_points, valid) ||
+        !decode_table(encoded_azimuth, width, azimuth_table) || !decode_table(encoded_elevation, height, elevation_table) ||
+        (size_t(pc_.num_attributes()) != NUMBER_OF_RANGE_IMAGE_ATTRIBUTES + field_indices.size()) ||
+        (size_t(std::count(valid.begin(), valid.end(), 1)) != pc_.num_points()))
+    {
+        ROS_ERROR_STREAM("In point_cloud_transport::RangeImagetoPC2, range image is corrupted!");
+        return false;
+    }
+
+    const double max_quantized_range = double((uint64_t(1) << bits) - 1);
+    const double range_step = max_range / max_quantized_range;
+    const double angle_step = 1.0 / max_quantized_range;
+
+    // organized output layout, optionally projected to requested fields
+    std::vector<int> output_field_index;
+    assign_description_of_PointCloud2(PC2, compressed_);
+    project_fields(compressed_.fields, compressed_.point_step, field_names, PC2.fields, PC2.point_step, output_field_index);
+    PC2.row_step = width * PC2.point_step;
+    PC2.data.clear();
+    PC2.data.resize(number_of_points * PC2.point_step);
+
+    // offsets of delivered coordinates, -1 if not delivered
+    int coordinate_offsets[3] = {-1, -1, -1};
+    const char* coordinate_names[3] = {"x", "y", "z"};
+    for (size_t field_index = 0; field_index < compressed_.fields.size(); field_index++)
+    {
+        for (int coordinate = 0; coordinate < 3; coordinate++)
+        {
+            if ((compressed_.fields[field_index].name == coordinate_names[coordinate]) && (output_field_index[field_index] >= 0))
+            {
+                coordinate_offsets[coordinate] = PC2.fields[output_field_index[field_index]].offset;
+            }
+        }
+    }
+
+    const draco::PointAttribute* range_attribute = pc_.attribute(RANGE);
+    const draco::PointAttribute* azimuth_attribute = pc_.attribute(AZIMUTH_RESIDUAL);
+    const draco::PointAttribute* elevation_attribute = pc_.attribute(ELEVATION_RESIDUAL);
+
+    // coordinates of valid points from spherical coordinates, NaN for invalid points
+    draco::PointIndex valid_index(0);
+    for (uint32_t row = 0; row < height; row++)
+    {
+        for (uint32_t column = 0; column < width; column++)
+        {
+            const size_t point_index = size_t(row) * width + column;
+            uint8_t* point_data = PC2.data.data() + point_index * PC2.point_step;
+            float coordinates[3];
+            if (valid[point_index])
+            {
+                uint32_t quantized_range;
+                int32_t azimuth_residual, elevation_residual;
+                std::memcpy(&quantized_range, range_attribute->GetAddress(range_attribute->mapped_index(valid_index)), sizeof(uint32_t));
+                std::memcpy(&azimuth_residual, azimuth_attribute->GetAddress(azimuth_attribute->mapped_index(valid_index)), sizeof(int32_t));
+                std::memcpy(&elevation_residual, elevation_attribute->GetAddress(elevation_attribute->mapped_index(valid_index)), sizeof(int32_t));
+                ++valid_index;
+
+                const double range = quantized_range * range_step;
+                const double azimuth = (double(azimuth_table[column]) + azimuth_residual) * angle_step;
+                const double elevation = (double(elevation_table[row]) + elevation_residual) * angle_step;
+                const double planar_range = range * std::cos(elevation);
+                coordinates[0] = float(planar_range * std::cos(azimuth));
+                coordinates[1] = float(planar_range * std::sin(azimuth));
+                coordinates[2] = float(range * std::sin(elevation));
+            }
+            else
+            {
+                coordinates[0] = coordinates[1] = coordinates[2] = std::numeric_limits<float>::quiet_NaN();
+            }
+            for (int coordinate = 0; coordinate < 3; coordinate++)
+            {
+                if (coordinate_offsets[coordinate] >= 0)
+                {
+                    std::memcpy(point_data + coordinate_offsets[coordinate], &coordinates[coordinate], sizeof(float));
+                }
+            }
+        }
+    }
+
+    // attribute and its components holding each field; range images without these entries hold one attribute per field
+    std::vector<int32_t> field_attributes, field_components;
+    if (!(metadata->GetEntryIntArray("range_image_field_attributes", &field_attributes) &&
+          metadata->GetEntryIntArray("range_image_field_components", &field_components)) ||
+        (field_attributes.size() != compressed_.fields.size()) || (field_components.size() != 2 * compressed_.fields.size()))
+    {
+        field_attributes.assign(compressed_.fields.size(), -1);
+        field_components.assign(2 * compressed_.fields.size(), 0);
+        for (size_t field = 0; field < field_indices.size(); field++)
+        {
+            const int32_t field_index = field_indices[field];
+            if ((field_index >= 0) && (size_t(field_index) < compressed_.fields.size()))
+            {
+                field_attributes[field_index] = int32_t(field);
+                field_components[2 * field_index + 1] = pc_.attribute(NUMBER_OF_RANGE_IMAGE_ATTRIBUTES + field)->num_components();
+            }
+        }
+    }
+
+    // other fields of valid points, invalid points keep zeros
+    for (size_t field_index = 0; field_index < compressed_.fields.size(); field_index++)
+    {
+        const int32_t field = field_attributes[field_index];
+        if ((field < 0) || (size_t(field) >= field_indices.size()) || (output_field_index[field_index] < 0))
+        {
+            continue;
+        }
+        const draco::PointAttribute* attribute = pc_.attribute(NUMBER_OF_RANGE_IMAGE_ATTRIBUTES + field);
+        const sensor_msgs::PointField& output_field = PC2.fields[output_field_index[field_index]];
+        const int32_t first_component = field_components[2 * field_index];
+        const int32_t number_of_components = field_components[2 * field_index + 1];
+        const uint32_t component_size = draco::DataTypeLength(attribute->data_type());
+        const uint32_t value_size = uint32_t(std::max(number_of_components, 0)) * component_size;
+        if ((first_component < 0) || (number_of_components <= 0) || (first_component + number_of_components > attribute->num_components()) ||
+            (value_size != point_field_size(output_field)) || (output_field.offset + value_size > PC2.point_step))
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::RangeImagetoPC2, attribute of field " << field_index << " does not fit into point_step of PointCloud2!");
+            continue;
+        }
+
+        draco::PointIndex value_index(0);
+        for (size_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            if (valid[point_index])
+            {
+                std::memcpy(PC2.data.data() + point_index * PC2.point_step + output_field.offset,
+                            attribute->GetAddress(attribute->mapped_index(value_index)) + first_component * component_size, value_size);
+                ++value_index;
+            }
+        }
+    }
+    return true;
+}
+
+} //namespace draco_point_cloud_transport
@@ -0,0 +1,136 @@
+#include "draco_point_cloud_transport/rate_control.h"
+
+#include <algorithm>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+//! weight of new measurement in smoothed measurements
+const double SMOOTHING = 0.3;
+
+//! number of messages measured with new settings before settings change again
+const unsigned SETTLE_FRAMES = 5;
+
+//! reduces quantization bits down to min_bits, settings already below min_bits are kept
+int reduce_bits(int bits, int reduction, int min_bits)
+{
+    return (bits <= min_bits) ? bits : std::max(min_bits, bits - reduction);
+}
+
+} // namespace
+
+RateController::RateController() : encode_speed_(0), quantization_reduction_(0), average_bytes_(0.0), average_encode_seconds_(0.0),
+    average_interval_(0.0), has_measurement_(false), frames_since_change_(0)
+{
+}
+
+void RateController::reset(const DracoPublisherConfig& config)
+{
+    encode_speed_ = std::max(std::min(config.min_encode_speed, config.max_encode_speed),
+                             std::min(config.encode_speed, std::max(config.min_encode_speed, config.max_encode_speed)));
+    quantization_reduction_ = 0;
+    has_measurement_ = false;
+    frames_since_change_ = 0;
+}
+
+bool RateController::update(const DracoPublisherConfig& config, size_t compressed_bytes, double encode_seconds, std::chrono::steady_clock::time_point now)
+{
+    if (!has_measurement_)
+    {
+        average_bytes_ = compressed_bytes;
+        average_encode_seconds_ = encode_seconds;
+        average_interval_ = 0.0;
+        last_update_ = now;
+        has_measurement_ = true;
+        return false;
+    }
+
+    const double interval = std::chrono::duration<double>(now - last_update_).count();
+    last_update_ = now;
+    average_bytes_ += SMOOTHING * (double(compressed_bytes) - average_bytes_);
+    average_encode_seconds_ += SMOOTHING * (encode_seconds - average_encode_seconds_);
+    average_interval_ = (average_interval_ == 0.0) ? interval : average_interval_ + SMOOTHING * (interval - average_interval_);
+
+    if (++frames_since_change_ < SETTLE_FRAMES)
+    {
+        return false;
+    }
+
+    const int min_speed = std::min(config.min_encode_speed, config.max_encode_speed);
+    const int max_speed = std::max(config.min_encode_speed, config.max_encode_speed);
+    // settings are improved only when measurements are below target by hysteresis, which prevents oscillation
+    const double lower_bound = 1.0 - config.rate_control_hysteresis;
+    const bool latency_control = config.max_encode_latency > 0.0;
+    const bool bandwidth_control = (config.target_bandwidth > 0.0) && (average_interval_ > 0.0);
+    const double latency = average_encode_seconds_ * 1000.0;
+    const bool latency_headroom = (!latency_control) || (latency < lower_bound * config.max_encode_latency);
+
+    const int previous_speed = encode_speed_;
+    const int previous_reduction = quantization_reduction_;
+
+    // encoder must keep up first, faster speed
+    if (latency_control && (latency > config.max_encode_latency) && (encode_speed_ < max_speed))
+    {
+        encode_speed_++;
+    }
+    else if (bandwidth_control)
+    {
+        const double bandwidth = average_bytes_ / average_interval_;
+        if (bandwidth > config.target_bandwidth)
+        {
+            // coarser quantization first, then slower speed with better compression
+            if (quantization_reduction_ < max_quantization_reduction(config))
+            {
+                quantization_reduction_++;
+            }
+            else if (latency_headroom && (encode_speed_ > min_speed))
+            {
+                encode_speed_--;
+            }
+        }
+        else if ((bandwidth < lower_bound * config.target_bandwidth) && (quantization_reduction_ > 0))
+        {
+            quantization_reduction_--;
+        }
+    }
+    else if (latency_control && latency_headroom && (encode_speed_ > min_speed))
+    {
+        // spare encode time is spent on better compression
+        encode_speed_--;
+    }
+
+    if ((encode_speed_ == previous_speed) && (quantization_reduction_ == previous_reduction))
+    {
+        return false;
+    }
+    frames_since_change_ = 0;
+    return true;
+}
+
+void RateController::apply(DracoPublisherConfig& config) const
+{
+    const int min_bits = config.min_quantization_bits;
+    config.encode_speed = encode_speed_;
+    config.quantization_POSITION = reduce_bits(config.quantization_POSITION, quantization_reduction_, min_bits);
+    config.quantization_NORMAL = reduce_bits(config.quantization_NORMAL, quantization_reduction_, min_bits);
+    config.quantization_COLOR = reduce_bits(config.quantization_COLOR, quantization_reduction_, min_bits);
+    config.quantization_TEX_COORD = reduce_bits(config.quantization_TEX_COORD, quantization_reduction_, min_bits);
+    config.quantization_GENERIC = reduce_bits(config.quantization_GENERIC, quantization_reduction_, min_bits);
+}
+
+int RateController::max_quantization_reduction(const DracoPublisherConfig& config)
+{
+    // quantization bits are used only by these modes
+    if (!(config.force_quantization || config.range_image || config.temporal_mode) || config.lossless)
+    {
+        return 0;
+    }
+    const int max_bits = std::max({config.quantization_POSITION, config.quantization_NORMAL, config.quantization_COLOR,
+                                   config.quantization_TEX_COORD, config.quantization_GENERIC});
+    return std::max(0, max_bits - config.min_quantization_bits);
+}
+
+} //namespace draco_point_cloud_transport
@@ -0,0 +1,163 @@
+#include "draco_point_cloud_transport/region_filter.h"
+#include "draco_point_cloud_transport/conversion_utilities.h"
+#include "draco_point_cloud_transport/point_deduplication.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+//! points classified at once, coordinates of a block stay in L1 cache
+const uint32_t BLOCK_POINTS = 256;
+
+} // namespace
+
+RegionFilter::RegionFilter(const DracoPublisherConfig& config) :
+    box_(config.roi_box), range_((config.roi_min_range > 0.0) || (config.roi_max_range > 0.0)),
+    min_range_squared_(config.roi_min_range * config.roi_min_range),
+    max_range_squared_((config.roi_max_range > 0.0) ? config.roi_max_range * config.roi_max_range : INFINITY),
+    sector_(false), sector_wider_than_half_turn_(false), voxel_size_(config.roi_voxel_size)
+{
+    min_[0] = config.roi_min_x;
+    min_[1] = config.roi_min_y;
+    min_[2] = config.roi_min_z;
+    max_[0] = config.roi_max_x;
+    max_[1] = config.roi_max_y;
+    max_[2] = config.roi_max_z;
+
+    // sector from start to end azimuth counterclockwise, wraps around through +-180 degrees
+    double width = config.roi_max_azimuth - config.roi_min_azimuth;
+    if (width < 0.0)
+    {
+        width += 360.0;
+    }
+    sector_ = (width > 0.0) && (width < 360.0);
+    sector_wider_than_half_turn_ = width > 180.0;
+    const double start = config.roi_min_azimuth * M_PI / 180.0;
+    const double end = config.roi_max_azimuth * M_PI / 180.0;
+    start_direction_[0] = std::cos(start);
+    start_direction_[1] = std::sin(start);
+    end_direction_[0] = std::cos(end);
+    end_direction_[1] = std::sin(end);
+}
+
+bool RegionFilter::active() const
+{
+    return box_ || range_ || sector_ || (voxel_size_ > 0.0);
+}
+
+bool RegionFilter::apply(const sensor_msgs::PointCloud2& PC2, sensor_msgs::PointCloud2& out_PC2) const
+{
+    const int64_t offsets[] = {float32_field_offset(PC2, "x"), float32_field_offset(PC2, "y"), float32_field_offset(PC2, "z")};
+    if ((offsets[0] < 0) || (offsets[1] < 0) || (offsets[2] < 0))
+    {
+        return false;
+    }
+
+    const uint32_t number_of_points = PC2.height * PC2.width;
+    const size_t point_step = PC2.point_step;
+
+    out_PC2.header = PC2.header;
+    out_PC2.fields = PC2.fields;
+    out_PC2.is_bigendian = PC2.is_bigendian;
+    out_PC2.point_step = PC2.point_step;
+    out_PC2.is_dense = PC2.is_dense;
+    // data keeps its allocated storage if out_PC2 is recycled
+    out_PC2.data.resize(size_t(number_of_points) * point_step);
+
+    // coordinates are de-interleaved block by block, so classification runs over contiguous arrays without branches
+    float x[BLOCK_POINTS];
+    float y[BLOCK_POINTS];
+    float z[BLOCK_POINTS];
+    uint8_t keep[BLOCK_POINTS];
+
+    const uint8_t* in_data = PC2.data.data();
+    uint8_t* out_point = out_PC2.data.data();
+    for (uint32_t first_point = 0; first_point < number_of_points; first_point += BLOCK_POINTS)
+    {
+        const uint32_t block_points = std::min(BLOCK_POINTS, number_of_points - first_point);
+        const uint8_t* block_data = in_data + first_point * point_step;
+        for (uint32_t point_index = 0; point_index < block_points; point_index++)
+        {
+            const uint8_t* point = block_data + point_index * point_step;
+            std::memcpy(&x[point_index], point + offsets[0], sizeof(float));
+            std::memcpy(&y[point_index], point + offsets[1], sizeof(float));
+            std::memcpy(&z[point_index], point + offsets[2], sizeof(float));
+        }
+
+        classify(x, y, z, block_points, keep);
+
+        for (uint32_t point_index = 0; point_index < block_points; point_index++)
+        {
+            if (keep[point_index])
+            {
+                std::memcpy(out_point, block_data + point_index * point_step, point_step);
+                out_point += point_step;
+            }
+        }
+    }
+    uint32_t kept_points = (out_point - out_PC2.data.data()) / point_step;
+    out_PC2.data.resize(size_t(kept_points) * point_step);
+
+    // one point per voxel of kept points
+    if ((voxel_size_ > 0.0) && (kept_points > 0))
+    {
+        PointDeduplicator deduplicator(out_PC2, voxel_size_, false);
+        if (deduplicator.deduplicate(0, kept_points) < kept_points)
+        {
+            std::vector<uint8_t> voxel_data;
+            deduplicator.gather(0, voxel_data);
+            out_PC2.data.swap(voxel_data);
+            kept_points = deduplicator.unique_points().size();
+        }
+    }
+
+    out_PC2.height = 1;
+    out_PC2.width = kept_points;
+    out_PC2.row_step = kept_points * PC2.point_step;
+    return true;
+}
+
+void RegionFilter::classify(const float* x, const float* y, const float* z, uint32_t number_of_points, uint8_t* keep) const
+{
+    std::fill(keep, keep + number_of_points, 1);
+
+    // conditions are combined with bitwise and, comparisons with NaN are false
+    if (box_)
+    {
+        for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            keep[point_index] &= (x[point_index] >= min_[0]) & (x[point_index] <= max_[0]) &
+                                 (y[point_index] >= min_[1]) & (y[point_index] <= max_[1]) &
+                                 (z[point_index] >= min_[2]) & (z[point_index] <= max_[2]);
+        }
+    }
+
+    if (range_)
+    {
+        for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            const float range_squared = x[point_index] * x[point_index] + y[point_index] * y[point_index] + z[point_index] * z[point_index];
+            keep[point_index] &= (range_squared >= min_range_squared_) & (range_squared <= max_range_squared_);
+        }
+    }
+
+    // azimuth is compared by sides of bounding directions instead of atan2
+    if (sector_)
+    {
+        for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            // left of start direction: azimuth within half turn after start, right of end direction: within half turn before end
+            const uint8_t after_start = (start_direction_[0] * y[point_index] - start_direction_[1] * x[point_index]) >= 0.0f;
+            const uint8_t before_end = (end_direction_[1] * x[point_index] - end_direction_[0] * y[point_index]) >= 0.0f;
+            keep[point_index] &= sector_wider_than_half_turn_ ? (after_start | before_end) : (after_start & before_end);
+        }
+    }
+}
+
+} //namespace draco_point_cloud_transport
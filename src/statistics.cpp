@@ -0,0 +1,209 @@
+#include "draco_point_cloud_transport/statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+//! buckets per power of two
+const int BUCKETS_PER_OCTAVE = 8;
+
+//! smallest and largest power of two covered by buckets (about 1 ns to 1 TB)
+const int MIN_EXPONENT = -30;
+const int MAX_EXPONENT = 40;
+
+//! bucket 0 holds zero and values below 2^MIN_EXPONENT
+const size_t NUMBER_OF_BUCKETS = size_t(MAX_EXPONENT - MIN_EXPONENT) * BUCKETS_PER_OCTAVE + 1;
+
+} // namespace
+
+Histogram::Histogram() : buckets_(NUMBER_OF_BUCKETS, 0)
+{
+    reset();
+}
+
+void Histogram::add(double value)
+{
+    buckets_[bucket(value)]++;
+    count_++;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+void Histogram::reset()
+{
+    std::fill(buckets_.begin(), buckets_.end(), 0);
+    count_ = 0;
+    sum_ = 0.0;
+    min_ = std::numeric_limits<double>::max();
+    max_ = std::numeric_limits<double>::lowest();
+}
+
+void Histogram::fill(DracoMetric& metric) const
+{
+    metric.count = count_;
+    if (count_ == 0)
+    {
+        metric.mean = metric.min = metric.max = metric.p50 = metric.p90 = metric.p99 = 0.0;
+        return;
+    }
+    metric.mean = sum_ / count_;
+    metric.min = min_;
+    metric.max = max_;
+    metric.p50 = percentile(0.5);
+    metric.p90 = percentile(0.9);
+    metric.p99 = percentile(0.99);
+}
+
+size_t Histogram::bucket(double value)
+{
+    if (!(value >= std::ldexp(1.0, MIN_EXPONENT)))
+    {
+        return 0;
+    }
+    const double position = (std::log2(value) - MIN_EXPONENT) * BUCKETS_PER_OCTAVE;
+    return std::min(NUMBER_OF_BUCKETS - 1, size_t(position) + 1);
+}
+
+double Histogram::bucket_value(size_t bucket)
+{
+    if (bucket == 0)
+    {
+        return 0.0;
+    }
+    // geometric middle of bucket
+    return std::exp2(MIN_EXPONENT + (double(bucket) - 0.5) / BUCKETS_PER_OCTAVE);
+}
+
+double Histogram::percentile(double fraction) const
+{
+    const double rank = fraction * count_;
+    uint32_t cumulative = 0;
+    for (size_t bucket = 0; bucket < buckets_.size(); bucket++)
+    {
+        cumulative += buckets_[bucket];
+        if ((buckets_[bucket] > 0) && (cumulative >= rank))
+        {
+            // estimate never leaves the range of added values
+            return std::max(min_, std::min(max_, bucket_value(bucket)));
+        }
+    }
+    return max_;
+}
+
+Statistics::Statistics(const std::string& role, const std::vector<std::string>& metric_names, const std::vector<std::string>& metric_units) :
+    role_(role), metric_names_(metric_names), metric_units_(metric_units), histograms_(metric_names.size()), failures_(0),
+    period_start_(std::chrono::steady_clock::now()), period_(0.0)
+{
+}
+
+void Statistics::advertise(const ros::NodeHandle& nh)
+{
+    // publisher and subscriber plugins of one topic share namespace of nh
+    publisher_ = nh.advertise<DracoStatistics>("stats/" + role_, 1);
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    nh_ = nh;
+}
+
+void Statistics::set_period(double period)
+{
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    if (period == period_)
+    {
+        return;
+    }
+    timer_.stop();
+    timer_ = ros::WallTimer();
+    period_ = period;
+    if (period_ > 0.0)
+    {
+        {
+            std::lock_guard<std::mutex> metrics_lock(mutex_);
+            period_start_ = std::chrono::steady_clock::now();
+        }
+        timer_ = nh_.createWallTimer(ros::WallDuration(period_), &Statistics::publish, this);
+    }
+}
+
+void Statistics::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        timer_.stop();
+        timer_ = ros::WallTimer();
+        period_ = 0.0;
+    }
+    publisher_.shutdown();
+}
+
+void Statistics::add(size_t metric, double value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_[metric].add(value);
+}
+
+void Statistics::add_failure()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    failures_++;
+}
+
+void Statistics::publish(const ros::WallTimerEvent& event)
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    DracoStatistics statistics;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const double elapsed = std::chrono::duration<double>(now - period_start_).count();
+
+        statistics.header.stamp = ros::Time::now();
+        statistics.role = role_;
+        statistics.period = elapsed;
+        statistics.failures = failures_;
+        statistics.metrics.resize(histograms_.size());
+        for (size_t metric = 0; metric < histograms_.size(); metric++)
+        {
+            statistics.metrics[metric].name = metric_names_[metric];
+            statistics.metrics[metric].unit = metric_units_[metric];
+            histograms_[metric].fill(statistics.metrics[metric]);
+            histograms_[metric].reset();
+        }
+        failures_ = 0;
+        period_start_ = now;
+    }
+    publisher_.publish(statistics);
+}
+
+StageTimer::StageTimer(bool enabled) : enabled_(enabled)
+{
+    if (enabled_)
+    {
+        last_ = std::chrono::steady_clock::now();
+    }
+}
+
+double StageTimer::lap()
+{
+    if (!enabled_)
+    {
+        return 0.0;
+    }
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(now - last_).count();
+    last_ = now;
+    return seconds;
+}
+
+bool StageTimer::enabled() const
+{
+    return enabled_;
+}
+
+} //namespace draco_point_cloud_transport
@@ -0,0 +1,471 @@
+#include "draco_point_cloud_transport/temporal_coding.h"
+
+#include <ros/ros.h>
+
+// draco
+#include <draco/point_cloud/point_cloud_builder.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace draco_point_cloud_transport
+{
+
+namespace
+{
+
+//! reads unsigned value of size Bytes, zero extended
+uint32_t load_component(const uint8_t* data, uint32_t size)
+{
+    switch (size)
+    {
+        case 1 :
+            return *data;
+        case 2 :
+        {
+            uint16_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        default :
+        {
+            uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+    }
+}
+
+//! writes lowest size Bytes of value
+void store_component(uint8_t* data, uint32_t value, uint32_t size)
+{
+    switch (size)
+    {
+        case 1 :
+            *data = uint8_t(value);
+            break;
+        case 2 :
+        {
+            const uint16_t truncated = uint16_t(value);
+            std::memcpy(data, &truncated, sizeof(truncated));
+            break;
+        }
+        default :
+            std::memcpy(data, &value, sizeof(value));
+    }
+}
+
+//! mask of values with size Bytes, residuals wrap around at this width
+uint32_t component_mask(uint32_t size)
+{
+    return (size >= 4) ? std::numeric_limits<uint32_t>::max() : ((uint32_t(1) << (8 * size)) - 1);
+}
+
+//! draco data type of key frame values
+draco::DataType key_frame_data_type(uint32_t size)
+{
+    return (size == 1) ? draco::DT_UINT8 : ((size == 2) ? draco::DT_UINT16 : draco::DT_UINT32);
+}
+
+//! draco data type of delta frame residuals, signed so small negative residuals stay small
+draco::DataType delta_frame_data_type(uint32_t size)
+{
+    return (size == 1) ? draco::DT_INT8 : ((size == 2) ? draco::DT_INT16 : draco::DT_INT32);
+}
+
+//! non-finite values are stored as the value following the largest quantized value
+uint32_t invalid_quantized_value(int bits)
+{
+    return uint32_t(1) << bits;
+}
+
+} // namespace
+
+TemporalEncoder::TemporalEncoder() : layout_hash_(0), config_revision_(0), number_of_points_(0), frames_since_key_frame_(0),
+    sequence_(0), has_reference_(false)
+{
+}
+
+void TemporalEncoder::reset()
+{
+    has_reference_ = false;
+}
+
+std::unique_ptr<draco::PointCloud> TemporalEncoder::convert(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan,
+                                                            const DracoPublisherConfig& config, uint32_t config_revision,
+                                                            draco_point_cloud_transport::CompressedPointCloud2& compressed)
+{
+    const uint32_t number_of_points = message.height * message.width;
+    const size_t layout_hash = EncodingPlan::layout_hash(message);
+
+    // delta frames need a reference with the same points and fields
+    bool key_frame = (!has_reference_) || (layout_hash != layout_hash_) || (config_revision != config_revision_) ||
+                     (number_of_points != number_of_points_) || (frames_since_key_frame_ + 1 >= uint32_t(config.keyframe_interval));
+
+    std::vector<std::vector<uint32_t> > values(message.fields.size());
+    if (!key_frame)
+    {
+        for (size_t field_index = 0; field_index < message.fields.size(); field_index++)
+        {
+            // values left the range quantized by key frame
+            if (!read_field(message, message.fields[field_index], fields_[field_index], values[field_index]))
+            {
+                key_frame = true;
+                break;
+            }
+        }
+    }
+
+    if (key_frame)
+    {
+        if (!start_key_frame(message, plan, config))
+        {
+            has_reference_ = false;
+            return nullptr;
+        }
+        for (size_t field_index = 0; field_index < message.fields.size(); field_index++)
+        {
+            read_field(message, message.fields[field_index], fields_[field_index], values[field_index]);
+        }
+        layout_hash_ = layout_hash;
+        config_revision_ = config_revision;
+        number_of_points_ = number_of_points;
+        frames_since_key_frame_ = 0;
+    }
+    else
+    {
+        frames_since_key_frame_++;
+    }
+
+    draco::PointCloudBuilder builder;
+    builder.Start(number_of_points);
+
+    std::unique_ptr<draco::GeometryMetadata> metadata =
+            std::unique_ptr<draco::GeometryMetadata>(new draco::GeometryMetadata());
+
+    std::vector<uint8_t> attribute_values;
+    for (size_t field_index = 0; field_index < message.fields.size(); field_index++)
+    {
+        TemporalField& temporal_field = fields_[field_index];
+        std::vector<uint32_t>& field_values = values[field_index];
+        const uint32_t size = temporal_field.component_size;
+
+        // key frames hold values, delta frames residuals wrapped around at width of component
+        const draco::DataType data_type = key_frame ? key_frame_data_type(size) : delta_frame_data_type(size);
+        const int att_id = builder.AddAttribute(draco::GeometryAttribute::GENERIC, temporal_field.count, data_type);
+
+        attribute_values.resize(field_values.size() * size);
+        for (size_t value_index = 0; value_index < field_values.size(); value_index++)
+        {
+            const uint32_t value = key_frame ? field_values[value_index] : (field_values[value_index] - temporal_field.reference[value_index]);
+            store_component(&attribute_values[value_index * size], value, size);
+        }
+        if (!field_values.empty())
+        {
+            builder.SetAttributeValuesForAllPoints(att_id, attribute_values.data(), 0);
+        }
+
+        if (key_frame && (temporal_field.quantization.bits > 0))
+        {
+            add_quantization_metadata(*metadata, att_id, temporal_field.quantization);
+        }
+
+        // frame becomes reference of the next one
+        temporal_field.reference.swap(field_values);
+    }
+
+    // points must stay aligned with reference frame
+    std::unique_ptr<draco::PointCloud> pc = builder.Finalize(false);
+    if (pc == nullptr)
+    {
+        ROS_FATAL_STREAM("Conversion of temporal frame to Draco::PointCloud failed");
+        has_reference_ = false;
+        return pc;
+    }
+    metadata->AddEntryInt("deduplicate", 0);
+    pc->AddMetadata(std::move(metadata));
+
+    has_reference_ = true;
+    if (key_frame)
+    {
+        compressed.frame_type = CompressedPointCloud2::KEY_FRAME;
+    }
+    else
+    {
+        compressed.frame_type = CompressedPointCloud2::DELTA_FRAME;
+    }
+    compressed.frame_sequence = ++sequence_;
+    return pc;
+}
+
+bool TemporalEncoder::start_key_frame(const sensor_msgs::PointCloud2& message, const EncodingPlan& plan, const DracoPublisherConfig& config)
+{
+    const uint32_t number_of_points = message.height * message.width;
+    const std::vector<FieldEncoding>& encodings = plan.fields();
+
+    fields_.resize(message.fields.size());
+    for (size_t field_index = 0; field_index < message.fields.size(); field_index++)
+    {
+        const sensor_msgs::PointField& field = message.fields[field_index];
+        const FieldEncoding& encoding = encodings[field_index];
+        TemporalField& temporal_field = fields_[field_index];
+
+        temporal_field.count = field.count;
+        temporal_field.quantization.bits = 0;
+        temporal_field.reference.clear();
+
+        // fields are read in place, each of them must have known datatype and lie within point_step
+        if (encoding.attribute_id < 0)
+        {
+            ROS_WARN_STREAM_ONCE("Field " << field.name << " can not be coded temporally, sending independent frames instead.");
+            return false;
+        }
+
+        switch (field.datatype)
+        {
+            case sensor_msgs::PointField::INT8 :
+            case sensor_msgs::PointField::UINT8 :
+                temporal_field.component_size = 1;
+                break;
+            case sensor_msgs::PointField::INT16 :
+            case sensor_msgs::PointField::UINT16 :
+                temporal_field.component_size = 2;
+                break;
+            case sensor_msgs::PointField::INT32 :
+            case sensor_msgs::PointField::UINT32 :
+                temporal_field.component_size = 4;
+                break;
+            case sensor_msgs::PointField::FLOAT32 :
+            {
+                temporal_field.component_size = 4;
+                // packed rgb/rgba is not a number, it is coded as raw integer
+                if (encoding.rgba_tweak)
+                {
+                    break;
+                }
+                int bits = config.quantization_GENERIC;
+                switch (encoding.attribute_type)
+                {
+                    case draco::GeometryAttribute::POSITION :
+                        bits = config.quantization_POSITION;
+                        break;
+                    case draco::GeometryAttribute::NORMAL :
+                        bits = config.quantization_NORMAL;
+                        break;
+                    case draco::GeometryAttribute::COLOR :
+                        bits = config.quantization_COLOR;
+                        break;
+                    case draco::GeometryAttribute::TEX_COORD :
+                        bits = config.quantization_TEX_COORD;
+                        break;
+                    default :
+                        break;
+                }
+                if (config.expert_quantization && (encoding.expert_quantization_bits > 0))
+                {
+                    bits = encoding.expert_quantization_bits;
+                }
+                compute_quantization_parameters(message.data.data() + field.offset, number_of_points, field.count, message.point_step,
+                                                std::min(bits, 31), temporal_field.quantization);
+                break;
+            }
+            default :
+                ROS_WARN_STREAM_ONCE("Field " << field.name << " can not be coded temporally, sending independent frames instead.");
+                return false;
+        }
+    }
+    return true;
+}
+
+bool TemporalEncoder::read_field(const sensor_msgs::PointCloud2& message, const sensor_msgs::PointField& field, const TemporalField& temporal_field,
+                                 std::vector<uint32_t>& values)
+{
+    const uint32_t number_of_points = message.height * message.width;
+    const uint32_t count = temporal_field.count;
+    const uint32_t size = temporal_field.component_size;
+    const uint8_t* field_data = message.data.data() + field.offset;
+
+    values.resize(size_t(number_of_points) * count);
+    uint32_t* out_value = values.data();
+
+    // integer field, raw values
+    if (temporal_field.quantization.bits == 0)
+    {
+        for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            const uint8_t* point_data = field_data + size_t(point_index) * message.point_step;
+            for (uint32_t c = 0; c < count; c++)
+            {
+                *out_value++ = load_component(point_data + c * size, size);
+            }
+        }
+        return true;
+    }
+
+    // float32 field, quantized with parameters of key frame
+    const QuantizationParameters& params = temporal_field.quantization;
+    const double max_quantized_value = double((uint64_t(1) << params.bits) - 1);
+    const double scale = max_quantized_value / params.range;
+    const uint32_t invalid_value = invalid_quantized_value(params.bits);
+
+    for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+    {
+        const uint8_t* point_data = field_data + size_t(point_index) * message.point_step;
+        for (uint32_t c = 0; c < count; c++)
+        {
+            float value;
+            std::memcpy(&value, point_data + c * sizeof(float), sizeof(float));
+            if (!std::isfinite(value))
+            {
+                *out_value++ = invalid_value;
+                continue;
+            }
+            const double quantized = std::floor((double(value) - params.origin[c]) * scale + 0.5);
+            if ((quantized < 0.0) || (quantized > max_quantized_value))
+            {
+                return false;
+            }
+            *out_value++ = uint32_t(quantized);
+        }
+    }
+    return true;
+}
+
+TemporalDecoder::TemporalDecoder() : number_of_points_(0), sequence_(0), has_reference_(false)
+{
+}
+
+bool TemporalDecoder::convert(const draco::PointCloud& pc, const draco_point_cloud_transport::CompressedPointCloud2& compressed,
+                              const std::vector<std::string>& field_names, sensor_msgs::PointCloud2& PC2)
+{
+    const uint32_t number_of_points = pc.num_points();
+    const bool key_frame = (compressed.frame_type == CompressedPointCloud2::KEY_FRAME);
+
+    if ((size_t(pc.num_attributes()) != compressed.fields.size()) || (number_of_points != compressed.height * compressed.width))
+    {
+        ROS_ERROR_STREAM("In point_cloud_transport::TemporalDecoder, temporal frame does not match description of CompressedPointCloud2!");
+        has_reference_ = false;
+        return false;
+    }
+
+    // delta frame must directly follow the reference frame
+    if ((!key_frame) && ((!has_reference_) || (compressed.frame_sequence != sequence_ + 1) || (number_of_points != number_of_points_) ||
+                         (fields_.size() != compressed.fields.size())))
+    {
+        has_reference_ = false;
+        return false;
+    }
+
+    if (key_frame)
+    {
+        fields_.resize(compressed.fields.size());
+        number_of_points_ = number_of_points;
+    }
+
+    for (int32_t att_id = 0; att_id < pc.num_attributes(); att_id++)
+    {
+        const draco::PointAttribute* attribute = pc.attribute(att_id);
+        TemporalField& temporal_field = fields_[att_id];
+        const uint32_t size = draco::DataTypeLength(attribute->data_type());
+
+        if (key_frame)
+        {
+            temporal_field.count = attribute->num_components();
+            temporal_field.component_size = size;
+            temporal_field.quantization.bits = 0;
+            if ((pc.metadata() == nullptr) || !get_quantization_metadata(*pc.metadata(), att_id, temporal_field.quantization))
+            {
+                temporal_field.quantization.bits = 0;
+            }
+            temporal_field.reference.resize(size_t(number_of_points) * temporal_field.count);
+        }
+        else if ((uint32_t(attribute->num_components()) != temporal_field.count) || (size != temporal_field.component_size))
+        {
+            has_reference_ = false;
+            return false;
+        }
+
+        // key frame replaces reference, residuals of delta frame are added to it
+        const uint32_t mask = component_mask(size);
+        uint32_t* reference = temporal_field.reference.data();
+        for (draco::PointIndex point_index(0); point_index < draco::PointIndex(number_of_points); ++point_index)
+        {
+            const uint8_t* point_data = attribute->GetAddress(attribute->mapped_index(point_index));
+            for (uint32_t c = 0; c < temporal_field.count; c++)
+            {
+                const uint32_t value = load_component(point_data + c * size, size);
+                *reference = key_frame ? value : ((*reference + value) & mask);
+                reference++;
+            }
+        }
+    }
+    sequence_ = compressed.frame_sequence;
+    has_reference_ = true;
+
+    // output layout, optionally projected to requested fields
+    std::vector<int> output_field_index;
+    assign_description_of_PointCloud2(PC2, compressed);
+    project_fields(compressed.fields, compressed.point_step, field_names, PC2.fields, PC2.point_step, output_field_index);
+    PC2.row_step = PC2.width * PC2.point_step;
+    PC2.data.clear();
+    PC2.data.resize(size_t(number_of_points) * PC2.point_step);
+
+    for (size_t field_index = 0; field_index < fields_.size(); field_index++)
+    {
+        if (output_field_index[field_index] < 0)
+        {
+            continue;
+        }
+        const sensor_msgs::PointField& output_field = PC2.fields[output_field_index[field_index]];
+        const TemporalField& temporal_field = fields_[field_index];
+        if ((output_field.count != temporal_field.count) || (point_field_size(output_field) != temporal_field.count * temporal_field.component_size) ||
+            (output_field.offset + point_field_size(output_field) > PC2.point_step))
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::TemporalDecoder, attribute " << field_index << " does not fit into point_step of PointCloud2!");
+            continue;
+        }
+
+        uint8_t* field_data = PC2.data.data() + output_field.offset;
+        const uint32_t* value = temporal_field.reference.data();
+
+        // integer field, raw values
+        if (temporal_field.quantization.bits == 0)
+        {
+            for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+            {
+                uint8_t* point_data = field_data + size_t(point_index) * PC2.point_step;
+                for (uint32_t c = 0; c < temporal_field.count; c++)
+                {
+                    store_component(point_data + c * temporal_field.component_size, *value++, temporal_field.component_size);
+                }
+            }
+            continue;
+        }
+
+        // float32 field, dequantized
+        const QuantizationParameters& params = temporal_field.quantization;
+        if (params.origin.size() != temporal_field.count)
+        {
+            ROS_ERROR_STREAM("In point_cloud_transport::TemporalDecoder, quantized attribute " << field_index << " could not be dequantized!");
+            continue;
+        }
+        const double scale = params.range / double((uint64_t(1) << params.bits) - 1);
+        const uint32_t invalid_value = invalid_quantized_value(params.bits);
+        for (uint32_t point_index = 0; point_index < number_of_points; point_index++)
+        {
+            uint8_t* point_data = field_data + size_t(point_index) * PC2.point_step;
+            for (uint32_t c = 0; c < temporal_field.count; c++)
+            {
+                const uint32_t quantized = *value++;
+                const float dequantized = (quantized == invalid_value) ? std::numeric_limits<float>::quiet_NaN() :
+                                          float(double(quantized) * scale + params.origin[c]);
+                std::memcpy(point_data + c * sizeof(float), &dequantized, sizeof(float));
+            }
+        }
+    }
+    return true;
+}
+
+} //namespace draco_point_cloud_transport
@@ -0,0 +1,61 @@
+#include "draco_point_cloud_transport/thread_pool.h"
+
+#include <algorithm>
+
+namespace draco_point_cloud_transport
+{
+
+ThreadPool::ThreadPool(unsigned int number_of_threads) : stop_(false)
+{
+    if (number_of_threads == 0)
+    {
+        number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 0; i < number_of_threads; i++)
+    {
+        workers_.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::size() const
+{
+    return workers_.size();
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+
+            // queued tasks are finished before the pool stops
+            if (tasks_.empty())
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+} //namespace draco_point_cloud_transport
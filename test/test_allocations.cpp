@@ -0,0 +1,204 @@
+// Steady-state heap allocations of encoding and decoding, counted by malloc, calloc and realloc interposed by the benchmark
+// instrumentation. Pools of the plugins recycle messages, encoder buffers and draco point clouds, so after the first frames
+// only allocations made by draco itself (metadata, attribute encoders, the point cloud created by the decoder) remain, and
+// their number must not depend on the number of points.
+
+#include "instrumentation.h"
+
+#include "draco_point_cloud_transport/draco_publisher.h"
+#include "draco_point_cloud_transport/draco_subscriber.h"
+
+#include <gtest/gtest.h>
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace draco_point_cloud_transport;
+using namespace draco_point_cloud_transport::benchmark;
+
+namespace
+{
+
+//! frames filling pools, caches and thread pools before allocations are checked
+const size_t WARM_UP_FRAMES = 3;
+//! frames whose allocations are checked
+const size_t CHECKED_FRAMES = 5;
+//! allocations per frame of encoding or decoding, draco creates its encoders, decoders and the decoded point cloud anew
+const uint64_t MAX_ALLOCATIONS_PER_FRAME = 400;
+//! allowed growth of allocations per frame from a small to a large cloud, vectors inside draco grow by doubling
+const uint64_t MAX_ALLOCATION_GROWTH = 32;
+
+//! publisher plugin driven directly, without advertising
+class TestPublisher : public DracoPublisher
+{
+public:
+    void configure(DracoPublisherConfig config)
+    {
+        configCb(config, 0);
+    }
+
+    void encodeFrame(const sensor_msgs::PointCloud2& message, const PublishFn& publish_fn) const
+    {
+        publish(message, publish_fn);
+    }
+};
+
+//! subscriber plugin driven directly, without subscribing
+class TestSubscriber : public DracoSubscriber
+{
+public:
+    void configure(DracoSubscriberConfig config)
+    {
+        configCb(config, 0);
+    }
+
+    void decodeFrame(const CompressedPointCloud2ConstPtr& message, const Callback& user_cb)
+    {
+        internalCallback(message, user_cb);
+    }
+};
+
+//! unorganized cloud with float32 x, y, z, intensity on a spiral, values change with frame
+sensor_msgs::PointCloud2 make_cloud(uint32_t number_of_points, size_t frame)
+{
+    sensor_msgs::PointCloud2 cloud;
+    cloud.header.frame_id = "test";
+    cloud.height = 1;
+    cloud.width = number_of_points;
+    const char* names[4] = {"x", "y", "z", "intensity"};
+    for (uint32_t field_index = 0; field_index < 4; field_index++)
+    {
+        sensor_msgs::PointField field;
+        field.name = names[field_index];
+        field.offset = 4 * field_index;
+        field.datatype = sensor_msgs::PointField::FLOAT32;
+        field.count = 1;
+        cloud.fields.push_back(field);
+    }
+    cloud.point_step = 16;
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.is_dense = true;
+    cloud.data.resize(cloud.row_step);
+    for (uint32_t point = 0; point < number_of_points; point++)
+    {
+        const float angle = 0.01f * point + 0.1f * frame;
+        const float values[4] = {10.0f * std::cos(angle), 10.0f * std::sin(angle), 0.001f * point, float(point % 256)};
+        std::memcpy(cloud.data.data() + point * cloud.point_step, values, sizeof(values));
+    }
+    return cloud;
+}
+
+struct FrameAllocations
+{
+    uint64_t encode = 0;
+    uint64_t decode = 0;
+};
+
+//! most allocations of one frame of encoding and of decoding after warm up, fails if a frame was not restored
+FrameAllocations steady_state_allocations(const DracoPublisherConfig& config, uint32_t number_of_points)
+{
+    TestPublisher publisher;
+    publisher.configure(config);
+    TestSubscriber subscriber;
+    subscriber.configure(DracoSubscriberConfig::__getDefault__());
+
+    FrameAllocations most;
+    for (size_t frame = 0; frame < WARM_UP_FRAMES + CHECKED_FRAMES; frame++)
+    {
+        const sensor_msgs::PointCloud2 cloud = make_cloud(number_of_points, frame);
+
+        // copy of message kept by test is made after allocations are read
+        CompressedPointCloud2Ptr compressed;
+        uint64_t encode_allocations = 0;
+        const uint64_t encode_start = allocation_count();
+        publisher.encodeFrame(cloud, [&](const CompressedPointCloud2& message)
+        {
+            encode_allocations = allocation_count() - encode_start;
+            compressed = boost::make_shared<CompressedPointCloud2>(message);
+        });
+        EXPECT_TRUE(compressed != nullptr) << "frame " << frame << " was not encoded";
+        if (compressed == nullptr)
+        {
+            return most;
+        }
+
+        sensor_msgs::PointCloud2ConstPtr decoded;
+        uint64_t decode_allocations = 0;
+        const uint64_t decode_start = allocation_count();
+        subscriber.decodeFrame(compressed, [&](const sensor_msgs::PointCloud2ConstPtr& message)
+        {
+            decode_allocations = allocation_count() - decode_start;
+            decoded = message;
+        });
+        EXPECT_TRUE(decoded != nullptr) << "frame " << frame << " was not decoded";
+
+        if (frame >= WARM_UP_FRAMES)
+        {
+            most.encode = std::max(most.encode, encode_allocations);
+            most.decode = std::max(most.decode, decode_allocations);
+        }
+    }
+    return most;
+}
+
+//! allocations per frame stay below bound and do not grow with number of points
+void check_allocations(const DracoPublisherConfig& config, const std::string& name)
+{
+    const FrameAllocations small = steady_state_allocations(config, 1000);
+    const FrameAllocations large = steady_state_allocations(config, 100000);
+
+    EXPECT_LE(small.encode, MAX_ALLOCATIONS_PER_FRAME) << name << ": encoding of 1000 points";
+    EXPECT_LE(small.decode, MAX_ALLOCATIONS_PER_FRAME) << name << ": decoding of 1000 points";
+    EXPECT_LE(large.encode, MAX_ALLOCATIONS_PER_FRAME) << name << ": encoding of 100000 points";
+    EXPECT_LE(large.decode, MAX_ALLOCATIONS_PER_FRAME) << name << ": decoding of 100000 points";
+    EXPECT_LE(large.encode, small.encode + MAX_ALLOCATION_GROWTH) << name << ": encoding allocates per point";
+    EXPECT_LE(large.decode, small.decode + MAX_ALLOCATION_GROWTH) << name << ": decoding allocates per point";
+}
+
+} // namespace
+
+TEST(Allocations, KdTree)
+{
+    check_allocations(DracoPublisherConfig::__getDefault__(), "kd-tree");
+}
+
+TEST(Allocations, Sequential)
+{
+    DracoPublisherConfig config = DracoPublisherConfig::__getDefault__();
+    config.encode_method = 2;
+    config.deduplicate = false;
+    check_allocations(config, "sequential");
+}
+
+TEST(Allocations, Prequantized)
+{
+    DracoPublisherConfig config = DracoPublisherConfig::__getDefault__();
+    config.prequantize = true;
+    check_allocations(config, "prequantized");
+}
+
+TEST(Allocations, Tiles)
+{
+    DracoPublisherConfig config = DracoPublisherConfig::__getDefault__();
+    config.tiles = 4;
+    config.encoding_threads = 2;
+    check_allocations(config, "tiles");
+}
+
+TEST(Allocations, AttributeStreams)
+{
+    DracoPublisherConfig config = DracoPublisherConfig::__getDefault__();
+    config.attribute_streams = true;
+    config.encoding_threads = 2;
+    check_allocations(config, "attribute streams");
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
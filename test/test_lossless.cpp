@@ -0,0 +1,228 @@
+// Lossless round trip: PC2toLossless, sequential draco encoder and decoder, LosslesstoPC2 must restore data byte for byte
+// for layouts with padding, overlapping fields, unknown datatypes, NaN, padding of rows, bytes after the last row,
+// fields with count > 1 and 64 bit fields.
+
+#include "draco_point_cloud_transport/conversion_utilities.h"
+#include "draco_point_cloud_transport/lossless.h"
+
+#include <draco/compression/decode.h>
+#include <draco/compression/encode.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace draco_point_cloud_transport;
+
+namespace
+{
+
+sensor_msgs::PointField make_field(const std::string& name, uint32_t offset, uint8_t datatype, uint32_t count)
+{
+    sensor_msgs::PointField field;
+    field.name = name;
+    field.offset = offset;
+    field.datatype = datatype;
+    field.count = count;
+    return field;
+}
+
+//! cloud of height rows of width points with random bytes, rows padded by row_padding bytes, trailing_bytes after last row
+sensor_msgs::PointCloud2 make_cloud(const std::vector<sensor_msgs::PointField>& fields, uint32_t point_step, uint32_t height,
+                                    uint32_t width, uint32_t row_padding, uint32_t trailing_bytes, std::mt19937& generator)
+{
+    sensor_msgs::PointCloud2 cloud;
+    cloud.header.frame_id = "test";
+    cloud.height = height;
+    cloud.width = width;
+    cloud.fields = fields;
+    cloud.point_step = point_step;
+    cloud.row_step = width * point_step + row_padding;
+    cloud.is_dense = false;
+    cloud.data.resize(size_t(height) * cloud.row_step + trailing_bytes);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (uint8_t& value : cloud.data)
+    {
+        value = uint8_t(byte(generator));
+    }
+    return cloud;
+}
+
+//! writes value at offset of every point
+template <typename T>
+void set_values(sensor_msgs::PointCloud2& cloud, uint32_t offset, const std::vector<T>& values)
+{
+    for (uint32_t row = 0; row < cloud.height; row++)
+    {
+        for (uint32_t column = 0; column < cloud.width; column++)
+        {
+            const T& value = values[(size_t(row) * cloud.width + column) % values.size()];
+            std::memcpy(cloud.data.data() + size_t(row) * cloud.row_step + size_t(column) * cloud.point_step + offset, &value, sizeof(T));
+        }
+    }
+}
+
+//! converts, encodes sequentially as the publisher does in lossless mode, decodes and restores cloud
+void expect_round_trip(const sensor_msgs::PointCloud2& cloud, const std::string& name)
+{
+    PC2toLossless converter(cloud);
+    std::unique_ptr<draco::PointCloud> pc = converter.convert();
+    ASSERT_TRUE(pc != nullptr) << name << ": conversion failed";
+
+    draco::Encoder encoder;
+    encoder.SetSpeedOptions(7, 7);
+    encoder.SetEncodingMethod(draco::POINT_CLOUD_SEQUENTIAL_ENCODING);
+    draco::EncoderBuffer encode_buffer;
+    const draco::Status encode_status = encoder.EncodePointCloudToBuffer(*pc, &encode_buffer);
+    ASSERT_TRUE(encode_status.ok()) << name << ": " << encode_status.error_msg();
+
+    draco::DecoderBuffer decode_buffer;
+    decode_buffer.Init(encode_buffer.data(), encode_buffer.size());
+    draco::Decoder decoder;
+    draco::StatusOr<std::unique_ptr<draco::PointCloud> > decoded = decoder.DecodePointCloudFromBuffer(&decode_buffer);
+    ASSERT_TRUE(decoded.ok()) << name << ": " << decoded.status().error_msg();
+    std::unique_ptr<draco::PointCloud> decoded_pc = std::move(decoded).value();
+    ASSERT_TRUE(LosslesstoPC2::is_lossless(*decoded_pc)) << name;
+
+    // description of cloud travels in the message
+    CompressedPointCloud2 compressed;
+    assign_description_of_PointCloud2(compressed, cloud);
+    sensor_msgs::PointCloud2 restored;
+    ASSERT_TRUE(LosslesstoPC2(*decoded_pc, compressed).convert(std::vector<std::string>(), restored)) << name << ": restoring failed";
+
+    EXPECT_EQ(restored.height, cloud.height) << name;
+    EXPECT_EQ(restored.width, cloud.width) << name;
+    EXPECT_EQ(restored.point_step, cloud.point_step) << name;
+    EXPECT_EQ(restored.row_step, cloud.row_step) << name;
+    ASSERT_EQ(restored.data.size(), cloud.data.size()) << name;
+    for (size_t index = 0; index < cloud.data.size(); index++)
+    {
+        ASSERT_EQ(restored.data[index], cloud.data[index]) << name << ": byte " << index << " differs";
+    }
+}
+
+} // namespace
+
+TEST(Lossless, Padding)
+{
+    std::mt19937 generator(1);
+    sensor_msgs::PointCloud2 cloud = make_cloud({make_field("x", 0, sensor_msgs::PointField::FLOAT32, 1),
+                                                 make_field("y", 4, sensor_msgs::PointField::FLOAT32, 1),
+                                                 make_field("z", 8, sensor_msgs::PointField::FLOAT32, 1),
+                                                 make_field("ring", 14, sensor_msgs::PointField::UINT16, 1)},
+                                                20, 1, 500, 0, 0, generator);
+    expect_round_trip(cloud, "padding");
+}
+
+TEST(Lossless, OverlappingAndUnknownFields)
+{
+    std::mt19937 generator(2);
+    sensor_msgs::PointCloud2 cloud = make_cloud({make_field("a", 0, sensor_msgs::PointField::UINT32, 1),
+                                                 make_field("b", 2, sensor_msgs::PointField::UINT16, 1),
+                                                 make_field("unknown", 4, 0, 3),
+                                                 make_field("invalid", 7, 42, 1),
+                                                 make_field("outside", 10, sensor_msgs::PointField::FLOAT64, 1)},
+                                                12, 1, 300, 0, 0, generator);
+    expect_round_trip(cloud, "overlapping and unknown fields");
+}
+
+TEST(Lossless, NaN)
+{
+    std::mt19937 generator(3);
+    sensor_msgs::PointCloud2 cloud = make_cloud({make_field("x", 0, sensor_msgs::PointField::FLOAT32, 1),
+                                                 make_field("range", 8, sensor_msgs::PointField::FLOAT64, 1)},
+                                                16, 1, 400, 0, 0, generator);
+    // quiet and signalling NaN with payload, infinities and negative zero between regular values
+    uint32_t signalling_nan = 0x7f800001u;
+    float signalling_nan_float;
+    std::memcpy(&signalling_nan_float, &signalling_nan, sizeof(float));
+    set_values<float>(cloud, 0, {1.5f, std::numeric_limits<float>::quiet_NaN(), signalling_nan_float, -0.0f,
+                                 std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()});
+    uint64_t payload_nan = 0xfff0000000abcdefull;
+    double payload_nan_double;
+    std::memcpy(&payload_nan_double, &payload_nan, sizeof(double));
+    set_values<double>(cloud, 8, {std::numeric_limits<double>::quiet_NaN(), 3.25, payload_nan_double, -0.0,
+                                  std::numeric_limits<double>::denorm_min()});
+    expect_round_trip(cloud, "NaN");
+}
+
+TEST(Lossless, RowPaddingAndTrailingBytes)
+{
+    std::mt19937 generator(4);
+    const std::vector<sensor_msgs::PointField> fields = {make_field("x", 0, sensor_msgs::PointField::FLOAT32, 1),
+                                                         make_field("intensity", 4, sensor_msgs::PointField::UINT8, 1)};
+    expect_round_trip(make_cloud(fields, 5, 16, 32, 7, 0, generator), "row padding");
+    expect_round_trip(make_cloud(fields, 5, 16, 32, 0, 11, generator), "trailing bytes");
+    expect_round_trip(make_cloud(fields, 5, 16, 32, 3, 5, generator), "row padding and trailing bytes");
+}
+
+TEST(Lossless, CountAboveOne)
+{
+    std::mt19937 generator(5);
+    // more values than draco attribute components (127) are split into several attributes
+    sensor_msgs::PointCloud2 cloud = make_cloud({make_field("position", 0, sensor_msgs::PointField::FLOAT32, 3),
+                                                 make_field("histogram", 12, sensor_msgs::PointField::UINT8, 200),
+                                                 make_field("descriptor", 212, sensor_msgs::PointField::INT16, 130)},
+                                                472, 1, 100, 0, 0, generator);
+    expect_round_trip(cloud, "count > 1");
+}
+
+TEST(Lossless, SixtyFourBitFields)
+{
+    std::mt19937 generator(6);
+    sensor_msgs::PointCloud2 cloud = make_cloud({make_field("time", 0, sensor_msgs::PointField::FLOAT64, 1),
+                                                 make_field("xyz", 8, sensor_msgs::PointField::FLOAT64, 3)},
+                                                32, 4, 64, 0, 0, generator);
+    // largest differences between consecutive values
+    set_values<double>(cloud, 0, {std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+                                  std::numeric_limits<double>::lowest(), 0.0});
+    expect_round_trip(cloud, "64 bit fields");
+}
+
+TEST(Lossless, RandomLayouts)
+{
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> datatype(0, 9);
+    std::uniform_int_distribution<int> count(1, 4);
+    std::uniform_int_distribution<int> gap(0, 3);
+    std::uniform_int_distribution<int> fields_of_layout(1, 8);
+    std::uniform_int_distribution<int> size(1, 40);
+    std::uniform_int_distribution<int> padding(0, 9);
+    std::bernoulli_distribution overlap(0.1);
+    const uint32_t datatype_sizes[10] = {1, 1, 1, 2, 2, 4, 4, 4, 8, 1};
+
+    for (int layout = 0; layout < 200; layout++)
+    {
+        std::vector<sensor_msgs::PointField> fields;
+        uint32_t offset = 0;
+        const int number_of_fields = fields_of_layout(generator);
+        for (int field_index = 0; field_index < number_of_fields; field_index++)
+        {
+            const int field_datatype = datatype(generator);
+            const uint32_t field_count = uint32_t(count(generator));
+            // fields overlapping the previous one start within it
+            const uint32_t field_offset = (overlap(generator) && (offset > 0)) ? offset - 1 : offset + uint32_t(gap(generator));
+            fields.push_back(make_field("f" + std::to_string(field_index), field_offset, uint8_t(field_datatype), field_count));
+            offset = field_offset + datatype_sizes[field_datatype] * field_count;
+        }
+        const uint32_t point_step = offset + uint32_t(gap(generator));
+        const uint32_t height = uint32_t(size(generator) % 4 + 1);
+        const sensor_msgs::PointCloud2 cloud = make_cloud(fields, point_step, height, uint32_t(size(generator)),
+                                                          uint32_t(padding(generator)), uint32_t(padding(generator)), generator);
+        expect_round_trip(cloud, "layout " + std::to_string(layout));
+        if (HasFatalFailure())
+        {
+            return;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}